@@ -1,8 +1,15 @@
 #pragma once
 
+#include <array>
+#include <atomic>
+#include <chrono>
+#include <filesystem>
+#include <functional>
+#include <list>
 #include <memory>
-#include <sstream>
+#include <mutex>
 #include <string>
+#include <thread>
 #include <vector>
 
 #include "avs_c_api_loader.hpp"
@@ -16,8 +23,20 @@ extern "C"
 #include "libplacebo/vulkan.h"
 }
 
-std::unique_ptr<struct priv> avs_libplacebo_init(const VkPhysicalDevice& device, std::string& err_msg);
+// Only selects the device, the context is created by gpu_context. `renderer`: the filter renders with pl_renderer.
+std::unique_ptr<struct priv> avs_libplacebo_init(const VkPhysicalDevice& device, const int renderer);
 void avs_libplacebo_uninit(const std::unique_ptr<struct priv>& p);
+// One instance per entry of `device` (int or array, -1 is the default device). Returns the device list clip (list_device), an error
+// or void. The devices are only validated, their contexts are created on the first frame (or by gpu_context when the filter needs
+// the device earlier), so loading a script doesn't wait for Vulkan.
+AVS_Value avs_libplacebo_init(AVS_Clip* clip, AVS_ScriptEnvironment* env, const AVS_Value device, const int list_device,
+    std::vector<std::unique_ptr<struct priv>>& vf, std::string& msg, const std::string& name, const int renderer);
+// Creates the context of the instance (the shared device, the dispatch and, if it's used, the renderer) if it doesn't exist yet.
+// gpu_run calls it. Returns false and sets err_msg on failure.
+bool gpu_context(struct priv* p, std::string& err_msg);
+// The same for all instances of a filter, for parameters that need the device at creation. `msg` is prefixed with `name`.
+bool gpu_context(const std::vector<std::unique_ptr<struct priv>>& vf, std::string& msg, const std::string& name);
+void avs_libplacebo_uninit(const std::vector<std::unique_ptr<struct priv>>& vf);
 
 [[maybe_unused]]
 AVS_Value devices_info(AVS_Clip* clip, AVS_ScriptEnvironment* env, std::vector<VkPhysicalDevice>& devices, VkInstance& inst,
@@ -25,11 +44,135 @@ AVS_Value devices_info(AVS_Clip* clip, AVS_ScriptEnvironment* env, std::vector<V
 AVS_Value avs_version(std::string& msg, const std::string& name, AVS_ScriptEnvironment* env);
 [[maybe_unused]]
 AVS_Value set_error(const char* error_message, const std::unique_ptr<struct priv>& p);
+[[maybe_unused]]
+AVS_Value set_error(const char* error_message, const std::vector<std::unique_ptr<struct priv>>& vf);
+// Error of a failed frame. The message is copied to the environment, it outlives the call and other threads' errors.
+void frame_error(AVS_FilterInfo* fi, const std::string& msg);
+
+// One per Vulkan device, shared by all filter instances. Owns the libplacebo context and the thread that does all the GPU work.
+struct gpu_device;
+struct gpu_job;
+
+// Statistics of one job (stats=true). Collected by the GPU thread per job, so concurrent frames of an instance don't mix them.
+struct gpu_stats
+{
+    // Timer results arrive a few jobs late, a job reports the ones that arrived before it started.
+    uint64_t gpu_time;
+    uint64_t bytes_uploaded;
+    uint64_t bytes_downloaded;
+    uint64_t lut_updates;
+    int64_t queue_depth;
+    int64_t queue_time;
+};
+
+// Instance (device) for frame `n`: the least busy one.
+struct priv* gpu_select(const std::vector<std::unique_ptr<struct priv>>& vf, const int n);
+// Runs `submit` on the GPU thread of the instance's device and waits until the job (including the async downloads) is done.
+// `n` (frame number) is the scheduling priority, `staging_bytes` (uploaded + downloaded size) counts against the per instance limit.
+// Returns false and sets err (libplacebo log) on failure.
+bool gpu_run(struct priv* p, const int n, const uint64_t staging_bytes, const std::function<bool(gpu_job* job)>& submit,
+    std::string& err);
+// Asynchronous pl_tex_download, the job completes after all its downloads finished.
+bool gpu_download(gpu_job* job, pl_gpu gpu, pl_tex_transfer_params& ttr);
+// warmup=true: a background thread runs `process` once on every instance with blank frames of the real size (`frames`, zeroed
+// and released by the thread), so the contexts are created and the shaders compiled while the script loads and the source
+// decodes. Errors are ignored, the first frame reports them. The filter joins the thread before it destroys its instances.
+std::thread gpu_warmup(const std::vector<std::unique_ptr<struct priv>>& vf, std::vector<AVS_VideoFrame*> frames,
+    std::function<bool(struct priv* p, gpu_job* job)> process);
+
+void stats_render_info(void* priv, const pl_render_info* info);
+// Stats of the last gpu_run of the calling thread. The per job counters are cleared, so the later frames of a batch report only the
+// queue stats.
+gpu_stats take_stats();
+void set_stats_props(AVS_ScriptEnvironment* env, AVS_VideoFrame* dst, struct priv* p, const gpu_stats& stats);
+// Visible bytes of all planes.
+uint64_t frame_size(AVS_VideoFrame* frame, const AVS_VideoInfo* vi);
+
+// Tiled processing: the output is split in tiles of `tile_size`, every tile is processed from its input region (the tile and `halo`
+// pixels around it) and only the tile itself is downloaded.
+std::vector<pl_rect2d> split_tiles(const int width, const int height, const int tile_size);
+// `tile` (0: as large as the texture limit allows) limited to what fits with the halo, multiple of `align`.
+int tile_size(const int tile, const pl_gpu gpu, const int halo, const int align);
+// Tile extended by `halo`, aligned to `align` (chroma subsampling) and clamped to the plane.
+pl_rect2d tile_input(const pl_rect2d& tile, const int halo, const int align, const int width, const int height);
+
+// Batch mode: `size` consecutive frames are processed by one GPU job, stacked vertically in one texture (atlas).
+struct frame_batch;
+// The last processed batches, most recent first.
+struct batch_cache
+{
+    std::mutex mtx;
+    std::list<std::shared_ptr<frame_batch>> batches;
+};
+// Returns a new reference to frame `n`. The first request of a batch runs `process`, which creates the output frames of the batch
+// (`dst` has one entry per frame, starting with `first`). Concurrent requests of the same batch wait for it.
+AVS_VideoFrame* batch_get_frame(batch_cache& cache, const int n, const int size, const int num_frames,
+    const std::function<bool(const int first, std::vector<AVS_VideoFrame*>& dst)>& process);
+// Uploads `plane` of all frames to `tex`. Every frame takes `height + 2 * halo` rows, the halo repeats the edge rows of the frame,
+// so sampling near the edge doesn't read the neighbouring frame. `buf` is the host mapped staging buffer of the atlas.
+bool upload_atlas(struct priv* p, pl_tex* tex, pl_buf* buf, const pl_fmt fmt, const std::vector<AVS_VideoFrame*>& frames, const int plane,
+    const int halo);
+
+uint64_t fnv1a(const uint8_t* data, const size_t size) noexcept;
+// Name, PCI IDs and driver version of the Vulkan device, identifies the device in cached measurements.
+std::string device_id(const struct priv* p);
 
+// Path of a UTF-8 string (script arguments).
+std::filesystem::path utf8_path(const std::string& path);
+// Directory for files reused across runs: AVS_LIBPLACEBO_CACHE_DIR, else avs_libplacebo in the user cache directory. It's created if
+// needed. Empty if there is no usable directory.
+std::filesystem::path cache_dir();
+// Writes `data` to `path` through a temporary file, so concurrent readers (other processes) never see a partial file.
+bool write_file_atomic(const std::filesystem::path& path, const std::string& data);
+
+// Bounded log of libplacebo messages, one per device and one per instance. Keeps the last `size` lines, older ones are overwritten, so
+// the memory stays the same however much libplacebo logs. Writers don't lock or allocate. The last error has its own slot, later
+// warnings don't push it out. The level is AVS_LIBPLACEBO_LOG_LEVEL (pl_log_level, default 2: errors).
+struct log_ring
+{
+    static constexpr size_t size{64};
+    static constexpr size_t line_size{256};
+
+    struct line
+    {
+        // 2 * position + 1 while it's written, 2 * position + 2 when it's complete.
+        std::atomic<uint64_t> seq;
+        char text[line_size];
+    };
+
+    std::array<line, size> lines;
+    // Lines written so far.
+    std::atomic<uint64_t> head;
+    line last_error;
+    std::atomic<uint64_t> errors;
+    // Held while last_error is written.
+    std::atomic_flag error_lock;
+
+    void write(const pl_log_level level, const char* msg) noexcept;
+    // The lines written after `from` (an earlier `head`) that are still there, one per line.
+    std::string since(const uint64_t from) const;
+    std::string error() const;
+};
+
+// Per instance state. Except for creation/destruction it's only used by the GPU thread of the device.
 struct priv
 {
+    // The context: set by gpu_context once `ready`, before that only the device selection below is.
+    std::mutex ctx_mtx;
+    std::atomic<bool> ready;
+    std::array<uint8_t, VK_UUID_SIZE> uuid;
+    // 0: the default device.
+    int has_uuid;
+    int use_renderer;
+    // stats=true, the timer is created by the first job.
+    int use_timer;
+
+    std::shared_ptr<gpu_device> dev;
+    // Position in the `device` list of the filter.
+    int index;
+    // Messages of the dispatch and renderer of the instance. The device has its own (textures, buffers, shader compilation).
     pl_log log;
-    pl_vulkan vk;
+    log_ring log_lines;
     pl_gpu gpu;
     pl_dispatch dp;
     pl_shader_obj dither_state;
@@ -38,14 +181,38 @@ struct priv
     pl_tex tex_in[3];
     pl_tex tex_out[3];
 
-    std::ostringstream log_buffer;
-
     pl_tex sample_fbo;
     pl_tex sep_fbo;
-    pl_shader_obj lut;
+    // Resample filter LUTs per plane class (luma/RGB, chroma; per rung in ladder mode) and direction (vertical or polar, horizontal),
+    // the downscaling ratio each was last used with and how often one had to be (re)generated.
+    std::vector<pl_shader_obj> lut;
+    std::vector<float> lut_scale;
+    uint64_t lut_updates;
+    // Output textures of the rungs of Resample ladder mode, three per rung.
+    std::vector<pl_tex> ladder_tex;
+
+    // Atlas staging buffers of batch mode, one per plane.
+    pl_buf atlas[3];
+
+    // Only created when the filter is called with stats=true.
+    pl_timer timer;
+    // Counters of the job being recorded (GPU thread), moved to gpu_job::stats when it's submitted.
+    uint64_t gpu_time;
+    uint64_t bytes_uploaded;
+    uint64_t bytes_downloaded;
+
+    // Jobs of the instance queued or in flight (submitting threads).
+    std::atomic<int64_t> queued;
+    // Scheduler accounting (GPU thread).
+    int in_flight;
+    uint64_t staging;
+    // Memory pool accounting: bytes of the textures and buffers above, time of the last job (GPU thread, under pool_mtx).
+    uint64_t pool_bytes;
+    std::chrono::steady_clock::time_point last_used;
 };
 
 AVS_Value AVSC_CC create_deband(AVS_ScriptEnvironment* env, AVS_Value args, void* param);
+AVS_Value AVSC_CC create_lut(AVS_ScriptEnvironment* env, AVS_Value args, void* param);
 AVS_Value AVSC_CC create_resample(AVS_ScriptEnvironment* env, AVS_Value args, void* param);
 AVS_Value AVSC_CC create_shader(AVS_ScriptEnvironment* env, AVS_Value args, void* param);
 AVS_Value AVSC_CC create_tonemap(AVS_ScriptEnvironment* env, AVS_Value args, void* param);
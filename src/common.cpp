@@ -1,81 +1,841 @@
-#include <iostream>
+#include <algorithm>
+#include <array>
+#include <chrono>
+#include <condition_variable>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <fstream>
+#include <future>
+#include <map>
+#include <mutex>
+#include <thread>
 
 #include "avs_libplacebo.h"
 
 static_assert(PL_API_VER >= 351, "libplacebo version must be at least v7.351.0.");
 
-static void pl_logging(void* stream, pl_log_level level, const char* msg)
+//
+// GPU thread
+//
+
+// Submitted by the calling (AviSynth) thread, which waits on `done`. Lives on the stack of the caller.
+struct gpu_job
 {
-    constexpr const char* const constants_list[]{"[fatal] ", "[error] ", "[warn] ", "[info] ", "[debug] ", "[trace] "};
+    std::atomic<gpu_job*> next;
+    priv* p;
+    const std::function<bool(gpu_job*)>* submit;
+    int n;
+    uint64_t staging_bytes;
+    // Only touched by the GPU thread.
+    uint64_t seq;
+    std::chrono::steady_clock::time_point queued;
+    int64_t queue_time;
+    int pending_downloads;
+    gpu_stats stats;
+    bool submitted;
+    bool failed;
+    std::string error;
+    std::promise<void> done;
+};
 
-    if (level <= PL_LOG_WARN)
-        std::cerr << constants_list[level - 1] << msg << "\n";
-    else
-        std::cout << constants_list[level - 1] << msg << "\n";
+struct gpu_device
+{
+    pl_log log;
+    pl_vulkan vk;
+    pl_gpu gpu;
+
+    log_ring log_lines;
+
+    // Intrusive lock-free MPSC queue (Vyukov). Producers only touch `head`, the GPU thread owns `tail`.
+    std::atomic<gpu_job*> head;
+    gpu_job* tail;
+    gpu_job stub;
+
+    std::atomic<uint32_t> signal;
+    std::atomic<bool> stop;
+    std::thread worker;
+
+    // Jobs of all instances queued or in flight, used to pick the least busy device.
+    std::atomic<int64_t> load;
+
+    // The GPU thread waits here when there is nothing to record, with a timeout while idle instances hold memory.
+    std::mutex idle_mtx;
+    std::condition_variable idle_cv;
+
+    // Memory pool: the textures and buffers the instances keep between jobs. `pool` has all instances of the device, most recently
+    // used first. Above `pool_budget` (0: no limit) the least recently used idle instances release theirs, and every instance
+    // releases them after `pool_idle` (0: never) without jobs.
+    std::mutex pool_mtx;
+    std::list<priv*> pool;
+    uint64_t pool_budget;
+    std::chrono::steady_clock::duration pool_idle;
+    std::atomic<uint64_t> pool_bytes;
+    std::atomic<uint64_t> pool_peak;
+
+    ~gpu_device();
+
+    void push(gpu_job* job) noexcept;
+    gpu_job* pop() noexcept;
+};
+
+// Jobs recorded before waiting for the GPU.
+static constexpr size_t max_in_flight{8};
+// Per instance limits, so one expensive filter can't fill the whole batch.
+static constexpr int max_in_flight_instance{2};
+static constexpr uint64_t max_staging_instance{256ull * 1024 * 1024};
+// Jobs that were passed over this many times go first regardless of their frame number.
+static constexpr uint64_t max_job_age{32};
+// Memory pool defaults: the budget is this part of the largest device local heap.
+static constexpr uint64_t pool_budget_divisor{2};
+static constexpr int pool_idle_seconds{30};
+// Batches kept by batch_get_frame, so the frames of a batch requested by different threads are served from one job.
+static constexpr size_t max_cached_batches{4};
+
+// Stats of the last job of the calling thread, read by take_stats right after gpu_run.
+static thread_local gpu_stats last_stats;
+
+void gpu_device::push(gpu_job* job) noexcept
+{
+    job->next.store(nullptr, std::memory_order_relaxed);
+    gpu_job* prev{head.exchange(job, std::memory_order_acq_rel)};
+    prev->next.store(job, std::memory_order_release);
 }
 
-std::unique_ptr<struct priv> avs_libplacebo_init(const VkPhysicalDevice& device, std::string& err_msg)
+gpu_job* gpu_device::pop() noexcept
 {
-    std::unique_ptr<priv> p{std::make_unique<priv>()};
-    // std::cout.rdbuf(p->log_buffer.rdbuf());
-    std::cerr.rdbuf(p->log_buffer.rdbuf());
-    pl_log_params log_params{pl_logging, nullptr, PL_LOG_ERR};
-    p->log = pl_log_create(0, &log_params);
+    gpu_job* t{tail};
+    gpu_job* next{t->next.load(std::memory_order_acquire)};
 
-    pl_vulkan_params vp{};
-    vp.allow_software = true;
+    if (t == &stub)
+    {
+        if (!next)
+            return nullptr;
 
-    if (device)
+        tail = next;
+        t = next;
+        next = next->next.load(std::memory_order_acquire);
+    }
+
+    if (next)
     {
-        VkPhysicalDeviceProperties properties{};
-        vkGetPhysicalDeviceProperties(device, &properties);
-        vp.device_name = properties.deviceName;
+        tail = next;
+        return t;
     }
 
-    p->vk = pl_vulkan_create(p->log, &vp);
-    if (!p->vk)
+    // A producer is between exchange and the link, try again later.
+    if (t != head.load(std::memory_order_acquire))
+        return nullptr;
+
+    push(&stub);
+
+    next = t->next.load(std::memory_order_acquire);
+    if (next)
     {
-        err_msg = p->log_buffer.str();
-        pl_log_destroy(&p->log);
+        tail = next;
+        return t;
+    }
+
+    return nullptr;
+}
+
+//
+// log
+//
+
+static constexpr const char* const log_prefix[]{"[fatal] ", "[error] ", "[warn] ", "[info] ", "[debug] ", "[trace] "};
+
+// Seqlock: a reader that finds the sequence changed during its copy drops the line.
+static void write_line(log_ring::line& line, const uint64_t pos, const pl_log_level level, const char* msg) noexcept
+{
+    line.seq.store(2 * pos + 1, std::memory_order_relaxed);
+    std::atomic_thread_fence(std::memory_order_release);
+
+    snprintf(line.text, log_ring::line_size, "%s%s", log_prefix[std::clamp(static_cast<int>(level), 1, 6) - 1], msg);
+
+    line.seq.store(2 * pos + 2, std::memory_order_release);
+}
+
+static bool read_line(const log_ring::line& line, const uint64_t pos, std::string& out)
+{
+    const uint64_t seq{line.seq.load(std::memory_order_acquire)};
+    if (seq != 2 * pos + 2)
+        return false;
+
+    char text[log_ring::line_size];
+    memcpy(text, line.text, log_ring::line_size);
+    std::atomic_thread_fence(std::memory_order_acquire);
+
+    if (line.seq.load(std::memory_order_relaxed) != seq)
+        return false;
+
+    text[log_ring::line_size - 1] = '\0';
+    out += text;
+    out += '\n';
+
+    return true;
+}
+
+void log_ring::write(const pl_log_level level, const char* msg) noexcept
+{
+    const uint64_t pos{head.fetch_add(1, std::memory_order_relaxed)};
+    write_line(lines[pos % size], pos, level, msg);
+
+    if (level <= PL_LOG_ERR)
+    {
+        // One slot, the seqlock allows only one writer at a time. Errors are rare, a spinlock is enough.
+        while (error_lock.test_and_set(std::memory_order_acquire))
+            error_lock.wait(true, std::memory_order_relaxed);
+
+        const uint64_t n{errors.load(std::memory_order_relaxed)};
+        write_line(last_error, n, level, msg);
+        errors.store(n + 1, std::memory_order_release);
+
+        error_lock.clear(std::memory_order_release);
+        error_lock.notify_one();
+    }
+}
+
+std::string log_ring::since(const uint64_t from) const
+{
+    const uint64_t end{head.load(std::memory_order_acquire)};
+    std::string text;
+
+    for (uint64_t pos{std::max(from, (end > size) ? end - size : 0)}; pos < end; ++pos)
+        read_line(lines[pos % size], pos, text);
+
+    return text;
+}
+
+std::string log_ring::error() const
+{
+    const uint64_t n{errors.load(std::memory_order_acquire)};
+    std::string text;
+    if (n)
+        read_line(last_error, n - 1, text);
+
+    return text;
+}
+
+static void pl_logging(void* priv, pl_log_level level, const char* msg)
+{
+    reinterpret_cast<log_ring*>(priv)->write(level, msg);
+}
+
+static pl_log_level log_level()
+{
+    const char* env{std::getenv("AVS_LIBPLACEBO_LOG_LEVEL")};
+    if (!env || !*env)
+        return PL_LOG_ERR;
+
+    return static_cast<pl_log_level>(std::clamp(static_cast<int>(std::strtol(env, nullptr, 10)), 0, static_cast<int>(PL_LOG_ALL)));
+}
+
+static void complete_job(gpu_job* job)
+{
+    --job->p->in_flight;
+    job->p->staging -= job->staging_bytes;
+
+    // The caller may destroy the job as soon as it's signaled.
+    job->done.set_value();
+}
+
+static void job_download_done(void* priv)
+{
+    gpu_job* job{reinterpret_cast<gpu_job*>(priv)};
+
+    if (--job->pending_downloads == 0 && job->submitted)
+        complete_job(job);
+}
+
+static uint64_t tex_bytes(const pl_tex tex) noexcept
+{
+    if (!tex)
+        return 0;
+
+    return static_cast<uint64_t>(tex->params.w) * std::max(tex->params.h, 1) * std::max(tex->params.d, 1) * tex->params.format->texel_size;
+}
+
+// Textures and buffers the instance keeps between jobs.
+static uint64_t pool_size(const priv* p) noexcept
+{
+    uint64_t size{tex_bytes(p->sample_fbo) + tex_bytes(p->sep_fbo)};
+    for (int i{0}; i < 3; ++i)
+    {
+        size += tex_bytes(p->tex_in[i]) + tex_bytes(p->tex_out[i]);
+        if (p->atlas[i])
+            size += p->atlas[i]->params.size;
+    }
+    for (const pl_tex tex : p->ladder_tex)
+        size += tex_bytes(tex);
+
+    return size;
+}
+
+// Called with pool_mtx held, for instances without jobs in flight. The next job recreates what it needs. The renderer cache (Tonemap,
+// LUT, Shader) is only flushed on idle release, it also holds the state of peak detection.
+static void pool_release(gpu_device* dev, priv* p, const bool idle)
+{
+    pl_tex_destroy(p->gpu, &p->sample_fbo);
+    pl_tex_destroy(p->gpu, &p->sep_fbo);
+    for (int i{0}; i < 3; ++i)
+    {
+        pl_tex_destroy(p->gpu, &p->tex_in[i]);
+        pl_tex_destroy(p->gpu, &p->tex_out[i]);
+        pl_buf_destroy(p->gpu, &p->atlas[i]);
+    }
+    for (pl_tex& tex : p->ladder_tex)
+        pl_tex_destroy(p->gpu, &tex);
+
+    if (idle && p->rr)
+        pl_renderer_flush_cache(p->rr);
+
+    dev->pool_bytes -= p->pool_bytes;
+    p->pool_bytes = 0;
+}
+
+static void pool_touch(gpu_device* dev, priv* p)
+{
+    std::lock_guard<std::mutex> lck(dev->pool_mtx);
+
+    const auto itr{std::find(dev->pool.begin(), dev->pool.end(), p)};
+    if (itr != dev->pool.end())
+        dev->pool.splice(dev->pool.begin(), dev->pool, itr);
+
+    p->last_used = std::chrono::steady_clock::now();
+}
+
+// Updates the usage with what the last job of `p` allocated and evicts the least recently used idle instances while the device is
+// over budget. `p` itself is never evicted, its textures may be in use by the job that's recorded.
+static void pool_trim(gpu_device* dev, priv* p)
+{
+    std::lock_guard<std::mutex> lck(dev->pool_mtx);
+
+    const uint64_t size{pool_size(p)};
+    const uint64_t total{dev->pool_bytes += size - p->pool_bytes};
+    p->pool_bytes = size;
+
+    if (total > dev->pool_peak.load(std::memory_order_relaxed))
+        dev->pool_peak.store(total, std::memory_order_relaxed);
+
+    if (!dev->pool_budget)
+        return;
+
+    for (auto itr{dev->pool.rbegin()}; itr != dev->pool.rend() && dev->pool_bytes > dev->pool_budget; ++itr)
+    {
+        if (*itr != p && (*itr)->pool_bytes && !(*itr)->in_flight)
+            pool_release(dev, *itr, false);
+    }
+}
+
+// Releases the memory of the instances idle for pool_idle. Returns when the next one expires.
+static std::chrono::steady_clock::time_point pool_expire(gpu_device* dev)
+{
+    std::chrono::steady_clock::time_point next{std::chrono::steady_clock::time_point::max()};
+    if (dev->pool_idle == std::chrono::steady_clock::duration::zero())
+        return next;
+
+    const std::chrono::steady_clock::time_point now{std::chrono::steady_clock::now()};
+
+    std::lock_guard<std::mutex> lck(dev->pool_mtx);
+
+    for (priv* p : dev->pool)
+    {
+        if (!p->pool_bytes || p->in_flight)
+            continue;
+
+        if (now - p->last_used >= dev->pool_idle)
+            pool_release(dev, p, true);
+        else
+            next = std::min(next, p->last_used + dev->pool_idle);
+    }
+
+    return next;
+}
+
+// Returns true if the job still waits for downloads.
+static bool run_job(gpu_device* dev, gpu_job* job)
+{
+    priv* p{job->p};
+
+    // Created on the first job. nullptr when the device doesn't support timestamp queries.
+    if (p->use_timer)
+    {
+        p->timer = pl_timer_create(p->gpu);
+        p->use_timer = 0;
+    }
+
+    p->gpu_time = 0;
+    p->bytes_uploaded = 0;
+    p->bytes_downloaded = 0;
+    p->lut_updates = 0;
+
+    // Timer results are asynchronous and lag behind by a few frames.
+    if (p->timer)
+    {
+        while (const uint64_t t{pl_timer_query(p->gpu, p->timer)})
+            p->gpu_time += t;
+    }
+
+    // Only the messages of this job go to its error.
+    const uint64_t dev_log{dev->log_lines.head.load(std::memory_order_relaxed)};
+    const uint64_t p_log{p->log_lines.head.load(std::memory_order_relaxed)};
+
+    job->queue_time = std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now() - job->queued).count();
+
+    ++p->in_flight;
+    p->staging += job->staging_bytes;
+
+    pool_touch(dev, p);
+
+    if (!(*job->submit)(job))
+    {
+        job->failed = true;
+        job->error = dev->log_lines.since(dev_log) + p->log_lines.since(p_log);
+        // The lines of the job were overwritten or the level is below errors.
+        if (job->error.empty())
+            job->error = p->log_lines.error() + dev->log_lines.error();
+        if (job->error.empty())
+            job->error = "unknown error (AVS_LIBPLACEBO_LOG_LEVEL is 0 or 1).\n";
+    }
+
+    pool_trim(dev, p);
+
+    job->stats.gpu_time = p->gpu_time;
+    job->stats.bytes_uploaded = p->bytes_uploaded;
+    job->stats.bytes_downloaded = p->bytes_downloaded;
+    job->stats.lut_updates = p->lut_updates;
+
+    job->submitted = true;
+
+    if (job->pending_downloads == 0)
+    {
+        complete_job(job);
+        return false;
+    }
+
+    return true;
+}
+
+// Picks the next job to record. The lowest frame number goes first: it's the frame the consumer (encoder/next filter) waits for,
+// and with a filter chain it's the job whose output is closest to the end of the chain. Instances at their in-flight/staging limit
+// wait for the next batch (backpressure).
+static std::vector<gpu_job*>::iterator pick_job(std::vector<gpu_job*>& ready, const uint64_t seq)
+{
+    auto best{ready.end()};
+
+    for (auto itr{ready.begin()}; itr != ready.end(); ++itr)
+    {
+        const gpu_job* job{*itr};
+        const priv* p{job->p};
+
+        if (p->in_flight >= max_in_flight_instance || (p->in_flight && p->staging + job->staging_bytes > max_staging_instance))
+            continue;
+
+        if (best == ready.end())
+        {
+            best = itr;
+            continue;
+        }
+
+        const bool old{seq - job->seq > max_job_age};
+        const bool best_old{seq - (*best)->seq > max_job_age};
+
+        if (old != best_old)
+        {
+            if (old)
+                best = itr;
+        }
+        else if (old)
+        {
+            if (job->seq < (*best)->seq)
+                best = itr;
+        }
+        else if (job->n < (*best)->n || (job->n == (*best)->n && job->seq < (*best)->seq))
+            best = itr;
+    }
+
+    return best;
+}
+
+// Drains the queue, records up to max_in_flight jobs and then waits for the GPU, so the recording of the next frames overlaps
+// the execution of the previous ones.
+static void gpu_worker(gpu_device* dev)
+{
+    std::vector<gpu_job*> ready;
+    uint64_t seq{0};
+    size_t in_flight{0};
+
+    while (true)
+    {
+        const uint32_t signal{dev->signal.load(std::memory_order_acquire)};
+
+        while (gpu_job* job{dev->pop()})
+        {
+            job->seq = seq++;
+            ready.emplace_back(job);
+        }
+
+        if (in_flight < max_in_flight)
+        {
+            const auto itr{pick_job(ready, seq)};
+            if (itr != ready.end())
+            {
+                gpu_job* job{*itr};
+                ready.erase(itr);
+
+                if (run_job(dev, job))
+                    ++in_flight;
+
+                continue;
+            }
+        }
+
+        if (in_flight)
+        {
+            // Runs the download callbacks, that completes the jobs.
+            pl_gpu_finish(dev->gpu);
+            in_flight = 0;
+            // Instances idle while the others keep the device busy.
+            pool_expire(dev);
+            continue;
+        }
+
+        // Nothing can be waiting for the limits here, no job is in flight.
+        if (dev->stop.load(std::memory_order_acquire))
+            break;
+
+        const std::chrono::steady_clock::time_point expire{pool_expire(dev)};
+        const auto signaled{[&] { return dev->signal.load(std::memory_order_acquire) != signal; }};
+
+        std::unique_lock<std::mutex> lck(dev->idle_mtx);
+        if (expire == std::chrono::steady_clock::time_point::max())
+            dev->idle_cv.wait(lck, signaled);
+        else
+            dev->idle_cv.wait_until(lck, expire, signaled);
+    }
+}
+
+gpu_device::~gpu_device()
+{
+    if (worker.joinable())
+    {
+        stop = true;
+        ++signal;
+        {
+            std::lock_guard<std::mutex> lck(idle_mtx);
+        }
+        idle_cv.notify_one();
+        worker.join();
+    }
+
+    pl_vulkan_destroy(&vk);
+    pl_log_destroy(&log);
+}
+
+static std::mutex shared_devices_mtx;
+static std::map<std::string, std::weak_ptr<gpu_device>> shared_devices;
+
+// The device is selected by UUID (identical GPUs have the same name), an empty UUID is the default device.
+static std::shared_ptr<gpu_device> gpu_device_get(const std::array<uint8_t, VK_UUID_SIZE>* uuid, std::string& err_msg)
+{
+    std::string key;
+    if (uuid)
+    {
+        for (const uint8_t b : *uuid)
+        {
+            constexpr char hex[]{"0123456789abcdef"};
+            key += hex[b >> 4];
+            key += hex[b & 15];
+        }
+    }
+
+    std::lock_guard<std::mutex> lck(shared_devices_mtx);
+
+    if (std::shared_ptr<gpu_device> dev{shared_devices[key].lock()})
+        return dev;
+
+    std::shared_ptr<gpu_device> dev{std::make_shared<gpu_device>()};
+    dev->tail = &dev->stub;
+    dev->head = &dev->stub;
+
+    pl_log_params log_params{pl_logging, &dev->log_lines, log_level()};
+    dev->log = pl_log_create(0, &log_params);
+
+    pl_vulkan_params vp{};
+    vp.allow_software = true;
+    if (uuid)
+        memcpy(vp.device_uuid, uuid->data(), VK_UUID_SIZE);
+
+    dev->vk = pl_vulkan_create(dev->log, &vp);
+    if (!dev->vk)
+    {
+        err_msg = dev->log_lines.since(0);
         return nullptr;
     }
     // Give this a shorter name for convenience
-    p->gpu = p->vk->gpu;
+    dev->gpu = dev->vk->gpu;
+
+    // AVS_LIBPLACEBO_VRAM_BUDGET: MiB (0: no limit), AVS_LIBPLACEBO_IDLE_TIMEOUT: seconds (0: never).
+    if (const char* env{std::getenv("AVS_LIBPLACEBO_VRAM_BUDGET")}; env && *env)
+        dev->pool_budget = std::strtoull(env, nullptr, 10) * 1024 * 1024;
+    else
+    {
+        VkPhysicalDeviceMemoryProperties memory{};
+        vkGetPhysicalDeviceMemoryProperties(dev->vk->phys_device, &memory);
+
+        for (uint32_t i{0}; i < memory.memoryHeapCount; ++i)
+        {
+            if (memory.memoryHeaps[i].flags & VK_MEMORY_HEAP_DEVICE_LOCAL_BIT)
+                dev->pool_budget = std::max<uint64_t>(dev->pool_budget, memory.memoryHeaps[i].size / pool_budget_divisor);
+        }
+    }
+
+    const char* idle{std::getenv("AVS_LIBPLACEBO_IDLE_TIMEOUT")};
+    dev->pool_idle = std::chrono::seconds{(idle && *idle) ? std::strtoll(idle, nullptr, 10) : pool_idle_seconds};
+
+    dev->worker = std::thread(gpu_worker, dev.get());
+    shared_devices[key] = dev;
+
+    return dev;
+}
+
+priv* gpu_select(const std::vector<std::unique_ptr<struct priv>>& vf, const int n)
+{
+    if (vf.size() == 1)
+        return vf[0].get();
+
+    // Least busy device, ties are resolved round-robin by the frame number. Devices that weren't used yet have no load.
+    const auto load{[](const priv* p) -> int64_t { return (p->ready.load(std::memory_order_acquire)) ? p->dev->load.load() : 0; }};
+
+    const size_t start{static_cast<size_t>(n) % vf.size()};
+    priv* best{vf[start].get()};
+
+    for (size_t i{1}; i < vf.size(); ++i)
+    {
+        priv* p{vf[(start + i) % vf.size()].get()};
+        if (load(p) < load(best))
+            best = p;
+    }
+
+    return best;
+}
+
+bool gpu_run(priv* p, const int n, const uint64_t staging_bytes, const std::function<bool(gpu_job* job)>& submit,
+    std::string& err)
+{
+    if (!gpu_context(p, err))
+        return false;
+
+    gpu_job job{};
+    job.p = p;
+    job.submit = &submit;
+    job.n = n;
+    job.staging_bytes = staging_bytes;
+    job.queued = std::chrono::steady_clock::now();
+
+    std::future<void> done{job.done.get_future()};
+
+    const int64_t queue_depth{p->queued++};
+    ++p->dev->load;
+
+    p->dev->push(&job);
+    ++p->dev->signal;
+    {
+        // The GPU thread checks `signal` under the lock, so the notification can't fall between its check and its wait.
+        std::lock_guard<std::mutex> lck(p->dev->idle_mtx);
+    }
+    p->dev->idle_cv.notify_one();
+
+    done.wait();
+
+    --p->queued;
+    --p->dev->load;
+    last_stats = job.stats;
+    last_stats.queue_depth = queue_depth;
+    last_stats.queue_time = job.queue_time;
+
+    if (job.failed)
+    {
+        err = job.error;
+        return false;
+    }
+
+    return true;
+}
+
+bool gpu_download(gpu_job* job, pl_gpu gpu, pl_tex_transfer_params& ttr)
+{
+    ++job->pending_downloads;
+    ttr.callback = job_download_done;
+    ttr.priv = job;
+
+    if (pl_tex_download(gpu, &ttr))
+        return true;
+
+    // No callback for a failed download, the job completes through the failed job path.
+    --job->pending_downloads;
+    return false;
+}
+
+std::thread gpu_warmup(const std::vector<std::unique_ptr<struct priv>>& vf, std::vector<AVS_VideoFrame*> frames,
+    std::function<bool(priv* p, gpu_job* job)> process)
+{
+    std::vector<priv*> instances;
+    for (const auto& p : vf)
+        instances.emplace_back(p.get());
+
+    return std::thread([instances{std::move(instances)}, frames{std::move(frames)}, process{std::move(process)}]() {
+        // New frames are not cleared, leftover memory can hold NaN/Inf. Zero is a valid value for integer and float formats.
+        // Missing planes (U/V of Y formats, A without alpha) have pitch 0.
+        for (AVS_VideoFrame* frame : frames)
+        {
+            if (!frame)
+                continue;
+
+            for (const int plane : {AVS_PLANAR_Y, AVS_PLANAR_U, AVS_PLANAR_V, AVS_PLANAR_A})
+            {
+                const int pitch{g_avs_api->avs_get_pitch_p(frame, plane)};
+                BYTE* ptr{(pitch > 0) ? g_avs_api->avs_get_write_ptr_p(frame, plane) : nullptr};
+                if (ptr)
+                    memset(ptr, 0, static_cast<size_t>(pitch) * g_avs_api->avs_get_height_p(frame, plane));
+            }
+        }
+
+        for (priv* p : instances)
+        {
+            std::string err;
+            gpu_run(p, 0, 0, [&](gpu_job* job) { return process(p, job); }, err);
+        }
+
+        for (AVS_VideoFrame* frame : frames)
+        {
+            if (frame)
+                g_avs_api->avs_release_video_frame(frame);
+        }
+    });
+}
+
+//
+// instances
+//
+
+std::unique_ptr<struct priv> avs_libplacebo_init(const VkPhysicalDevice& device, const int renderer)
+{
+    std::unique_ptr<priv> p{std::make_unique<priv>()};
+    p->use_renderer = renderer;
+
+    if (device)
+    {
+        VkPhysicalDeviceIDProperties id_properties{};
+        id_properties.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_ID_PROPERTIES;
+
+        VkPhysicalDeviceProperties2 properties{};
+        properties.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_PROPERTIES_2;
+        properties.pNext = &id_properties;
+        vkGetPhysicalDeviceProperties2(device, &properties);
+
+        memcpy(p->uuid.data(), id_properties.deviceUUID, VK_UUID_SIZE);
+        p->has_uuid = 1;
+    }
+
+    return p;
+}
+
+bool gpu_context(priv* p, std::string& err_msg)
+{
+    if (p->ready.load(std::memory_order_acquire))
+        return true;
+
+    std::lock_guard<std::mutex> lck(p->ctx_mtx);
+    if (p->ready.load(std::memory_order_relaxed))
+        return true;
+
+    std::shared_ptr<gpu_device> dev{gpu_device_get((p->has_uuid) ? &p->uuid : nullptr, err_msg)};
+    if (!dev)
+        return false;
+
+    pl_log_params log_params{pl_logging, &p->log_lines, log_level()};
+    p->log = pl_log_create(0, &log_params);
+    p->gpu = dev->gpu;
 
     p->dp = pl_dispatch_create(p->log, p->gpu);
     if (!p->dp)
     {
-        pl_vulkan_destroy(&p->vk);
-
-        err_msg = p->log_buffer.str();
+        err_msg = p->log_lines.error() + dev->log_lines.error();
         pl_log_destroy(&p->log);
-        return nullptr;
+        return false;
     }
 
-    p->rr = pl_renderer_create(p->log, p->gpu);
-    if (!p->rr)
+    // Deband and Resample dispatch their shaders themselves.
+    if (p->use_renderer)
     {
-        pl_dispatch_destroy(&p->dp);
-        pl_vulkan_destroy(&p->vk);
+        p->rr = pl_renderer_create(p->log, p->gpu);
+        if (!p->rr)
+        {
+            pl_dispatch_destroy(&p->dp);
 
-        err_msg = p->log_buffer.str();
-        pl_log_destroy(&p->log);
-        return nullptr;
+            err_msg = p->log_lines.error() + dev->log_lines.error();
+            pl_log_destroy(&p->log);
+            return false;
+        }
     }
 
-    return p;
+    {
+        std::lock_guard<std::mutex> pool_lck(dev->pool_mtx);
+        dev->pool.emplace_back(p);
+        p->last_used = std::chrono::steady_clock::now();
+    }
+
+    p->dev = std::move(dev);
+    p->ready.store(true, std::memory_order_release);
+
+    return true;
+}
+
+bool gpu_context(const std::vector<std::unique_ptr<struct priv>>& vf, std::string& msg, const std::string& name)
+{
+    for (const auto& p : vf)
+    {
+        if (!gpu_context(p.get(), msg))
+        {
+            msg = name + ": " + msg;
+            return false;
+        }
+    }
+
+    return true;
 }
 
 void avs_libplacebo_uninit(const std::unique_ptr<struct priv>& p)
 {
+    // Nothing was created before the first frame.
+    if (!p->ready.load(std::memory_order_acquire))
+        return;
+
+    {
+        std::lock_guard<std::mutex> lck(p->dev->pool_mtx);
+        p->dev->pool.remove(p.get());
+        p->dev->pool_bytes -= p->pool_bytes;
+    }
+
     // Clean up resources specific to Resample
     pl_tex_destroy(p->gpu, &p->sample_fbo);
     pl_tex_destroy(p->gpu, &p->sep_fbo);
-    pl_shader_obj_destroy(&p->lut);
+    for (pl_shader_obj& lut : p->lut)
+        pl_shader_obj_destroy(&lut);
+    for (pl_tex& tex : p->ladder_tex)
+        pl_tex_destroy(p->gpu, &tex);
+
+    // Clean up resources of batch mode (Deband, Resample)
+    for (int i = 0; i < 3; i++)
+        pl_buf_destroy(p->gpu, &p->atlas[i]);
 
     // Clean up resources specific to Deband
     pl_shader_obj_destroy(&p->dither_state);
 
+    pl_timer_destroy(p->gpu, &p->timer);
+
     // Clean up shared texture arrays (Used by Shader, Deband, Resample)
     for (int i = 0; i < 3; i++)
     {
@@ -86,8 +846,76 @@ void avs_libplacebo_uninit(const std::unique_ptr<struct priv>& p)
     // Core cleanup
     pl_renderer_destroy(&p->rr);
     pl_dispatch_destroy(&p->dp);
-    pl_vulkan_destroy(&p->vk);
     pl_log_destroy(&p->log);
+    // The device goes away with its last instance.
+    p->dev.reset();
+    p->ready = false;
+}
+
+void avs_libplacebo_uninit(const std::vector<std::unique_ptr<struct priv>>& vf)
+{
+    for (const auto& p : vf)
+    {
+        if (p)
+            avs_libplacebo_uninit(p);
+    }
+}
+
+AVS_Value avs_libplacebo_init(AVS_Clip* clip, AVS_ScriptEnvironment* env, const AVS_Value device, const int list_device,
+    std::vector<std::unique_ptr<struct priv>>& vf, std::string& msg, const std::string& name, const int renderer)
+{
+    std::vector<int> device_idx;
+    if (avs_is_array(device))
+    {
+        for (int i{0}; i < avs_array_size(device); ++i)
+            device_idx.emplace_back(avs_as_int(*(avs_as_array(device) + i)));
+    }
+    else if (avs_defined(device))
+        device_idx.emplace_back(avs_as_int(device));
+
+    if (device_idx.empty())
+        device_idx.emplace_back(-1);
+
+    const auto [min_idx, max_idx]{std::minmax_element(device_idx.begin(), device_idx.end())};
+
+    if (list_device || *max_idx > -1)
+    {
+        std::vector<VkPhysicalDevice> devices{};
+        VkInstance inst{};
+
+        AVS_Value dev_info{devices_info(clip, env, devices, inst, msg, name, (*min_idx < -1) ? *min_idx : *max_idx, list_device)};
+        if (avs_is_error(dev_info) || avs_is_clip(dev_info))
+            return dev_info;
+
+        for (const int i : device_idx)
+            vf.emplace_back(avs_libplacebo_init((i > -1) ? devices[i] : nullptr, renderer));
+
+        vkDestroyInstance(inst, nullptr);
+    }
+    else
+    {
+        if (*min_idx < -1)
+        {
+            msg = name + ": device must be greater than or equal to -1.";
+            return avs_new_value_error(msg.c_str());
+        }
+
+        vf.emplace_back(avs_libplacebo_init(nullptr, renderer));
+    }
+
+    if (msg.size())
+    {
+        avs_libplacebo_uninit(vf);
+        vf.clear();
+
+        msg = name + ": " + msg;
+        return avs_new_value_error(msg.c_str());
+    }
+
+    for (size_t i{0}; i < vf.size(); ++i)
+        vf[i]->index = static_cast<int>(i);
+
+    return avs_void;
 }
 
 AVS_Value devices_info(AVS_Clip* clip, AVS_ScriptEnvironment* env, std::vector<VkPhysicalDevice>& devices, VkInstance& inst,
@@ -101,6 +929,8 @@ AVS_Value devices_info(AVS_Clip* clip, AVS_ScriptEnvironment* env, std::vector<V
 
     VkInstanceCreateInfo info{};
     info.sType = VK_STRUCTURE_TYPE_INSTANCE_CREATE_INFO;
+    // Without it the instance is 1.0 and vkGetPhysicalDeviceProperties2 (device uuid) isn't valid on it.
+    info.pApplicationInfo = &app_info;
 
     uint32_t instance_version = VK_API_VERSION_1_0;
     if (vkEnumerateInstanceVersion)
@@ -197,3 +1027,305 @@ AVS_Value set_error(const char* error_message, const std::unique_ptr<struct priv
 
     return avs_new_value_error(error_message);
 }
+
+AVS_Value set_error(const char* error_message, const std::vector<std::unique_ptr<struct priv>>& vf)
+{
+    avs_libplacebo_uninit(vf);
+
+    return avs_new_value_error(error_message);
+}
+
+void frame_error(AVS_FilterInfo* fi, const std::string& msg)
+{
+    fi->error = g_avs_api->avs_save_string(fi->env, msg.c_str(), static_cast<int>(msg.size()));
+}
+
+void stats_render_info(void* priv, const pl_render_info* info)
+{
+    // The renderer reports the last measured execution time of every pass it ran.
+    reinterpret_cast<struct priv*>(priv)->gpu_time += info->pass->last;
+}
+
+gpu_stats take_stats()
+{
+    const gpu_stats stats{last_stats};
+    last_stats.gpu_time = 0;
+    last_stats.bytes_uploaded = 0;
+    last_stats.bytes_downloaded = 0;
+    last_stats.lut_updates = 0;
+
+    return stats;
+}
+
+void set_stats_props(AVS_ScriptEnvironment* env, AVS_VideoFrame* dst, priv* p, const gpu_stats& stats)
+{
+    AVS_Map* props{g_avs_api->avs_get_frame_props_rw(env, dst)};
+    g_avs_api->avs_prop_set_int(env, props, "PlaceboGpuTime", static_cast<int64_t>(stats.gpu_time), 0);
+    g_avs_api->avs_prop_set_int(env, props, "PlaceboBytesUploaded", static_cast<int64_t>(stats.bytes_uploaded), 0);
+    g_avs_api->avs_prop_set_int(env, props, "PlaceboBytesDownloaded", static_cast<int64_t>(stats.bytes_downloaded), 0);
+    g_avs_api->avs_prop_set_int(env, props, "PlaceboQueueDepth", stats.queue_depth, 0);
+    g_avs_api->avs_prop_set_int(env, props, "PlaceboQueueTime", stats.queue_time, 0);
+    g_avs_api->avs_prop_set_int(env, props, "PlaceboDevice", p->index, 0);
+    g_avs_api->avs_prop_set_int(env, props, "PlaceboPoolBytes", static_cast<int64_t>(p->dev->pool_bytes.load()), 0);
+    g_avs_api->avs_prop_set_int(env, props, "PlaceboPoolPeak", static_cast<int64_t>(p->dev->pool_peak.load()), 0);
+}
+
+uint64_t frame_size(AVS_VideoFrame* frame, const AVS_VideoInfo* vi)
+{
+    constexpr int planes_y[4]{AVS_PLANAR_Y, AVS_PLANAR_U, AVS_PLANAR_V, AVS_PLANAR_A};
+    constexpr int planes_r[4]{AVS_PLANAR_R, AVS_PLANAR_G, AVS_PLANAR_B, AVS_PLANAR_A};
+    const int* planes{(avs_is_rgb(vi)) ? planes_r : planes_y};
+    const int num_planes{g_avs_api->avs_num_components(vi)};
+
+    uint64_t size{0};
+    for (int i{0}; i < num_planes; ++i)
+        size += static_cast<uint64_t>(g_avs_api->avs_get_row_size_p(frame, planes[i])) * g_avs_api->avs_get_height_p(frame, planes[i]);
+
+    return size;
+}
+
+std::vector<pl_rect2d> split_tiles(const int width, const int height, const int tile_size)
+{
+    std::vector<pl_rect2d> tiles;
+
+    for (int y{0}; y < height; y += tile_size)
+    {
+        for (int x{0}; x < width; x += tile_size)
+            tiles.emplace_back(pl_rect2d{x, y, std::min(x + tile_size, width), std::min(y + tile_size, height)});
+    }
+
+    return tiles;
+}
+
+int tile_size(const int tile, const pl_gpu gpu, const int halo, const int align)
+{
+    const int max_size{static_cast<int>(gpu->limits.max_tex_2d_dim) - 2 * (halo + align)};
+    const int size{(tile > 0) ? std::min(tile, max_size) : max_size};
+
+    return std::max(size / align * align, align);
+}
+
+pl_rect2d tile_input(const pl_rect2d& tile, const int halo, const int align, const int width, const int height)
+{
+    pl_rect2d in{};
+    in.x0 = std::max(tile.x0 - halo, 0) / align * align;
+    in.y0 = std::max(tile.y0 - halo, 0) / align * align;
+    in.x1 = std::min((tile.x1 + halo + align - 1) / align * align, width);
+    in.y1 = std::min((tile.y1 + halo + align - 1) / align * align, height);
+
+    return in;
+}
+
+//
+// Batch mode
+//
+
+struct frame_batch
+{
+    int first;
+    std::vector<AVS_VideoFrame*> frames;
+    bool ok;
+    std::promise<void> done;
+    std::shared_future<void> ready;
+
+    ~frame_batch()
+    {
+        for (AVS_VideoFrame* frame : frames)
+        {
+            if (frame)
+                g_avs_api->avs_release_video_frame(frame);
+        }
+    }
+};
+
+AVS_VideoFrame* batch_get_frame(batch_cache& cache, const int n, const int size, const int num_frames,
+    const std::function<bool(const int first, std::vector<AVS_VideoFrame*>& dst)>& process)
+{
+    const int first{n - n % size};
+    std::shared_ptr<frame_batch> batch;
+    bool owner{false};
+
+    {
+        std::lock_guard<std::mutex> lck(cache.mtx);
+
+        const auto itr{std::find_if(
+            cache.batches.begin(), cache.batches.end(), [&](const std::shared_ptr<frame_batch>& b) { return b->first == first; })};
+        if (itr != cache.batches.end())
+        {
+            batch = *itr;
+            cache.batches.splice(cache.batches.begin(), cache.batches, itr);
+        }
+        else
+        {
+            batch = std::make_shared<frame_batch>();
+            batch->first = first;
+            batch->frames.resize(std::min(size, num_frames - first));
+            batch->ready = batch->done.get_future().share();
+
+            // Evicted batches stay alive until their last user returns.
+            cache.batches.emplace_front(batch);
+            if (cache.batches.size() > max_cached_batches)
+                cache.batches.pop_back();
+
+            owner = true;
+        }
+    }
+
+    if (owner)
+    {
+        batch->ok = process(first, batch->frames);
+        if (!batch->ok)
+        {
+            // Not cached, the next request tries again.
+            std::lock_guard<std::mutex> lck(cache.mtx);
+            cache.batches.remove(batch);
+        }
+
+        batch->done.set_value();
+    }
+    else
+        batch->ready.wait();
+
+    if (!batch->ok)
+        return nullptr;
+
+    return g_avs_api->avs_copy_video_frame(batch->frames[n - first]);
+}
+
+bool upload_atlas(priv* p, pl_tex* tex, pl_buf* buf, const pl_fmt fmt, const std::vector<AVS_VideoFrame*>& frames, const int plane,
+    const int halo)
+{
+    const size_t row_size{static_cast<size_t>(g_avs_api->avs_get_row_size_p(frames[0], plane))};
+    const int height{g_avs_api->avs_get_height_p(frames[0], plane)};
+    const int slot{height + 2 * halo};
+
+    pl_buf_params b_p{};
+    b_p.size = row_size * slot * frames.size();
+    b_p.host_mapped = true;
+
+    if (!pl_buf_recreate(p->gpu, buf, &b_p))
+        return false;
+
+    // The upload of the previous batch may still read from it.
+    while (pl_buf_poll(p->gpu, *buf, UINT64_MAX))
+        ;
+
+    for (size_t k{0}; k < frames.size(); ++k)
+    {
+        const BYTE* srcp{g_avs_api->avs_get_read_ptr_p(frames[k], plane)};
+        const int pitch{g_avs_api->avs_get_pitch_p(frames[k], plane)};
+        uint8_t* dstp{(*buf)->data + k * slot * row_size};
+
+        for (int y{0}; y < slot; ++y)
+            memcpy(dstp + y * row_size, srcp + static_cast<size_t>(std::clamp(y - halo, 0, height - 1)) * pitch, row_size);
+    }
+
+    pl_tex_params t_p{};
+    t_p.format = fmt;
+    t_p.w = static_cast<int>(row_size / fmt->texel_size);
+    t_p.h = slot * static_cast<int>(frames.size());
+    t_p.sampleable = true;
+    t_p.host_writable = true;
+
+    if (!pl_tex_recreate(p->gpu, tex, &t_p))
+        return false;
+
+    pl_tex_transfer_params ttr{};
+    ttr.tex = *tex;
+    ttr.buf = *buf;
+    ttr.row_pitch = row_size;
+    ttr.timer = p->timer;
+
+    if (!pl_tex_upload(p->gpu, &ttr))
+        return false;
+
+    p->bytes_uploaded += b_p.size;
+
+    return true;
+}
+
+// FNV-1a
+uint64_t fnv1a(const uint8_t* data, const size_t size) noexcept
+{
+    uint64_t hash{0xcbf29ce484222325ull};
+    for (size_t i{0}; i < size; ++i)
+        hash = (hash ^ data[i]) * 0x100000001b3ull;
+
+    return hash;
+}
+
+std::string device_id(const priv* p)
+{
+    VkPhysicalDeviceProperties properties{};
+    vkGetPhysicalDeviceProperties(p->dev->vk->phys_device, &properties);
+
+    return std::string(properties.deviceName) + " " + std::to_string(properties.vendorID) + ":" + std::to_string(properties.deviceID) +
+        " " + std::to_string(properties.driverVersion);
+}
+
+//
+// files
+//
+
+std::filesystem::path utf8_path(const std::string& path)
+{
+    return std::filesystem::path{std::u8string{path.begin(), path.end()}};
+}
+
+std::filesystem::path cache_dir()
+{
+    std::filesystem::path dir;
+
+    if (const char* env{std::getenv("AVS_LIBPLACEBO_CACHE_DIR")}; env && *env)
+        dir = utf8_path(env);
+    else
+    {
+#ifdef _WIN32
+        if (const char* local{std::getenv("LOCALAPPDATA")}; local && *local)
+            dir = std::filesystem::path{local} / "avs_libplacebo";
+#else
+        if (const char* xdg{std::getenv("XDG_CACHE_HOME")}; xdg && *xdg)
+            dir = std::filesystem::path{xdg} / "avs_libplacebo";
+        else if (const char* home{std::getenv("HOME")}; home && *home)
+            dir = std::filesystem::path{home} / ".cache" / "avs_libplacebo";
+#endif
+    }
+
+    if (dir.empty())
+        return {};
+
+    std::error_code ec;
+    std::filesystem::create_directories(dir, ec);
+    if (ec || !std::filesystem::is_directory(dir, ec))
+        return {};
+
+    return dir;
+}
+
+bool write_file_atomic(const std::filesystem::path& path, const std::string& data)
+{
+    std::filesystem::path tmp{path};
+    tmp += "." + std::to_string(std::chrono::steady_clock::now().time_since_epoch().count()) + "." +
+           std::to_string(std::hash<std::thread::id>{}(std::this_thread::get_id())) + ".tmp";
+
+    {
+        std::ofstream file(tmp, std::ios::binary | std::ios::trunc);
+        if (!file || !file.write(data.data(), static_cast<std::streamsize>(data.size())) || !file.flush())
+        {
+            file.close();
+            std::error_code ec;
+            std::filesystem::remove(tmp, ec);
+            return false;
+        }
+    }
+
+    std::error_code ec;
+    std::filesystem::rename(tmp, path, ec);
+    if (ec)
+    {
+        std::filesystem::remove(tmp, ec);
+        return false;
+    }
+
+    return true;
+}
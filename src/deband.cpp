@@ -1,59 +1,94 @@
+#include <cmath>
 #include <mutex>
 
 #include "avs_libplacebo.h"
 
 struct deband
 {
-    std::mutex mtx;
-    std::unique_ptr<priv> vf;
+    std::vector<std::unique_ptr<priv>> vf;
     int process[3];
     int dither;
     std::unique_ptr<pl_dither_params> dither_params;
     std::unique_ptr<pl_deband_params> deband_params;
     std::unique_ptr<pl_deband_params> deband_params1;
-    uint8_t frame_index;
+    int stats;
+    // Tile size (0: only when the plane is larger than the texture limit) and the border needed around it.
+    int tile;
+    int halo;
+    // Frames per GPU job (1: no batching).
+    int batch;
+    batch_cache batches;
     std::string msg;
+    // warmup=true.
+    std::thread warmup;
 
-    int (*deband_process)(AVS_VideoFrame* dst, AVS_VideoFrame* src, deband* d, const AVS_FilterInfo* vi) noexcept;
+    int (*deband_process)(
+        AVS_VideoFrame* dst, AVS_VideoFrame* src, deband* d, const AVS_FilterInfo* vi, priv* vf, const int n, gpu_job* job) noexcept;
+    int (*deband_batch_process)(const std::vector<AVS_VideoFrame*>& dst, const std::vector<AVS_VideoFrame*>& src, deband* d,
+        const AVS_FilterInfo* fi, priv* vf, const int first, gpu_job* job) noexcept;
 };
 
-static bool deband_do_plane(deband* d, const int planeIdx) noexcept
+// Seed of the grain and the temporal dither (pl_shader_params::index, 8-bit) of plane `plane` (0..2) of frame `n`. A hash of both, so
+// the output of a frame doesn't depend on the device, the thread or the request order, and the seeds don't repeat in a fixed cycle.
+static uint8_t deband_seed(const int n, const int plane) noexcept
 {
-    pl_shader sh{pl_dispatch_begin(d->vf->dp)};
+    // murmur3 finalizer
+    uint32_t h{static_cast<uint32_t>(n) * 3u + static_cast<uint32_t>(plane)};
+    h ^= h >> 16;
+    h *= 0x85ebca6bu;
+    h ^= h >> 13;
+    h *= 0xc2b2ae35u;
+    h ^= h >> 16;
+
+    return static_cast<uint8_t>(h);
+}
+
+// `rect`: the part of the source texture to deband (batch mode: the slot of one frame), empty for the whole texture. The target always
+// starts at (0, 0), the grain and the dither depend on the output position.
+static bool deband_do_plane(deband* d, priv* vf, const int planeIdx, const uint8_t index, const int tex, const pl_rect2df& rect) noexcept
+{
+    pl_shader sh{pl_dispatch_begin(vf->dp)};
 
     pl_shader_params sh_p{};
-    sh_p.gpu = d->vf->gpu;
-    sh_p.index = d->frame_index++;
+    sh_p.gpu = vf->gpu;
+    sh_p.index = index;
 
     pl_shader_reset(sh, &sh_p);
 
     pl_sample_src src{};
-    src.tex = d->vf->tex_in[0];
+    src.tex = vf->tex_in[tex];
+    src.rect = rect;
 
     pl_shader_deband(sh, &src,
         ((planeIdx == AVS_PLANAR_U || planeIdx == AVS_PLANAR_V) && d->deband_params1) ? d->deband_params1.get() : d->deband_params.get());
 
     if (d->dither)
-        pl_shader_dither(sh, d->vf->tex_out[0]->params.format->component_depth[0], &d->vf->dither_state, d->dither_params.get());
+        pl_shader_dither(sh, vf->tex_out[tex]->params.format->component_depth[0], &vf->dither_state, d->dither_params.get());
 
     pl_dispatch_params d_p{};
-    d_p.target = d->vf->tex_out[0];
+    d_p.target = vf->tex_out[tex];
     d_p.shader = &sh;
+    d_p.timer = vf->timer;
 
-    return pl_dispatch_finish(d->vf->dp, &d_p);
+    return pl_dispatch_finish(vf->dp, &d_p);
 }
 
 template<typename T>
-static int deband_filter(AVS_VideoFrame* dst, AVS_VideoFrame* src, deband* d, const AVS_FilterInfo* fi) noexcept
+static pl_fmt deband_fmt(const pl_gpu gpu) noexcept
 {
-    const pl_fmt fmt{[&]() {
-        if constexpr (std::is_same_v<T, uint8_t>)
-            return pl_find_named_fmt(d->vf->gpu, "r8");
-        else if constexpr (std::is_same_v<T, uint16_t>)
-            return pl_find_named_fmt(d->vf->gpu, "r16");
-        else
-            return pl_find_named_fmt(d->vf->gpu, "r32f");
-    }()};
+    if constexpr (std::is_same_v<T, uint8_t>)
+        return pl_find_named_fmt(gpu, "r8");
+    else if constexpr (std::is_same_v<T, uint16_t>)
+        return pl_find_named_fmt(gpu, "r16");
+    else
+        return pl_find_named_fmt(gpu, "r32f");
+}
+
+template<typename T>
+static int deband_filter(
+    AVS_VideoFrame* dst, AVS_VideoFrame* src, deband* d, const AVS_FilterInfo* fi, priv* vf, const int n, gpu_job* job) noexcept
+{
+    const pl_fmt fmt{deband_fmt<T>(vf->gpu)};
     if (!fmt)
         return -1;
 
@@ -62,8 +97,6 @@ static int deband_filter(AVS_VideoFrame* dst, AVS_VideoFrame* src, deband* d, co
     const int* planes{(avs_is_rgb(&fi->vi)) ? planes_r : planes_y};
     const int num_planes{std::min(g_avs_api->avs_num_components(&fi->vi), 3)};
 
-    std::lock_guard<std::mutex> lck(d->mtx);
-
     for (int i{0}; i < num_planes; ++i)
     {
         const int plane{planes[i]};
@@ -91,49 +124,208 @@ static int deband_filter(AVS_VideoFrame* dst, AVS_VideoFrame* src, deband* d, co
                 pl.type = PL_FMT_FLOAT;
                 pl.component_size[0] = 32;
             }
-            pl.width = g_avs_api->avs_get_row_size_p(src, plane) / sizeof(T);
-            pl.height = g_avs_api->avs_get_height_p(src, plane);
-            pl.row_stride = g_avs_api->avs_get_pitch_p(src, plane);
-            pl.pixels = g_avs_api->avs_get_read_ptr_p(src, plane);
+            const int width{static_cast<int>(g_avs_api->avs_get_row_size_p(src, plane) / sizeof(T))};
+            const int height{g_avs_api->avs_get_height_p(src, plane)};
+            const int src_pitch{g_avs_api->avs_get_pitch_p(src, plane)};
+            const int dst_pitch{g_avs_api->avs_get_pitch_p(dst, plane)};
+            const BYTE* srcp{g_avs_api->avs_get_read_ptr_p(src, plane)};
+            BYTE* dstp{g_avs_api->avs_get_write_ptr_p(dst, plane)};
+
+            const std::vector<pl_rect2d> tiles{split_tiles(width, height, tile_size(d->tile, vf->gpu, d->halo, 1))};
+
+            for (size_t t{0}; t < tiles.size(); ++t)
+            {
+                const pl_rect2d& out{tiles[t]};
+                const pl_rect2d in{tile_input(out, d->halo, 1, width, height)};
+                // Alternate the textures, so the upload of the next tile doesn't wait for the previous one.
+                const int tex{static_cast<int>(t % 2)};
+
+                pl.width = in.x1 - in.x0;
+                pl.height = in.y1 - in.y0;
+                pl.row_stride = src_pitch;
+                pl.pixels = srcp + static_cast<size_t>(in.y0) * src_pitch + in.x0 * sizeof(T);
+
+                // Upload planes
+                if (!pl_upload_plane(vf->gpu, nullptr, &vf->tex_in[tex], &pl))
+                    return -1;
+
+                vf->bytes_uploaded += static_cast<uint64_t>(pl.width) * pl.height * sizeof(T);
+
+                pl_tex_params t_r{};
+                t_r.format = fmt;
+                t_r.w = pl.width;
+                t_r.h = pl.height;
+                t_r.sampleable = false;
+                t_r.host_writable = false;
+                t_r.renderable = true;
+                t_r.host_readable = true;
+
+                if (!pl_tex_recreate(vf->gpu, &vf->tex_out[tex], &t_r))
+                    return -1;
+
+                // Process plane
+                if (!deband_do_plane(d, vf, plane, deband_seed(n, i), tex, {}))
+                    return -1;
+
+                // Only the inner part of the tile, the halo is covered by the neighbours.
+                pl_tex_transfer_params ttr{};
+                ttr.tex = vf->tex_out[tex];
+                ttr.rc.x0 = out.x0 - in.x0;
+                ttr.rc.y0 = out.y0 - in.y0;
+                ttr.rc.z0 = 0;
+                ttr.rc.x1 = out.x1 - in.x0;
+                ttr.rc.y1 = out.y1 - in.y0;
+                ttr.rc.z1 = 1;
+                ttr.row_pitch = dst_pitch;
+                ttr.ptr = dstp + static_cast<size_t>(out.y0) * dst_pitch + out.x0 * sizeof(T);
+                ttr.timer = vf->timer;
+
+                // Download planes
+                if (!gpu_download(job, vf->gpu, ttr))
+                    return -1;
+
+                vf->bytes_downloaded += static_cast<uint64_t>(out.x1 - out.x0) * (out.y1 - out.y0) * sizeof(T);
+            }
+        }
+    }
+
+    return 0;
+}
+
+// All frames of the batch are uploaded at once, then debanded and downloaded one by one (the output of a frame is the same as without
+// batch).
+template<typename T>
+static int deband_filter_batch(const std::vector<AVS_VideoFrame*>& dst, const std::vector<AVS_VideoFrame*>& src, deband* d,
+    const AVS_FilterInfo* fi, priv* vf, const int first, gpu_job* job) noexcept
+{
+    const pl_fmt fmt{deband_fmt<T>(vf->gpu)};
+    if (!fmt)
+        return -1;
+
+    constexpr int planes_y[3]{AVS_PLANAR_Y, AVS_PLANAR_U, AVS_PLANAR_V};
+    constexpr int planes_r[3]{AVS_PLANAR_R, AVS_PLANAR_G, AVS_PLANAR_B};
+    const int* planes{(avs_is_rgb(&fi->vi)) ? planes_r : planes_y};
+    const int num_planes{std::min(g_avs_api->avs_num_components(&fi->vi), 3)};
+
+    for (int i{0}; i < num_planes; ++i)
+    {
+        const int plane{planes[i]};
+
+        if (d->process[i] == 2)
+        {
+            for (size_t k{0}; k < src.size(); ++k)
+                g_avs_api->avs_bit_blt(fi->env, g_avs_api->avs_get_write_ptr_p(dst[k], plane), g_avs_api->avs_get_pitch_p(dst[k], plane),
+                    g_avs_api->avs_get_read_ptr_p(src[k], plane), g_avs_api->avs_get_pitch_p(src[k], plane),
+                    g_avs_api->avs_get_row_size_p(src[k], plane), g_avs_api->avs_get_height_p(src[k], plane));
+        }
+        else if (d->process[i] == 3)
+        {
+            const int width{static_cast<int>(g_avs_api->avs_get_row_size_p(src[0], plane) / sizeof(T))};
+            const int height{g_avs_api->avs_get_height_p(src[0], plane)};
+            const int slot{height + 2 * d->halo};
 
             // Upload planes
-            if (!pl_upload_plane(d->vf->gpu, nullptr, &d->vf->tex_in[0], &pl))
+            if (!upload_atlas(vf, &vf->tex_in[i], &vf->atlas[i], fmt, src, plane, d->halo))
                 return -1;
 
             pl_tex_params t_r{};
             t_r.format = fmt;
-            t_r.w = pl.width;
-            t_r.h = pl.height;
+            t_r.w = width;
+            t_r.h = height;
             t_r.sampleable = false;
             t_r.host_writable = false;
             t_r.renderable = true;
             t_r.host_readable = true;
 
-            if (!pl_tex_recreate(d->vf->gpu, &d->vf->tex_out[0], &t_r))
-                return -1;
-
-            // Process plane
-            if (!deband_do_plane(d, plane))
+            if (!pl_tex_recreate(vf->gpu, &vf->tex_out[i], &t_r))
                 return -1;
 
-            pl_tex_transfer_params ttr{};
-            ttr.tex = d->vf->tex_out[0];
-            ttr.row_pitch = g_avs_api->avs_get_pitch_p(dst, plane);
-            ttr.ptr = g_avs_api->avs_get_write_ptr_p(dst, plane);
-
-            // Download planes
-            if (!pl_tex_download(d->vf->gpu, &ttr))
-                return -1;
+            for (size_t k{0}; k < dst.size(); ++k)
+            {
+                // Process plane, the slot of the frame without the halo rows.
+                const float y0{static_cast<float>(static_cast<int>(k) * slot + d->halo)};
+                if (!deband_do_plane(d, vf, plane, deband_seed(first + static_cast<int>(k), i), i,
+                        {0.0f, y0, static_cast<float>(width), y0 + static_cast<float>(height)}))
+                    return -1;
+
+                // Download planes
+                pl_tex_transfer_params ttr{};
+                ttr.tex = vf->tex_out[i];
+                ttr.rc.x0 = 0;
+                ttr.rc.y0 = 0;
+                ttr.rc.z0 = 0;
+                ttr.rc.x1 = width;
+                ttr.rc.y1 = height;
+                ttr.rc.z1 = 1;
+                ttr.row_pitch = g_avs_api->avs_get_pitch_p(dst[k], plane);
+                ttr.ptr = g_avs_api->avs_get_write_ptr_p(dst[k], plane);
+                ttr.timer = vf->timer;
+
+                if (!gpu_download(job, vf->gpu, ttr))
+                    return -1;
+
+                vf->bytes_downloaded += static_cast<uint64_t>(width) * height * sizeof(T);
+            }
         }
     }
 
     return 0;
 }
 
+static void deband_copy_alpha(const AVS_FilterInfo* fi, AVS_VideoFrame* dst, AVS_VideoFrame* src)
+{
+    if (g_avs_api->avs_num_components(&fi->vi) > 3)
+        g_avs_api->avs_bit_blt(fi->env, g_avs_api->avs_get_write_ptr_p(dst, AVS_PLANAR_A), g_avs_api->avs_get_pitch_p(dst, AVS_PLANAR_A),
+            g_avs_api->avs_get_read_ptr_p(src, AVS_PLANAR_A), g_avs_api->avs_get_pitch_p(src, AVS_PLANAR_A),
+            g_avs_api->avs_get_row_size_p(src, AVS_PLANAR_A), g_avs_api->avs_get_height_p(src, AVS_PLANAR_A));
+}
+
+static bool deband_batch(AVS_FilterInfo* fi, deband* d, const int first, std::vector<AVS_VideoFrame*>& dst)
+{
+    std::vector<avs_helpers::avs_video_frame_ptr> src_ptr;
+    std::vector<AVS_VideoFrame*> src;
+    uint64_t staging_bytes{0};
+
+    for (size_t k{0}; k < dst.size(); ++k)
+    {
+        src_ptr.emplace_back(g_avs_api->avs_get_frame(fi->child, first + static_cast<int>(k)));
+        src.emplace_back(src_ptr.back().get());
+        if (!src.back())
+            return false;
+
+        dst[k] = g_avs_api->avs_new_video_frame_p(fi->env, &fi->vi, src[k]);
+        staging_bytes += frame_size(src[k], &fi->vi) + frame_size(dst[k], &fi->vi);
+    }
+
+    std::string err;
+    priv* vf{gpu_select(d->vf, first)};
+    if (!gpu_run(vf, first, staging_bytes, [&](gpu_job* job) { return !d->deband_batch_process(dst, src, d, fi, vf, first, job); }, err))
+    {
+        frame_error(fi, "libplacebo_Deband: " + err);
+
+        return false;
+    }
+
+    for (size_t k{0}; k < dst.size(); ++k)
+    {
+        deband_copy_alpha(fi, dst[k], src[k]);
+
+        // The whole batch is accounted to its first frame.
+        if (d->stats)
+            set_stats_props(fi->env, dst[k], vf, take_stats());
+    }
+
+    return true;
+}
+
 static AVS_VideoFrame* AVSC_CC deband_get_frame(AVS_FilterInfo* fi, int n)
 {
     deband* d{reinterpret_cast<deband*>(fi->user_data)};
 
+    if (d->batch > 1)
+        return batch_get_frame(d->batches, n, d->batch, fi->vi.num_frames,
+            [&](const int first, std::vector<AVS_VideoFrame*>& dst) { return deband_batch(fi, d, first, dst); });
+
     avs_helpers::avs_video_frame_ptr src_ptr{ g_avs_api->avs_get_frame(fi->child, n) };
     AVS_VideoFrame* src{ src_ptr.get() };
     if (!src)
@@ -142,21 +334,21 @@ static AVS_VideoFrame* AVSC_CC deband_get_frame(AVS_FilterInfo* fi, int n)
     avs_helpers::avs_video_frame_ptr dst_ptr{g_avs_api->avs_new_video_frame_p(fi->env, &fi->vi, src)};
     AVS_VideoFrame* dst{dst_ptr.get()};
 
-    if (d->deband_process(dst, src, d, fi))
+    const uint64_t staging_bytes{frame_size(src, &fi->vi) + frame_size(dst, &fi->vi)};
+    std::string err;
+    priv* vf{gpu_select(d->vf, n)};
+    if (!gpu_run(vf, n, staging_bytes, [&](gpu_job* job) { return !d->deband_process(dst, src, d, fi, vf, n, job); }, err))
     {
-        d->msg = "libplacebo_Deband: " + d->vf->log_buffer.str();
-
-        fi->error = d->msg.c_str();
+        frame_error(fi, "libplacebo_Deband: " + err);
 
         return nullptr;
     }
     else
     {
-        if (g_avs_api->avs_num_components(&fi->vi) > 3)
-            g_avs_api->avs_bit_blt(fi->env, g_avs_api->avs_get_write_ptr_p(dst, AVS_PLANAR_A),
-                g_avs_api->avs_get_pitch_p(dst, AVS_PLANAR_A), g_avs_api->avs_get_read_ptr_p(src, AVS_PLANAR_A),
-                g_avs_api->avs_get_pitch_p(src, AVS_PLANAR_A), g_avs_api->avs_get_row_size_p(src, AVS_PLANAR_A),
-                g_avs_api->avs_get_height_p(src, AVS_PLANAR_A));
+        deband_copy_alpha(fi, dst, src);
+
+        if (d->stats)
+            set_stats_props(fi->env, dst, vf, take_stats());
 
         return dst_ptr.release();
     }
@@ -166,13 +358,16 @@ static void AVSC_CC free_deband(AVS_FilterInfo* fi)
 {
     deband* d{reinterpret_cast<deband*>(fi->user_data)};
 
+    if (d->warmup.joinable())
+        d->warmup.join();
+
     avs_libplacebo_uninit(d->vf);
     delete d;
 }
 
 static int AVSC_CC deband_set_cache_hints(AVS_FilterInfo* fi, int cachehints, int frame_range)
 {
-    return cachehints == AVS_CACHE_GET_MTMODE ? 2 : 0;
+    return cachehints == AVS_CACHE_GET_MTMODE ? AVS_MT_NICE_FILTER : 0;
 }
 
 AVS_Value AVSC_CC create_deband(AVS_ScriptEnvironment* env, AVS_Value args, void* param)
@@ -191,7 +386,11 @@ AVS_Value AVSC_CC create_deband(AVS_ScriptEnvironment* env, AVS_Value args, void
         Planes,
         Device,
         List_device,
-        Grain_neutral
+        Grain_neutral,
+        Stats,
+        Tile,
+        Batch,
+        Warmup
     };
 
     AVS_FilterInfo* fi;
@@ -211,39 +410,16 @@ AVS_Value AVSC_CC create_deband(AVS_ScriptEnvironment* env, AVS_Value args, void
     if (bits != 8 && bits != 16 && bits != 32)
         return set_error("libplacebo_Deband: bit depth must be 8, 16 or 32-bit.", nullptr);
 
-    const int device{avs_defined(avs_array_elt(args, Device)) ? avs_as_int(avs_array_elt(args, Device)) : -1};
     const int list_device{avs_defined(avs_array_elt(args, List_device)) ? avs_as_bool(avs_array_elt(args, List_device)) : 0};
 
-    if (list_device || device > -1)
+    AVS_Value dev_init{
+        avs_libplacebo_init(clip, fi->env, avs_array_elt(args, Device), list_device, params->vf, params->msg, "libplacebo_Deband", 0)};
+    if (avs_is_error(dev_init) || avs_is_clip(dev_init))
     {
-        std::vector<VkPhysicalDevice> devices{};
-        VkInstance inst{};
-
-        AVS_Value dev_info{devices_info(clip, fi->env, devices, inst, params->msg, "libplacebo_Deband", device, list_device)};
-        if (avs_is_error(dev_info) || avs_is_clip(dev_info))
-        {
-            fi->user_data = params.release();
-            fi->free_filter = free_deband;
-
-            return dev_info;
-        }
+        fi->user_data = params.release();
+        fi->free_filter = free_deband;
 
-        params->vf = avs_libplacebo_init(devices[device], params->msg);
-
-        vkDestroyInstance(inst, nullptr);
-    }
-    else
-    {
-        if (device < -1)
-            return set_error("libplacebo_Deband: device must be greater than or equal to -1.", nullptr);
-
-        params->vf = avs_libplacebo_init(nullptr, params->msg);
-    }
-
-    if (params->msg.size())
-    {
-        params->msg = "libplacebo_Deband: " + params->msg;
-        return set_error(params->msg.c_str(), nullptr);
+        return dev_init;
     }
 
     if (bits == 8)
@@ -337,21 +513,80 @@ AVS_Value AVSC_CC create_deband(AVS_ScriptEnvironment* env, AVS_Value args, void
         params->deband_params1->grain = grainC;
     }
 
-    params->frame_index = 0;
+    params->tile = avs_defined(avs_array_elt(args, Tile)) ? avs_as_int(avs_array_elt(args, Tile)) : 0;
+    if (params->tile < 0)
+        return set_error("libplacebo_Deband: tile must be greater than or equal to 0.", params->vf);
+
+    // The radius grows with every iteration.
+    params->halo = static_cast<int>(std::ceil(params->deband_params->radius * std::max(params->deband_params->iterations, 1))) + 1;
+
+    params->batch = avs_defined(avs_array_elt(args, Batch)) ? avs_as_int(avs_array_elt(args, Batch)) : 1;
+    if (params->batch < 1)
+        return set_error("libplacebo_Deband: batch must be greater than or equal to 1.", params->vf);
+    if (params->batch > 1)
+    {
+        if (params->tile > 0)
+            return set_error("libplacebo_Deband: batch and tile can't be used together.", params->vf);
+
+        // The atlas of the luma plane is the largest. The limit needs the device.
+        if (!gpu_context(params->vf, params->msg, "libplacebo_Deband"))
+            return set_error(params->msg.c_str(), params->vf);
+
+        for (const auto& vf : params->vf)
+        {
+            const int max_dim{static_cast<int>(vf->gpu->limits.max_tex_2d_dim)};
+            if (fi->vi.width > max_dim || static_cast<int64_t>(fi->vi.height + 2 * params->halo) * params->batch > max_dim)
+                return set_error("libplacebo_Deband: batch is too large for the frame size.", params->vf);
+        }
+    }
+
+    params->stats = avs_defined(avs_array_elt(args, Stats)) ? avs_as_bool(avs_array_elt(args, Stats)) : 0;
+    if (params->stats)
+    {
+        // Created by the first job.
+        for (const auto& vf : params->vf)
+            vf->use_timer = 1;
+    }
 
     switch (bits)
     {
     case 8:
         params->deband_process = deband_filter<uint8_t>;
+        params->deband_batch_process = deband_filter_batch<uint8_t>;
         break;
     case 16:
         params->deband_process = deband_filter<uint16_t>;
+        params->deband_batch_process = deband_filter_batch<uint16_t>;
         break;
     default:
         params->deband_process = deband_filter<float>;
+        params->deband_batch_process = deband_filter_batch<float>;
         break;
     }
 
+    if (avs_defined(avs_array_elt(args, Warmup)) && avs_as_bool(avs_array_elt(args, Warmup)))
+    {
+        // One frame per frame of a batch.
+        std::vector<AVS_VideoFrame*> src;
+        std::vector<AVS_VideoFrame*> dst;
+        for (int k{0}; k < params->batch; ++k)
+        {
+            src.emplace_back(g_avs_api->avs_new_video_frame_a(fi->env, &fi->vi, AVS_FRAME_ALIGN));
+            dst.emplace_back(g_avs_api->avs_new_video_frame_a(fi->env, &fi->vi, AVS_FRAME_ALIGN));
+        }
+
+        std::vector<AVS_VideoFrame*> frames{src};
+        frames.insert(frames.end(), dst.begin(), dst.end());
+
+        deband* d{params.get()};
+        params->warmup = gpu_warmup(params->vf, frames, [=](priv* vf, gpu_job* job) {
+            if (d->batch > 1)
+                return !d->deband_batch_process(dst, src, d, fi, vf, 0, job);
+
+            return !d->deband_process(dst[0], src[0], d, fi, vf, 0, job);
+        });
+    }
+
     AVS_Value v;
     g_avs_api->avs_set_to_clip(&v,clip);
 
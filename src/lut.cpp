@@ -0,0 +1,478 @@
+#include <cerrno>
+#include <cstring>
+#include <fstream>
+#include <map>
+#include <mutex>
+#include <sstream>
+
+#include "avs_libplacebo.h"
+
+// Parsed .cube file, shared by all instances that use the same file.
+struct cube_lut
+{
+    pl_custom_lut* lut;
+
+    ~cube_lut()
+    {
+        pl_lut_free(&lut);
+    }
+};
+
+// Key: absolute path, size and modification time, so a changed file is parsed again.
+static std::mutex cube_cache_mtx;
+static std::map<std::string, std::weak_ptr<const cube_lut>> cube_cache;
+
+static std::shared_ptr<const cube_lut> cube_get(const std::string& path, std::string& err)
+{
+    const std::filesystem::path file_path{utf8_path(path)};
+
+    std::error_code ec;
+    const std::filesystem::path abs_path{std::filesystem::absolute(file_path, ec)};
+    const uintmax_t size{std::filesystem::file_size(file_path, ec)};
+    if (ec)
+    {
+        err = "error opening file " + path + " (" + ec.message() + ")";
+        return nullptr;
+    }
+    const auto mtime{std::filesystem::last_write_time(file_path, ec).time_since_epoch().count()};
+
+    const std::string key{abs_path.string() + '|' + std::to_string(size) + '|' + std::to_string(mtime)};
+
+    std::lock_guard<std::mutex> lck(cube_cache_mtx);
+
+    for (auto itr{cube_cache.begin()}; itr != cube_cache.end();)
+    {
+        if (itr->second.expired())
+            itr = cube_cache.erase(itr);
+        else
+            ++itr;
+    }
+
+    if (const auto itr{cube_cache.find(key)}; itr != cube_cache.end())
+        return itr->second.lock();
+
+    std::ifstream file(file_path, std::ios::binary);
+    if (!file)
+    {
+        err = "error opening file " + path + " (" + std::strerror(errno) + ")";
+        return nullptr;
+    }
+
+    std::ostringstream data;
+    data << file.rdbuf();
+    const std::string str{data.str()};
+
+    std::shared_ptr<cube_lut> cube{std::make_shared<cube_lut>()};
+    cube->lut = pl_lut_parse_cube(nullptr, str.c_str(), str.size());
+    if (!cube->lut)
+    {
+        err = "failed parsing " + path + ".";
+        return nullptr;
+    }
+
+    cube_cache[key] = cube;
+
+    return cube;
+}
+
+struct lut
+{
+    std::vector<std::unique_ptr<priv>> vf;
+    std::shared_ptr<const cube_lut> cube;
+    enum pl_lut_type lut_type;
+    // PL_COLOR_SYSTEM_UNKNOWN: from the frame properties.
+    enum pl_color_system matrix;
+    // PL_COLOR_SYSTEM_UNKNOWN: the source matrix.
+    enum pl_color_system dst_matrix;
+    // PL_COLOR_LEVELS_UNKNOWN: from the frame properties.
+    enum pl_color_levels range;
+    enum pl_chroma_location chromaLocation;
+    enum pl_color_transfer trc;
+    int rgb;
+    int subsampled;
+    int stats;
+    std::string msg;
+    // warmup=true.
+    std::thread warmup;
+};
+
+// Per frame (matrix and range of the source can come from its properties).
+struct lut_frame
+{
+    pl_color_repr src_repr;
+    pl_color_repr dst_repr;
+};
+
+static bool lut_do_plane(const lut* d, priv* vf, const pl_plane* planes, const lut_frame& f) noexcept
+{
+    pl_color_space csp{};
+    csp.transfer = d->trc;
+
+    pl_frame img{};
+    img.num_planes = 3;
+    img.repr = f.src_repr;
+    img.planes[0] = planes[0];
+    img.planes[1] = planes[1];
+    img.planes[2] = planes[2];
+    img.color = csp;
+
+    pl_frame out{};
+    out.num_planes = 3;
+    out.repr = f.dst_repr;
+    out.color = csp;
+
+    for (int i{0}; i < 3; ++i)
+    {
+        out.planes[i].texture = vf->tex_out[i];
+        out.planes[i].components = 1;
+        out.planes[i].component_mapping[0] = i;
+    }
+
+    // The output has the subsampling of the source.
+    if (d->subsampled)
+    {
+        pl_frame_set_chroma_location(&img, d->chromaLocation);
+        pl_frame_set_chroma_location(&out, d->chromaLocation);
+    }
+
+    pl_render_params render_params{pl_render_default_params};
+    render_params.lut = d->cube->lut;
+    render_params.lut_type = d->lut_type;
+
+    if (d->stats)
+    {
+        render_params.info_callback = stats_render_info;
+        render_params.info_priv = vf;
+    }
+
+    return pl_render_image(vf->rr, &img, &out, &render_params);
+}
+
+static int lut_filter(AVS_VideoFrame* dst, AVS_VideoFrame* src, const lut* d, const AVS_FilterInfo* fi, priv* vf, const lut_frame& f,
+    gpu_job* job) noexcept
+{
+    const int size{g_avs_api->avs_component_size(&fi->vi)};
+    const pl_fmt fmt{pl_find_named_fmt(vf->gpu, (size == 1) ? "r8" : ((size == 2) ? "r16" : "r32f"))};
+    if (!fmt)
+        return -1;
+
+    constexpr int planes_y[3]{AVS_PLANAR_Y, AVS_PLANAR_U, AVS_PLANAR_V};
+    constexpr int planes_r[3]{AVS_PLANAR_R, AVS_PLANAR_G, AVS_PLANAR_B};
+    const int* planes{(d->rgb) ? planes_r : planes_y};
+
+    pl_plane pl_planes[3]{};
+
+    for (int i{0}; i < 3; ++i)
+    {
+        const int plane{planes[i]};
+
+        pl_plane_data pl{};
+        pl.type = (size == 4) ? PL_FMT_FLOAT : PL_FMT_UNORM;
+        pl.pixel_stride = size;
+        pl.component_size[0] = size * 8;
+        pl.width = g_avs_api->avs_get_row_size_p(src, plane) / size;
+        pl.height = g_avs_api->avs_get_height_p(src, plane);
+        pl.row_stride = g_avs_api->avs_get_pitch_p(src, plane);
+        pl.pixels = g_avs_api->avs_get_read_ptr_p(src, plane);
+        pl.component_map[0] = i;
+
+        // Upload planes
+        if (!pl_upload_plane(vf->gpu, &pl_planes[i], &vf->tex_in[i], &pl))
+            return -1;
+
+        vf->bytes_uploaded += static_cast<uint64_t>(pl.width) * pl.height * size;
+
+        pl_tex_params t_r{};
+        t_r.w = pl.width;
+        t_r.h = pl.height;
+        t_r.format = fmt;
+        t_r.renderable = true;
+        t_r.host_readable = true;
+
+        if (!pl_tex_recreate(vf->gpu, &vf->tex_out[i], &t_r))
+            return -1;
+    }
+
+    // Process plane
+    if (!lut_do_plane(d, vf, pl_planes, f))
+        return -1;
+
+    // Download planes
+    for (int i{0}; i < 3; ++i)
+    {
+        pl_tex_transfer_params ttr1{};
+        ttr1.tex = vf->tex_out[i];
+        ttr1.row_pitch = g_avs_api->avs_get_pitch_p(dst, planes[i]);
+        ttr1.ptr = g_avs_api->avs_get_write_ptr_p(dst, planes[i]);
+        ttr1.timer = vf->timer;
+
+        if (!gpu_download(job, vf->gpu, ttr1))
+            return -1;
+
+        vf->bytes_downloaded += static_cast<uint64_t>(vf->tex_out[i]->params.w) * vf->tex_out[i]->params.h * size;
+    }
+
+    return 0;
+}
+
+static pl_color_system matrix_from_prop(const int64_t matrix)
+{
+    switch (matrix)
+    {
+    case 5:
+    case 6:
+        return PL_COLOR_SYSTEM_BT_601;
+    case 7:
+        return PL_COLOR_SYSTEM_SMPTE_240M;
+    case 8:
+        return PL_COLOR_SYSTEM_YCGCO;
+    case 9:
+        return PL_COLOR_SYSTEM_BT_2020_NC;
+    case 10:
+        return PL_COLOR_SYSTEM_BT_2020_C;
+    case 14:
+        return PL_COLOR_SYSTEM_BT_2100_PQ;
+    default:
+        return PL_COLOR_SYSTEM_BT_709;
+    }
+}
+
+static int matrix_to_prop(const pl_color_system matrix)
+{
+    switch (matrix)
+    {
+    case PL_COLOR_SYSTEM_BT_601:
+        return 6;
+    case PL_COLOR_SYSTEM_BT_709:
+        return 1;
+    case PL_COLOR_SYSTEM_SMPTE_240M:
+        return 7;
+    case PL_COLOR_SYSTEM_YCGCO:
+        return 8;
+    case PL_COLOR_SYSTEM_BT_2020_NC:
+        return 9;
+    case PL_COLOR_SYSTEM_BT_2020_C:
+        return 10;
+    case PL_COLOR_SYSTEM_BT_2100_PQ:
+    case PL_COLOR_SYSTEM_BT_2100_HLG:
+        return 14;
+    default:
+        return 2;
+    }
+}
+
+static lut_frame lut_frame_info(const lut* d, const AVS_FilterInfo* fi, AVS_VideoFrame* src)
+{
+    const AVS_Map* props{g_avs_api->avs_get_frame_props_ro(fi->env, src)};
+    const int bits{g_avs_api->avs_bits_per_component(&fi->vi)};
+
+    lut_frame f{};
+    f.src_repr.bits.color_depth = (bits == 32) ? 0 : bits;
+    f.src_repr.bits.sample_depth = g_avs_api->avs_component_size(&fi->vi) * 8;
+
+    if (d->rgb)
+    {
+        f.src_repr.sys = PL_COLOR_SYSTEM_RGB;
+        f.src_repr.levels = PL_COLOR_LEVELS_FULL;
+    }
+    else
+    {
+        int err{0};
+
+        f.src_repr.sys = d->matrix;
+        if (f.src_repr.sys == PL_COLOR_SYSTEM_UNKNOWN)
+        {
+            const int64_t matrix{g_avs_api->avs_prop_get_int(fi->env, props, "_Matrix", 0, &err)};
+            f.src_repr.sys = (err) ? PL_COLOR_SYSTEM_BT_709 : matrix_from_prop(matrix);
+        }
+
+        f.src_repr.levels = d->range;
+        if (f.src_repr.levels == PL_COLOR_LEVELS_UNKNOWN)
+        {
+            const int64_t r{g_avs_api->avs_prop_get_int(fi->env, props, "_ColorRange", 0, &err)};
+            f.src_repr.levels = (err || r) ? PL_COLOR_LEVELS_LIMITED : PL_COLOR_LEVELS_FULL;
+        }
+    }
+
+    f.dst_repr = f.src_repr;
+    if (d->dst_matrix != PL_COLOR_SYSTEM_UNKNOWN)
+        f.dst_repr.sys = d->dst_matrix;
+
+    return f;
+}
+
+static AVS_VideoFrame* AVSC_CC lut_get_frame(AVS_FilterInfo* fi, int n)
+{
+    lut* d{reinterpret_cast<lut*>(fi->user_data)};
+
+    avs_helpers::avs_video_frame_ptr src_ptr{g_avs_api->avs_get_frame(fi->child, n)};
+    AVS_VideoFrame* src{src_ptr.get()};
+    if (!src)
+        return nullptr;
+
+    avs_helpers::avs_video_frame_ptr dst_ptr{g_avs_api->avs_new_video_frame_p(fi->env, &fi->vi, src)};
+    AVS_VideoFrame* dst{dst_ptr.get()};
+
+    const lut_frame f{lut_frame_info(d, fi, src)};
+
+    const uint64_t staging_bytes{frame_size(src, &fi->vi) + frame_size(dst, &fi->vi)};
+    std::string err;
+    priv* vf{gpu_select(d->vf, n)};
+    if (!gpu_run(vf, n, staging_bytes, [&](gpu_job* job) { return !lut_filter(dst, src, d, fi, vf, f, job); }, err))
+    {
+        frame_error(fi, "libplacebo_LUT: " + err);
+
+        return nullptr;
+    }
+
+    if (g_avs_api->avs_num_components(&fi->vi) > 3)
+        g_avs_api->avs_bit_blt(fi->env, g_avs_api->avs_get_write_ptr_p(dst, AVS_PLANAR_A), g_avs_api->avs_get_pitch_p(dst, AVS_PLANAR_A),
+            g_avs_api->avs_get_read_ptr_p(src, AVS_PLANAR_A), g_avs_api->avs_get_pitch_p(src, AVS_PLANAR_A),
+            g_avs_api->avs_get_row_size_p(src, AVS_PLANAR_A), g_avs_api->avs_get_height_p(src, AVS_PLANAR_A));
+
+    if (!d->rgb)
+    {
+        AVS_Map* dst_props{g_avs_api->avs_get_frame_props_rw(fi->env, dst)};
+        g_avs_api->avs_prop_set_int(fi->env, dst_props, "_Matrix", matrix_to_prop(f.dst_repr.sys), 0);
+        g_avs_api->avs_prop_set_int(fi->env, dst_props, "_ColorRange", (f.dst_repr.levels == PL_COLOR_LEVELS_FULL) ? 0 : 1, 0);
+    }
+
+    if (d->stats)
+        set_stats_props(fi->env, dst, vf, take_stats());
+
+    return dst_ptr.release();
+}
+
+static void AVSC_CC free_lut(AVS_FilterInfo* fi)
+{
+    lut* d{reinterpret_cast<lut*>(fi->user_data)};
+
+    if (d->warmup.joinable())
+        d->warmup.join();
+
+    avs_libplacebo_uninit(d->vf);
+    delete d;
+}
+
+static int AVSC_CC lut_set_cache_hints(AVS_FilterInfo* fi, int cachehints, int frame_range)
+{
+    return cachehints == AVS_CACHE_GET_MTMODE ? AVS_MT_NICE_FILTER : 0;
+}
+
+AVS_Value AVSC_CC create_lut(AVS_ScriptEnvironment* env, AVS_Value args, void* param)
+{
+    enum
+    {
+        Clip,
+        Lut,
+        Lut_type,
+        Matrix,
+        Dst_matrix,
+        Range,
+        Chroma_loc,
+        Trc,
+        Device,
+        List_device,
+        Stats,
+        Warmup
+    };
+
+    AVS_FilterInfo* fi;
+    avs_helpers::avs_clip_ptr clip_ptr{g_avs_api->avs_new_c_filter(env, &fi, avs_array_elt(args, Clip), 1)};
+    AVS_Clip* clip{clip_ptr.get()};
+
+    std::unique_ptr<lut> params{std::make_unique<lut>()};
+
+    AVS_Value avs_ver{avs_version(params->msg, "libplacebo_LUT", env)};
+    if (avs_is_error(avs_ver))
+        return avs_ver;
+
+    if (!avs_is_planar(&fi->vi) || g_avs_api->avs_num_components(&fi->vi) < 3)
+        return set_error("libplacebo_LUT: clip must be in YUV or RGB planar format.", nullptr);
+
+    params->rgb = avs_is_rgb(&fi->vi);
+    if (g_avs_api->avs_bits_per_component(&fi->vi) == 32 && !params->rgb)
+        return set_error("libplacebo_LUT: 32-bit clips must be RGB.", nullptr);
+
+    const int list_device{avs_defined(avs_array_elt(args, List_device)) ? avs_as_bool(avs_array_elt(args, List_device)) : 0};
+
+    AVS_Value dev_init{
+        avs_libplacebo_init(clip, fi->env, avs_array_elt(args, Device), list_device, params->vf, params->msg, "libplacebo_LUT", 1)};
+    if (avs_is_error(dev_init) || avs_is_clip(dev_init))
+    {
+        fi->user_data = params.release();
+        fi->free_filter = free_lut;
+
+        return dev_init;
+    }
+
+    params->cube = cube_get(avs_as_string(avs_array_elt(args, Lut)), params->msg);
+    if (!params->cube)
+    {
+        params->msg = "libplacebo_LUT: " + params->msg;
+        return set_error(params->msg.c_str(), params->vf);
+    }
+
+    const int lut_type{(avs_defined(avs_array_elt(args, Lut_type))) ? avs_as_int(avs_array_elt(args, Lut_type)) : 3};
+    if (lut_type < 1 || lut_type > 3)
+        return set_error("libplacebo_LUT: lut_type must be between 1 and 3.", params->vf);
+
+    params->lut_type = static_cast<pl_lut_type>(lut_type);
+
+    params->matrix =
+        static_cast<pl_color_system>((avs_defined(avs_array_elt(args, Matrix))) ? avs_as_int(avs_array_elt(args, Matrix)) : 0);
+    params->dst_matrix =
+        static_cast<pl_color_system>((avs_defined(avs_array_elt(args, Dst_matrix))) ? avs_as_int(avs_array_elt(args, Dst_matrix)) : 0);
+    for (const pl_color_system matrix : {params->matrix, params->dst_matrix})
+    {
+        if (matrix < PL_COLOR_SYSTEM_UNKNOWN || matrix > PL_COLOR_SYSTEM_YCGCO || matrix == PL_COLOR_SYSTEM_DOLBYVISION)
+            return set_error("libplacebo_LUT: matrix and dst_matrix must be between 0 and 9 (except 8).", params->vf);
+    }
+
+    if (avs_defined(avs_array_elt(args, Range)))
+    {
+        const int range{avs_as_int(avs_array_elt(args, Range))};
+        if (range < 0 || range > 1)
+            return set_error("libplacebo_LUT: range must be 0 or 1.", params->vf);
+
+        params->range = (range) ? PL_COLOR_LEVELS_LIMITED : PL_COLOR_LEVELS_FULL;
+    }
+    else
+        params->range = PL_COLOR_LEVELS_UNKNOWN;
+
+    params->chromaLocation =
+        static_cast<pl_chroma_location>((avs_defined(avs_array_elt(args, Chroma_loc))) ? avs_as_int(avs_array_elt(args, Chroma_loc)) : 1);
+    params->trc = static_cast<pl_color_transfer>((avs_defined(avs_array_elt(args, Trc))) ? avs_as_int(avs_array_elt(args, Trc)) : 1);
+
+    params->subsampled = !params->rgb && (g_avs_api->avs_get_plane_width_subsampling(&fi->vi, AVS_PLANAR_U) ||
+                                             g_avs_api->avs_get_plane_height_subsampling(&fi->vi, AVS_PLANAR_U));
+
+    params->stats = avs_defined(avs_array_elt(args, Stats)) ? avs_as_bool(avs_array_elt(args, Stats)) : 0;
+    if (params->stats)
+    {
+        // Created by the first job.
+        for (const auto& vf : params->vf)
+            vf->use_timer = 1;
+    }
+
+    if (avs_defined(avs_array_elt(args, Warmup)) && avs_as_bool(avs_array_elt(args, Warmup)))
+    {
+        AVS_VideoFrame* src{g_avs_api->avs_new_video_frame_a(fi->env, &fi->vi, AVS_FRAME_ALIGN)};
+        AVS_VideoFrame* dst{g_avs_api->avs_new_video_frame_a(fi->env, &fi->vi, AVS_FRAME_ALIGN)};
+        const lut_frame f{lut_frame_info(params.get(), fi, src)};
+
+        lut* d{params.get()};
+        params->warmup =
+            gpu_warmup(params->vf, {src, dst}, [=](priv* vf, gpu_job* job) { return !lut_filter(dst, src, d, fi, vf, f, job); });
+    }
+
+    AVS_Value v;
+    g_avs_api->avs_set_to_clip(&v, clip);
+
+    fi->user_data = params.release();
+    fi->get_frame = lut_get_frame;
+    fi->set_cache_hints = lut_set_cache_hints;
+    fi->free_filter = free_lut;
+
+    return v;
+}
@@ -16,12 +16,15 @@ const char* AVSC_CC avisynth_c_plugin_init(AVS_ScriptEnvironment* env)
         "avs_add_function",
         "avs_new_c_filter",
         "avs_new_video_frame_p",
+        "avs_new_video_frame_a",
+        "avs_save_string",
         "avs_set_to_clip",
         "avs_get_frame",
         "avs_get_row_size_p",
         "avs_get_height_p",
         "avs_get_pitch_p",
         "avs_get_video_info",
+        "avs_copy_video_frame",
         "avs_get_read_ptr_p",
         "avs_get_write_ptr_p",
         "avs_num_components",
@@ -66,9 +69,13 @@ const char* AVSC_CC avisynth_c_plugin_init(AVS_ScriptEnvironment* env)
         "[lut_size]i"
         "[temporal]b"
         "[planes]i*"
-        "[device]i"
+        "[device]i*"
         "[list_device]b"
-        "[grain_neutral]f*",
+        "[grain_neutral]f*"
+        "[stats]b"
+        "[tile]i"
+        "[batch]i"
+        "[warmup]b",
         create_deband, 0);
 
     g_avs_api->avs_add_function(env, "libplacebo_Resample",
@@ -91,15 +98,23 @@ const char* AVSC_CC avisynth_c_plugin_init(AVS_ScriptEnvironment* env)
         "[sigmoid_slope]f"
         "[trc]i"
         "[cplace]i"
-        "[device]i"
+        "[device]i*"
         "[list_device]b"
         "[src_width]f"
-        "[src_height]f",
+        "[src_height]f"
+        "[stats]b"
+        "[tile]i"
+        "[batch]i"
+        "[ladder]i*"
+        "[cascade]b"
+        "[intermediate]s"
+        "[autotune]b"
+        "[warmup]b",
         create_resample, 0);
 
     g_avs_api->avs_add_function(env, "libplacebo_Shader",
         "c"
-        "s"
+        "s+"
         "[width]i"
         "[height]i"
         "[chroma_loc]i"
@@ -117,9 +132,11 @@ const char* AVSC_CC avisynth_c_plugin_init(AVS_ScriptEnvironment* env)
         "[linearize]b"
         "[sigmoid_center]f"
         "[sigmoid_slope]f"
-        "[shader_param]s"
-        "[device]i"
-        "[list_device]b",
+        "[shader_param]s*"
+        "[device]i*"
+        "[list_device]b"
+        "[stats]b"
+        "[warmup]b",
         create_shader, 0);
 
     g_avs_api->avs_add_function(env, "libplacebo_Tonemap",
@@ -145,15 +162,39 @@ const char* AVSC_CC avisynth_c_plugin_init(AVS_ScriptEnvironment* env)
         "[visualize_lut]b"
         "[show_clipping]b"
         "[use_dovi]b"
-        "[device]i"
+        "[device]i*"
         "[list_device]b"
         "[cscale]s"
         "[lut]s"
         "[lut_type]i"
         "[dst_prim]i"
         "[dst_trc]i"
-        "[dst_sys]i",
+        "[dst_sys]i"
+        "[stats]b"
+        "[tile]i"
+        "[measure]s"
+        "[playback]s"
+        "[bake]b"
+        "[export_lut]s"
+        "[bake_size]i"
+        "[warmup]b"
+        "[ordered_peak]b",
         create_tonemap, 0);
 
+    g_avs_api->avs_add_function(env, "libplacebo_LUT",
+        "c"
+        "s"
+        "[lut_type]i"
+        "[matrix]i"
+        "[dst_matrix]i"
+        "[range]i"
+        "[chroma_loc]i"
+        "[trc]i"
+        "[device]i*"
+        "[list_device]b"
+        "[stats]b"
+        "[warmup]b",
+        create_lut, 0);
+
     return "avslibplacebo";
 }
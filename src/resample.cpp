@@ -1,11 +1,81 @@
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <fstream>
+#include <future>
+#include <list>
+#include <map>
 #include <mutex>
+#include <sstream>
 
 #include "avs_libplacebo.h"
 
-struct resample
+// Ladder mode: one GPU job produces all rungs (output sizes) of a source frame.
+struct ladder_job
+{
+    int n;
+    // The source frame. The reference keeps its buffer from being reused while the job is cached, so the buffer identifies the frame.
+    AVS_VideoFrame* src;
+    std::vector<AVS_VideoFrame*> rungs;
+    bool ok;
+    std::string err;
+    std::promise<void> done;
+    std::shared_future<void> ready;
+
+    ~ladder_job()
+    {
+        if (src)
+            g_avs_api->avs_release_video_frame(src);
+        for (AVS_VideoFrame* frame : rungs)
+        {
+            if (frame)
+                g_avs_api->avs_release_video_frame(frame);
+        }
+    }
+};
+
+// The last jobs of a ladder, most recent first. Shared by the instances (one per rung) with the same parameters.
+struct ladder_cache
 {
     std::mutex mtx;
-    std::unique_ptr<priv> vf;
+    std::list<std::shared_ptr<ladder_job>> jobs;
+};
+
+static constexpr size_t max_ladder_jobs{8};
+
+// Execution variant of a device. The variants give the same output, except for the precision of `intermediate`.
+struct resample_variant
+{
+    // Format of sample_fbo and sep_fbo, nullptr: the format of the source.
+    pl_fmt intermediate;
+    int no_compute;
+    // Output textures usable by compute shaders.
+    int storable;
+    // Autotune ran or its result was loaded from the cache.
+    int tuned;
+};
+
+// The intermediate textures are sampled with linear filtering and rendered to.
+static constexpr pl_fmt_caps intermediate_caps{PL_FMT_CAP_SAMPLEABLE | PL_FMT_CAP_LINEAR | PL_FMT_CAP_RENDERABLE};
+// Timed runs of every autotune variant, after one untimed run (shader compilation, LUT generation).
+static constexpr int tune_runs{3};
+
+static std::mutex ladders_mtx;
+static std::map<std::string, std::weak_ptr<ladder_cache>> ladders;
+
+struct ladder_rung
+{
+    int width;
+    int height;
+    // Chroma shift relative to the input of the rung (the source, or the previous rung when cascading).
+    float shift_w;
+    float shift_h;
+};
+
+struct resample
+{
+    std::vector<std::unique_ptr<priv>> vf;
     float src_x;
     float src_y;
     std::unique_ptr<pl_sample_filter_params> sample_params;
@@ -20,37 +90,62 @@ struct resample
     int cplace;
     float src_width;
     float src_height;
-
-    int (*resample_process)(AVS_VideoFrame* dst, AVS_VideoFrame* src, resample* d, const AVS_FilterInfo* fi) noexcept;
+    int stats;
+    // Tile size in output pixels (0: only when the plane is larger than the texture limit).
+    int tile;
+    // Filter radius in source pixels (before downscaling widens it).
+    float filter_radius;
+    // Frames per GPU job (1: no batching).
+    int batch;
+    batch_cache batches;
+    // Ladder mode (empty: off): all rungs, this instance returns `rung`. With `cascade` every rung is scaled from the previous one.
+    std::vector<ladder_rung> ladder;
+    int rung;
+    int cascade;
+    std::shared_ptr<ladder_cache> ladder_jobs;
+    // Per device (priv::index).
+    std::vector<resample_variant> variant;
+    int autotune;
+    // Autotune also picks the intermediate format (intermediate=auto).
+    int tune_intermediate;
+    // Cached autotune results per device (empty: no cache directory).
+    std::vector<std::filesystem::path> tune_file;
+    // warmup=true.
+    std::thread warmup;
+
+    int (*resample_process)(
+        AVS_VideoFrame* dst, AVS_VideoFrame* src, resample* d, const AVS_FilterInfo* fi, priv* vf, gpu_job* job) noexcept;
+    int (*resample_batch_process)(const std::vector<AVS_VideoFrame*>& dst, const std::vector<AVS_VideoFrame*>& src, resample* d,
+        const AVS_FilterInfo* fi, priv* vf, gpu_job* job) noexcept;
+    int (*resample_ladder_process)(const std::vector<AVS_VideoFrame*>& dst, AVS_VideoFrame* src, resample* d, const AVS_FilterInfo* fi,
+        priv* vf, gpu_job* job) noexcept;
 };
 
-static int resample_do_plane(
-    const resample* d, const int w, const int h, const float sx, const float sy, const int planeIdx) noexcept
+// Source rows needed around a frame: the filter support and the part of the source area outside of the frame.
+static int resample_halo(const resample* d, const float sy, const float src_h, const int height, const float scale) noexcept
 {
-    pl_shader sh{pl_dispatch_begin(d->vf->dp)};
-
-    pl_sample_filter_params* sample_params{d->sample_params.get()};
-    sample_params->lut = &d->vf->lut;
+    return static_cast<int>(std::ceil(d->filter_radius * scale)) + 1 + std::max(static_cast<int>(std::ceil(-sy)), 0) +
+        std::max(static_cast<int>(std::ceil(sy + src_h - height)), 0);
+}
 
+// linearization and sigmoidization of `tex` to sample_fbo
+static int resample_linearize(const resample* d, priv* vf, const pl_tex tex) noexcept
+{
     pl_color_space cs{};
     cs.transfer = d->trc;
 
     pl_sample_src src{};
-    src.tex = d->vf->tex_in[0];
+    src.tex = tex;
 
-    //
-    // linearization and sigmoidization
-    //
-
-    pl_shader ish{pl_dispatch_begin(d->vf->dp)};
+    pl_shader ish{pl_dispatch_begin(vf->dp)};
     pl_tex_params tp{};
     tp.w = src.tex->params.w;
     tp.h = src.tex->params.h;
     tp.renderable = true;
     tp.sampleable = true;
-    tp.format = src.tex->params.format;
+    tp.format = (d->variant[vf->index].intermediate) ? d->variant[vf->index].intermediate : src.tex->params.format;
 
-    if (!pl_tex_recreate(d->vf->gpu, &d->vf->sample_fbo, &tp))
+    if (!pl_tex_recreate(vf->gpu, &vf->sample_fbo, &tp))
         return -1;
 
     pl_shader_sample_direct(ish, &src);
@@ -62,45 +157,73 @@ static int resample_do_plane(
         pl_shader_sigmoidize(ish, d->sigmoid_params.get());
 
     pl_dispatch_params dp{};
-    dp.target = d->vf->sample_fbo;
+    dp.target = vf->sample_fbo;
     dp.shader = &ish;
+    dp.timer = vf->timer;
 
-    if (!pl_dispatch_finish(d->vf->dp, &dp))
+    if (!pl_dispatch_finish(vf->dp, &dp))
         return -1;
 
-    //
-    // sampling
-    //
+    return 0;
+}
 
-    const float src_w{[&]() {
-        if (d->src_width > -1.0f)
-            return (planeIdx == AVS_PLANAR_U || planeIdx == AVS_PLANAR_V) ? (d->src_width / d->subw) : d->src_width;
-        else
-            return static_cast<float>(d->vf->tex_in[0]->params.w);
-    }()};
+// Filter LUT of slot `lut` and direction `dir` (0: vertical or polar, 1: horizontal). Slots are plane classes (0: luma/RGB,
+// 1: chroma), ladder mode has two per rung. Every object keeps the LUT of one scale ratio, so planes and passes with different ratios
+// don't regenerate each other's LUT.
+static pl_shader_obj* resample_lut(priv* vf, const int lut, const int dir, const float scale) noexcept
+{
+    const size_t idx{static_cast<size_t>(lut) * 2 + dir};
+    if (vf->lut.size() <= idx)
+    {
+        vf->lut.resize(idx + 1, nullptr);
+        vf->lut_scale.resize(idx + 1, 0.0f);
+    }
 
-    const float src_h{[&]() {
-        if (d->src_height > -1.0f)
-            return (planeIdx == AVS_PLANAR_U || planeIdx == AVS_PLANAR_V) ? (d->src_height / d->subh) : d->src_height;
-        else
-            return static_cast<float>(d->vf->tex_in[0]->params.h);
-    }()};
-
-    pl_rect2df rect{
-        sx,
-        sy,
-        src_w + sx,
-        src_h + sy,
-    };
+    // Tiles of the same plane differ only by rounding.
+    if (std::abs(vf->lut_scale[idx] - scale) > scale * 1e-4f)
+    {
+        vf->lut_scale[idx] = scale;
+        ++vf->lut_updates;
+    }
+
+    return &vf->lut[idx];
+}
+
+// Samples `rect` of sample_fbo to `target` of `out` ({0}: the whole texture). `lut`: slot of the filter LUTs.
+static int resample_sample(const resample* d, priv* vf, const int w, const int h, const pl_rect2df& rect, const pl_rect2d& target,
+    const pl_tex out, const int lut) noexcept
+{
+    pl_shader sh{pl_dispatch_begin(vf->dp)};
 
-    src.tex = d->vf->sample_fbo;
+    // The filter LUTs are per device.
+    pl_sample_filter_params sample_params{*d->sample_params};
+    sample_params.no_compute = d->variant[vf->index].no_compute;
+
+    // Downscaling widens the filter, upscaling uses it as is.
+    const float scale_x{std::max((rect.x1 - rect.x0) / w, 1.0f)};
+    const float scale_y{std::max((rect.y1 - rect.y0) / h, 1.0f)};
+
+    pl_color_space cs{};
+    cs.transfer = d->trc;
+
+    pl_tex_params tp{};
+    tp.renderable = true;
+    tp.sampleable = true;
+    tp.format = vf->sample_fbo->params.format;
+
+    pl_dispatch_params dp{};
+    dp.timer = vf->timer;
+
+    pl_sample_src src{};
+    src.tex = vf->sample_fbo;
     src.rect = rect;
     src.new_h = h;
     src.new_w = w;
 
     if (d->sample_params->filter.polar)
     {
-        if (!pl_shader_sample_polar(sh, &src, sample_params))
+        sample_params.lut = resample_lut(vf, lut, 0, std::max(scale_x, scale_y));
+        if (!pl_shader_sample_polar(sh, &src, &sample_params))
             return -1;
     }
     else
@@ -112,30 +235,32 @@ static int resample_do_plane(
         src1.rect.y0 = 0;
         src1.rect.y1 = src.new_h;
 
-        pl_shader tsh{pl_dispatch_begin(d->vf->dp)};
+        pl_shader tsh{pl_dispatch_begin(vf->dp)};
 
-        if (!pl_shader_sample_ortho2(tsh, &src, sample_params))
+        sample_params.lut = resample_lut(vf, lut, 0, scale_y);
+        if (!pl_shader_sample_ortho2(tsh, &src, &sample_params))
         {
-            pl_dispatch_abort(d->vf->dp, &tsh);
+            pl_dispatch_abort(vf->dp, &tsh);
             return -1;
         }
 
         tp.w = src.new_w;
         tp.h = src.new_h;
 
-        if (!pl_tex_recreate(d->vf->gpu, &d->vf->sep_fbo, &tp))
+        if (!pl_tex_recreate(vf->gpu, &vf->sep_fbo, &tp))
             return -1;
 
-        dp.target = d->vf->sep_fbo;
+        dp.target = vf->sep_fbo;
         dp.shader = &tsh;
 
-        if (!pl_dispatch_finish(d->vf->dp, &dp))
+        if (!pl_dispatch_finish(vf->dp, &dp))
             return -1;
 
-        src1.tex = d->vf->sep_fbo;
+        src1.tex = vf->sep_fbo;
         src1.scale = 1.0f;
 
-        if (!pl_shader_sample_ortho2(sh, &src1, sample_params))
+        sample_params.lut = resample_lut(vf, lut, 1, scale_x);
+        if (!pl_shader_sample_ortho2(sh, &src1, &sample_params))
             return -1;
     }
 
@@ -145,26 +270,174 @@ static int resample_do_plane(
     if (d->linear)
         pl_shader_delinearize(sh, &cs);
 
-    dp.target = d->vf->tex_out[0];
+    dp.target = out;
+    dp.rect = target;
     dp.shader = &sh;
 
-    if (!pl_dispatch_finish(d->vf->dp, &dp))
+    if (!pl_dispatch_finish(vf->dp, &dp))
         return -1;
 
     return 0;
 }
 
+static int resample_do_plane(
+    const resample* d, priv* vf, const int w, const int h, const pl_rect2df& rect, const int tex, const int lut) noexcept
+{
+    if (resample_linearize(d, vf, vf->tex_in[tex]))
+        return -1;
+
+    return resample_sample(d, vf, w, h, rect, pl_rect2d{}, vf->tex_out[tex], lut);
+}
+
+// Times the candidate variants on the first plane of `src` and keeps the fastest one. Runs once per device, on its first frame, and
+// stores the result in tune_file. Without a usable result the default variant stays.
+static void resample_autotune(resample* d, const AVS_FilterInfo* fi, priv* vf, AVS_VideoFrame* src) noexcept
+{
+    resample_variant& current{d->variant[vf->index]};
+    if (!d->autotune || current.tuned)
+        return;
+
+    current.tuned = 1;
+
+    const int bits{g_avs_api->avs_bits_per_component(&fi->vi)};
+    const int bytes{(bits == 8) ? 1 : ((bits == 16) ? 2 : 4)};
+    const int plane{(avs_is_rgb(&fi->vi)) ? AVS_PLANAR_R : AVS_PLANAR_Y};
+    const int width{g_avs_api->avs_get_row_size_p(src, plane) / bytes};
+    const int height{g_avs_api->avs_get_height_p(src, plane)};
+
+    // Tiled frames are tuned on the default variant.
+    if (std::max({width, height, fi->vi.width, fi->vi.height}) > static_cast<int>(vf->gpu->limits.max_tex_2d_dim))
+        return;
+
+    const pl_fmt fmt{pl_find_named_fmt(vf->gpu, (bits == 8) ? "r8" : ((bits == 16) ? "r16" : "r32f"))};
+    if (!fmt)
+        return;
+
+    std::vector<pl_fmt> formats{current.intermediate};
+    if (d->tune_intermediate)
+    {
+        formats.assign(1, nullptr);
+        for (const char* name : {"r16f", "r32f"})
+        {
+            const pl_fmt f{pl_find_named_fmt(vf->gpu, name)};
+            if (f && f != fmt && (f->caps & intermediate_caps) == intermediate_caps)
+                formats.emplace_back(f);
+        }
+    }
+
+    // Only polar sampling has a compute path, it needs storable targets. Fragment shaders run the same with or without storable.
+    std::vector<resample_variant> candidates;
+    for (const pl_fmt f : formats)
+    {
+        candidates.emplace_back(resample_variant{f, 1, 0, 1});
+        if (d->sample_params->filter.polar)
+            candidates.emplace_back(resample_variant{f, 0, 1, 1});
+    }
+
+    // Nothing to compare (ortho filter without intermediate="auto"), no timing and no tune file.
+    if (candidates.size() < 2)
+    {
+        current = candidates[0];
+        return;
+    }
+
+    pl_plane_data pl{};
+    pl.type = (bits == 32) ? PL_FMT_FLOAT : PL_FMT_UNORM;
+    pl.component_size[0] = bits;
+    pl.pixel_stride = bytes;
+    pl.width = width;
+    pl.height = height;
+    pl.row_stride = g_avs_api->avs_get_pitch_p(src, plane);
+    pl.pixels = g_avs_api->avs_get_read_ptr_p(src, plane);
+
+    if (!pl_upload_plane(vf->gpu, nullptr, &vf->tex_in[0], &pl))
+        return;
+
+    const float src_w{(d->src_width > -1.0f) ? d->src_width : static_cast<float>(width)};
+    const float src_h{(d->src_height > -1.0f) ? d->src_height : static_cast<float>(height)};
+    const pl_rect2df rect{d->src_x, d->src_y, d->src_x + src_w, d->src_y + src_h};
+
+    // The tuning runs aren't part of the stats.
+    const pl_timer timer{vf->timer};
+    vf->timer = nullptr;
+
+    const resample_variant fallback{current};
+    resample_variant best{};
+    double best_time{-1.0};
+
+    for (const resample_variant& v : candidates)
+    {
+        current = v;
+
+        pl_tex_params t_r{};
+        t_r.format = fmt;
+        t_r.w = fi->vi.width;
+        t_r.h = fi->vi.height;
+        t_r.renderable = true;
+        t_r.host_readable = true;
+        t_r.storable = v.storable;
+
+        if (!pl_tex_recreate(vf->gpu, &vf->tex_out[0], &t_r))
+            continue;
+
+        double time{-1.0};
+        for (int k{0}; k <= tune_runs; ++k)
+        {
+            pl_gpu_finish(vf->gpu);
+            const auto start{std::chrono::steady_clock::now()};
+
+            if (resample_do_plane(d, vf, t_r.w, t_r.h, rect, 0, 0))
+            {
+                time = -1.0;
+                break;
+            }
+
+            pl_gpu_finish(vf->gpu);
+            const double t{std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count()};
+            if (k > 0)
+                time = (time < 0.0) ? t : std::min(time, t);
+        }
+
+        if (time >= 0.0 && (best_time < 0.0 || time < best_time))
+        {
+            best = v;
+            best_time = time;
+        }
+    }
+
+    vf->timer = timer;
+
+    if (best_time < 0.0)
+    {
+        current = fallback;
+        return;
+    }
+
+    current = best;
+
+    if (!d->tune_file[vf->index].empty())
+    {
+        const std::string text{std::string{(best.intermediate) ? best.intermediate->name : "input"} + " " +
+            std::to_string(best.no_compute) + " " + std::to_string(best.storable) + "\n"};
+        write_file_atomic(d->tune_file[vf->index], text);
+    }
+}
+
 template<typename T>
-static int resample_filter(AVS_VideoFrame* dst, AVS_VideoFrame* src, resample* d, const AVS_FilterInfo* fi) noexcept
+static pl_fmt resample_fmt(const pl_gpu gpu) noexcept
 {
-    const pl_fmt fmt{[&]() {
-        if constexpr (std::is_same_v<T, uint8_t>)
-            return pl_find_named_fmt(d->vf->gpu, "r8");
-        else if constexpr (std::is_same_v<T, uint16_t>)
-            return pl_find_named_fmt(d->vf->gpu, "r16");
-        else
-            return pl_find_named_fmt(d->vf->gpu, "r32f");
-    }()};
+    if constexpr (std::is_same_v<T, uint8_t>)
+        return pl_find_named_fmt(gpu, "r8");
+    else if constexpr (std::is_same_v<T, uint16_t>)
+        return pl_find_named_fmt(gpu, "r16");
+    else
+        return pl_find_named_fmt(gpu, "r32f");
+}
+
+template<typename T>
+static int resample_filter(AVS_VideoFrame* dst, AVS_VideoFrame* src, resample* d, const AVS_FilterInfo* fi, priv* vf, gpu_job* job) noexcept
+{
+    const pl_fmt fmt{resample_fmt<T>(vf->gpu)};
     if (!fmt)
         return -1;
 
@@ -173,13 +446,11 @@ static int resample_filter(AVS_VideoFrame* dst, AVS_VideoFrame* src, resample* d
     const int* planes{(avs_is_rgb(&fi->vi)) ? planes_r : planes_y};
     const int num_planes{g_avs_api->avs_num_components(&fi->vi)};
 
-    std::lock_guard<std::mutex> lck(d->mtx);
-
     for (int i{0}; i < num_planes; ++i)
     {
         const int plane{planes[i]};
 
-        const size_t dst_width{g_avs_api->avs_get_row_size_p(dst, plane) / sizeof(T)};
+        const int dst_width{static_cast<int>(g_avs_api->avs_get_row_size_p(dst, plane) / sizeof(T))};
         const int dst_height{g_avs_api->avs_get_height_p(dst, plane)};
 
         pl_plane_data pl{};
@@ -199,50 +470,443 @@ static int resample_filter(AVS_VideoFrame* dst, AVS_VideoFrame* src, resample* d
             pl.type = PL_FMT_FLOAT;
             pl.component_size[0] = 32;
         }
-        pl.width = g_avs_api->avs_get_row_size_p(src, plane) / sizeof(T);
-        pl.height = g_avs_api->avs_get_height_p(src, plane);
-        pl.row_stride = g_avs_api->avs_get_pitch_p(src, plane);
-        pl.pixels = g_avs_api->avs_get_read_ptr_p(src, plane);
+        const int width{static_cast<int>(g_avs_api->avs_get_row_size_p(src, plane) / sizeof(T))};
+        const int height{g_avs_api->avs_get_height_p(src, plane)};
+        const int src_pitch{g_avs_api->avs_get_pitch_p(src, plane)};
+        const int dst_pitch{g_avs_api->avs_get_pitch_p(dst, plane)};
+        const BYTE* srcp{g_avs_api->avs_get_read_ptr_p(src, plane)};
+        BYTE* dstp{g_avs_api->avs_get_write_ptr_p(dst, plane)};
+
+        const bool chroma{plane == AVS_PLANAR_U || plane == AVS_PLANAR_V};
+        const float sx{(i > 0) ? (d->shift_w + d->src_x / d->subw) : d->src_x};
+        const float sy{(i > 0) ? (d->shift_h + d->src_y / d->subh) : d->src_y};
+        const float src_w{(d->src_width > -1.0f) ? ((chroma) ? (d->src_width / d->subw) : d->src_width) : static_cast<float>(width)};
+        const float src_h{(d->src_height > -1.0f) ? ((chroma) ? (d->src_height / d->subh) : d->src_height) : static_cast<float>(height)};
+
+        // Source pixels per output pixel. Downscaling widens the filter.
+        const float fx{src_w / dst_width};
+        const float fy{src_h / dst_height};
+        const float scale{std::max({fx, fy, 1.0f})};
+        const int halo{static_cast<int>(std::ceil(d->filter_radius * scale)) + 1};
+
+        const int max_tile{std::max(static_cast<int>((static_cast<int>(vf->gpu->limits.max_tex_2d_dim) - 2 * (halo + 1)) / scale), 1)};
+        const std::vector<pl_rect2d> tiles{split_tiles(dst_width, dst_height, (d->tile > 0) ? std::min(d->tile, max_tile) : max_tile)};
+
+        for (size_t t{0}; t < tiles.size(); ++t)
+        {
+            const pl_rect2d& out{tiles[t]};
+            // Alternate the textures, so the upload of the next tile doesn't wait for the previous one.
+            const int tex{static_cast<int>(t % 2)};
+
+            // Source area of the tile and the input region around it.
+            const pl_rect2df area{sx + out.x0 * fx, sy + out.y0 * fy, sx + out.x1 * fx, sy + out.y1 * fy};
+            pl_rect2d in{};
+            in.x0 = std::clamp(static_cast<int>(std::floor(area.x0)) - halo, 0, width - 1);
+            in.y0 = std::clamp(static_cast<int>(std::floor(area.y0)) - halo, 0, height - 1);
+            in.x1 = std::clamp(static_cast<int>(std::ceil(area.x1)) + halo, in.x0 + 1, width);
+            in.y1 = std::clamp(static_cast<int>(std::ceil(area.y1)) + halo, in.y0 + 1, height);
+
+            pl.width = in.x1 - in.x0;
+            pl.height = in.y1 - in.y0;
+            pl.row_stride = src_pitch;
+            pl.pixels = srcp + static_cast<size_t>(in.y0) * src_pitch + in.x0 * sizeof(T);
+
+            // Upload planes
+            if (!pl_upload_plane(vf->gpu, nullptr, &vf->tex_in[tex], &pl))
+                return -1;
+
+            vf->bytes_uploaded += static_cast<uint64_t>(pl.width) * pl.height * sizeof(T);
+
+            pl_tex_params t_r{};
+            t_r.format = fmt;
+            t_r.w = out.x1 - out.x0;
+            t_r.h = out.y1 - out.y0;
+            t_r.sampleable = false;
+            t_r.host_writable = false;
+            t_r.renderable = true;
+            t_r.host_readable = true;
+            t_r.storable = d->variant[vf->index].storable;
+
+            if (!pl_tex_recreate(vf->gpu, &vf->tex_out[tex], &t_r))
+                return -1;
+
+            // Process plane
+            const pl_rect2df rect{area.x0 - in.x0, area.y0 - in.y0, area.x1 - in.x0, area.y1 - in.y0};
+            if (resample_do_plane(d, vf, t_r.w, t_r.h, rect, tex, chroma))
+                return -1;
+
+            pl_tex_transfer_params ttr{};
+            ttr.tex = vf->tex_out[tex];
+            ttr.row_pitch = dst_pitch;
+            ttr.ptr = dstp + static_cast<size_t>(out.y0) * dst_pitch + out.x0 * sizeof(T);
+            ttr.timer = vf->timer;
+
+            // Download planes
+            if (!gpu_download(job, vf->gpu, ttr))
+                return -1;
+
+            vf->bytes_downloaded += static_cast<uint64_t>(t_r.w) * t_r.h * sizeof(T);
+        }
+    }
+
+    return 0;
+}
+
+// The frames of the batch share the upload, the linearization pass and the output texture of every plane.
+template<typename T>
+static int resample_filter_batch(const std::vector<AVS_VideoFrame*>& dst, const std::vector<AVS_VideoFrame*>& src, resample* d,
+    const AVS_FilterInfo* fi, priv* vf, gpu_job* job) noexcept
+{
+    const pl_fmt fmt{resample_fmt<T>(vf->gpu)};
+    if (!fmt)
+        return -1;
+
+    constexpr int planes_y[4]{AVS_PLANAR_Y, AVS_PLANAR_U, AVS_PLANAR_V, AVS_PLANAR_A};
+    constexpr int planes_r[4]{AVS_PLANAR_R, AVS_PLANAR_G, AVS_PLANAR_B, AVS_PLANAR_A};
+    const int* planes{(avs_is_rgb(&fi->vi)) ? planes_r : planes_y};
+    const int num_planes{g_avs_api->avs_num_components(&fi->vi)};
+
+    for (int i{0}; i < num_planes; ++i)
+    {
+        const int plane{planes[i]};
+        // Alpha shares the textures of the first plane, its upload waits for the luma downloads.
+        const int tex{i % 3};
+
+        const int dst_width{static_cast<int>(g_avs_api->avs_get_row_size_p(dst[0], plane) / sizeof(T))};
+        const int dst_height{g_avs_api->avs_get_height_p(dst[0], plane)};
+        const int width{static_cast<int>(g_avs_api->avs_get_row_size_p(src[0], plane) / sizeof(T))};
+        const int height{g_avs_api->avs_get_height_p(src[0], plane)};
+
+        const bool chroma{plane == AVS_PLANAR_U || plane == AVS_PLANAR_V};
+        const float sx{(i > 0) ? (d->shift_w + d->src_x / d->subw) : d->src_x};
+        const float sy{(i > 0) ? (d->shift_h + d->src_y / d->subh) : d->src_y};
+        const float src_w{(d->src_width > -1.0f) ? ((chroma) ? (d->src_width / d->subw) : d->src_width) : static_cast<float>(width)};
+        const float src_h{(d->src_height > -1.0f) ? ((chroma) ? (d->src_height / d->subh) : d->src_height) : static_cast<float>(height)};
+        const int halo{resample_halo(d, sy, src_h, height, std::max({src_w / dst_width, src_h / dst_height, 1.0f}))};
+        const int slot{height + 2 * halo};
 
         // Upload planes
-        if (!pl_upload_plane(d->vf->gpu, nullptr, &d->vf->tex_in[0], &pl))
+        if (!upload_atlas(vf, &vf->tex_in[tex], &vf->atlas[tex], fmt, src, plane, halo))
             return -1;
 
         pl_tex_params t_r{};
         t_r.format = fmt;
         t_r.w = dst_width;
-        t_r.h = dst_height;
+        t_r.h = dst_height * static_cast<int>(dst.size());
         t_r.sampleable = false;
         t_r.host_writable = false;
         t_r.renderable = true;
         t_r.host_readable = true;
-        t_r.storable = true;
+        t_r.storable = d->variant[vf->index].storable;
 
-        if (!pl_tex_recreate(d->vf->gpu, &d->vf->tex_out[0], &t_r))
+        if (!pl_tex_recreate(vf->gpu, &vf->tex_out[tex], &t_r))
             return -1;
 
         // Process plane
-        if (resample_do_plane(d, dst_width, dst_height, (i > 0) ? (d->shift_w + d->src_x / d->subw) : d->src_x,
-                (i > 0) ? (d->shift_h + d->src_y / d->subh) : d->src_y, plane))
+        if (resample_linearize(d, vf, vf->tex_in[tex]))
             return -1;
 
-        pl_tex_transfer_params ttr{};
-        ttr.tex = d->vf->tex_out[0];
-        ttr.row_pitch = g_avs_api->avs_get_pitch_p(dst, plane);
-        ttr.ptr = g_avs_api->avs_get_write_ptr_p(dst, plane);
+        for (size_t k{0}; k < dst.size(); ++k)
+        {
+            const float y0{static_cast<float>(static_cast<int>(k) * slot + halo)};
+            const pl_rect2df rect{sx, y0 + sy, sx + src_w, y0 + sy + src_h};
+            const pl_rect2d target{0, static_cast<int>(k) * dst_height, dst_width, static_cast<int>(k + 1) * dst_height};
+
+            if (resample_sample(d, vf, dst_width, dst_height, rect, target, vf->tex_out[tex], chroma))
+                return -1;
+        }
 
         // Download planes
-        if (!pl_tex_download(d->vf->gpu, &ttr))
+        for (size_t k{0}; k < dst.size(); ++k)
+        {
+            pl_tex_transfer_params ttr{};
+            ttr.tex = vf->tex_out[tex];
+            ttr.rc.x0 = 0;
+            ttr.rc.y0 = static_cast<int>(k) * dst_height;
+            ttr.rc.z0 = 0;
+            ttr.rc.x1 = dst_width;
+            ttr.rc.y1 = ttr.rc.y0 + dst_height;
+            ttr.rc.z1 = 1;
+            ttr.row_pitch = g_avs_api->avs_get_pitch_p(dst[k], plane);
+            ttr.ptr = g_avs_api->avs_get_write_ptr_p(dst[k], plane);
+            ttr.timer = vf->timer;
+
+            if (!gpu_download(job, vf->gpu, ttr))
+                return -1;
+
+            vf->bytes_downloaded += static_cast<uint64_t>(dst_width) * dst_height * sizeof(T);
+        }
+    }
+
+    return 0;
+}
+
+template<typename T>
+static int resample_filter_ladder(const std::vector<AVS_VideoFrame*>& dst, AVS_VideoFrame* src, resample* d, const AVS_FilterInfo* fi,
+    priv* vf, gpu_job* job) noexcept
+{
+    const pl_fmt fmt{resample_fmt<T>(vf->gpu)};
+    if (!fmt)
+        return -1;
+
+    constexpr int planes_y[4]{AVS_PLANAR_Y, AVS_PLANAR_U, AVS_PLANAR_V, AVS_PLANAR_A};
+    constexpr int planes_r[4]{AVS_PLANAR_R, AVS_PLANAR_G, AVS_PLANAR_B, AVS_PLANAR_A};
+    const int* planes{(avs_is_rgb(&fi->vi)) ? planes_r : planes_y};
+    const int num_planes{g_avs_api->avs_num_components(&fi->vi)};
+
+    if (vf->ladder_tex.size() < d->ladder.size() * 3)
+        vf->ladder_tex.resize(d->ladder.size() * 3, nullptr);
+
+    for (int i{0}; i < num_planes; ++i)
+    {
+        const int plane{planes[i]};
+        // Alpha shares the textures of the first plane, its upload waits for the luma downloads.
+        const int tex{i % 3};
+        const bool chroma{plane == AVS_PLANAR_U || plane == AVS_PLANAR_V};
+
+        const int width{static_cast<int>(g_avs_api->avs_get_row_size_p(src, plane) / sizeof(T))};
+        const int height{g_avs_api->avs_get_height_p(src, plane)};
+
+        pl_plane_data pl{};
+        pl.pixel_stride = sizeof(T);
+        pl.type = (std::is_same_v<T, float>) ? PL_FMT_FLOAT : PL_FMT_UNORM;
+        pl.component_size[0] = sizeof(T) * 8;
+        pl.width = width;
+        pl.height = height;
+        pl.row_stride = g_avs_api->avs_get_pitch_p(src, plane);
+        pl.pixels = g_avs_api->avs_get_read_ptr_p(src, plane);
+
+        // Upload planes, once for all rungs.
+        if (!pl_upload_plane(vf->gpu, nullptr, &vf->tex_in[tex], &pl))
             return -1;
+
+        vf->bytes_uploaded += static_cast<uint64_t>(width) * height * sizeof(T);
+
+        if (resample_linearize(d, vf, vf->tex_in[tex]))
+            return -1;
+
+        for (size_t k{0}; k < d->ladder.size(); ++k)
+        {
+            const ladder_rung& r{d->ladder[k]};
+            const int dst_width{static_cast<int>(g_avs_api->avs_get_row_size_p(dst[k], plane) / sizeof(T))};
+            const int dst_height{g_avs_api->avs_get_height_p(dst[k], plane)};
+            pl_tex& out{vf->ladder_tex[k * 3 + tex]};
+
+            pl_tex_params t_r{};
+            t_r.format = fmt;
+            t_r.w = dst_width;
+            t_r.h = dst_height;
+            t_r.sampleable = d->cascade != 0;
+            t_r.host_writable = false;
+            t_r.renderable = true;
+            t_r.host_readable = true;
+            t_r.storable = d->variant[vf->index].storable;
+
+            if (!pl_tex_recreate(vf->gpu, &out, &t_r))
+                return -1;
+
+            const float sx{(i > 0) ? r.shift_w : 0.0f};
+            const float sy{(i > 0) ? r.shift_h : 0.0f};
+            pl_rect2df rect{};
+
+            if (k == 0 || !d->cascade)
+            {
+                const float src_w{
+                    (d->src_width > -1.0f) ? ((chroma) ? (d->src_width / d->subw) : d->src_width) : static_cast<float>(width)};
+                const float src_h{
+                    (d->src_height > -1.0f) ? ((chroma) ? (d->src_height / d->subh) : d->src_height) : static_cast<float>(height)};
+                const float x0{sx + ((i > 0) ? d->src_x / d->subw : d->src_x)};
+                const float y0{sy + ((i > 0) ? d->src_y / d->subh : d->src_y)};
+                rect = {x0, y0, x0 + src_w, y0 + src_h};
+            }
+            else
+            {
+                // The previous rung is still on the GPU.
+                const pl_tex prev{vf->ladder_tex[(k - 1) * 3 + tex]};
+                if (resample_linearize(d, vf, prev))
+                    return -1;
+
+                rect = {sx, sy, sx + prev->params.w, sy + prev->params.h};
+            }
+
+            // Process plane
+            if (resample_sample(d, vf, dst_width, dst_height, rect, pl_rect2d{}, out, static_cast<int>(k) * 2 + chroma))
+                return -1;
+
+            // Download planes
+            pl_tex_transfer_params ttr{};
+            ttr.tex = out;
+            ttr.row_pitch = g_avs_api->avs_get_pitch_p(dst[k], plane);
+            ttr.ptr = g_avs_api->avs_get_write_ptr_p(dst[k], plane);
+            ttr.timer = vf->timer;
+
+            if (!gpu_download(job, vf->gpu, ttr))
+                return -1;
+
+            vf->bytes_downloaded += static_cast<uint64_t>(dst_width) * dst_height * sizeof(T);
+        }
     }
 
     return 0;
 }
 
+static void resample_stats(const AVS_FilterInfo* fi, AVS_VideoFrame* dst, priv* vf)
+{
+    const gpu_stats stats{take_stats()};
+    set_stats_props(fi->env, dst, vf, stats);
+    AVS_Map* props{g_avs_api->avs_get_frame_props_rw(fi->env, dst)};
+    g_avs_api->avs_prop_set_int(fi->env, props, "PlaceboLutUpdates", static_cast<int64_t>(stats.lut_updates), 0);
+}
+
+static bool resample_batch(AVS_FilterInfo* fi, resample* d, const int first, std::vector<AVS_VideoFrame*>& dst)
+{
+    std::vector<avs_helpers::avs_video_frame_ptr> src_ptr;
+    std::vector<AVS_VideoFrame*> src;
+    uint64_t staging_bytes{0};
+
+    for (size_t k{0}; k < dst.size(); ++k)
+    {
+        src_ptr.emplace_back(g_avs_api->avs_get_frame(fi->child, first + static_cast<int>(k)));
+        src.emplace_back(src_ptr.back().get());
+        if (!src.back())
+            return false;
+
+        dst[k] = g_avs_api->avs_new_video_frame_p(fi->env, &fi->vi, src[k]);
+        staging_bytes += frame_size(src[k], &fi->vi) + frame_size(dst[k], &fi->vi);
+    }
+
+    std::string err;
+    priv* vf{gpu_select(d->vf, first)};
+    if (!gpu_run(
+            vf, first, staging_bytes,
+            [&](gpu_job* job) {
+                resample_autotune(d, fi, vf, src[0]);
+                return !d->resample_batch_process(dst, src, d, fi, vf, job);
+            },
+            err))
+    {
+        frame_error(fi, "libplacebo_Resample: " + err);
+
+        return false;
+    }
+
+    for (AVS_VideoFrame* frame : dst)
+    {
+        g_avs_api->avs_prop_set_int(fi->env, g_avs_api->avs_get_frame_props_rw(fi->env, frame), "_ChromaLocation", d->cplace, 0);
+
+        // The whole batch is accounted to its first frame.
+        if (d->stats)
+            resample_stats(fi, frame, vf);
+    }
+
+    return true;
+}
+
+// The first instance that requests a source frame runs the job of all rungs, the others (other rungs) take their output from it.
+static AVS_VideoFrame* resample_ladder_get_frame(AVS_FilterInfo* fi, resample* d, const int n)
+{
+    avs_helpers::avs_video_frame_ptr src_ptr{g_avs_api->avs_get_frame(fi->child, n)};
+    AVS_VideoFrame* src{src_ptr.get()};
+    if (!src)
+        return nullptr;
+
+    const BYTE* id{g_avs_api->avs_get_read_ptr_p(src, AVS_DEFAULT_PLANE)};
+    std::shared_ptr<ladder_job> job;
+    bool owner{false};
+
+    {
+        std::lock_guard<std::mutex> lck(d->ladder_jobs->mtx);
+
+        std::list<std::shared_ptr<ladder_job>>& jobs{d->ladder_jobs->jobs};
+        const auto itr{std::find_if(jobs.begin(), jobs.end(), [&](const std::shared_ptr<ladder_job>& j) {
+            return j->n == n && g_avs_api->avs_get_read_ptr_p(j->src, AVS_DEFAULT_PLANE) == id;
+        })};
+        if (itr != jobs.end())
+        {
+            job = *itr;
+            jobs.splice(jobs.begin(), jobs, itr);
+        }
+        else
+        {
+            job = std::make_shared<ladder_job>();
+            job->n = n;
+            job->src = g_avs_api->avs_copy_video_frame(src);
+            job->rungs.resize(d->ladder.size());
+            job->ready = job->done.get_future().share();
+
+            // Evicted jobs stay alive until their last user returns.
+            jobs.emplace_front(job);
+            if (jobs.size() > max_ladder_jobs)
+                jobs.pop_back();
+
+            owner = true;
+        }
+    }
+
+    if (owner)
+    {
+        uint64_t staging_bytes{frame_size(src, g_avs_api->avs_get_video_info(fi->child))};
+        for (size_t k{0}; k < d->ladder.size(); ++k)
+        {
+            AVS_VideoInfo vi{fi->vi};
+            vi.width = d->ladder[k].width;
+            vi.height = d->ladder[k].height;
+            job->rungs[k] = g_avs_api->avs_new_video_frame_p(fi->env, &vi, src);
+            staging_bytes += frame_size(job->rungs[k], &vi);
+        }
+
+        priv* vf{gpu_select(d->vf, n)};
+        job->ok = gpu_run(
+            vf, n, staging_bytes,
+            [&](gpu_job* gj) {
+                resample_autotune(d, fi, vf, src);
+                return !d->resample_ladder_process(job->rungs, src, d, fi, vf, gj);
+            },
+            job->err);
+
+        if (job->ok)
+        {
+            for (AVS_VideoFrame* frame : job->rungs)
+            {
+                g_avs_api->avs_prop_set_int(fi->env, g_avs_api->avs_get_frame_props_rw(fi->env, frame), "_ChromaLocation", d->cplace, 0);
+
+                // The job is accounted to the first rung.
+                if (d->stats)
+                    resample_stats(fi, frame, vf);
+            }
+        }
+        else
+        {
+            // Not cached, the next request tries again.
+            std::lock_guard<std::mutex> lck(d->ladder_jobs->mtx);
+            d->ladder_jobs->jobs.remove(job);
+        }
+
+        job->done.set_value();
+    }
+    else
+        job->ready.wait();
+
+    if (!job->ok)
+    {
+        frame_error(fi, "libplacebo_Resample: " + job->err);
+
+        return nullptr;
+    }
+
+    return g_avs_api->avs_copy_video_frame(job->rungs[d->rung]);
+}
+
 static AVS_VideoFrame* AVSC_CC resample_get_frame(AVS_FilterInfo* fi, int n)
 {
     resample* d{reinterpret_cast<resample*>(fi->user_data)};
 
+    if (d->batch > 1)
+        return batch_get_frame(d->batches, n, d->batch, fi->vi.num_frames,
+            [&](const int first, std::vector<AVS_VideoFrame*>& dst) { return resample_batch(fi, d, first, dst); });
+    if (!d->ladder.empty())
+        return resample_ladder_get_frame(fi, d, n);
+
     avs_helpers::avs_video_frame_ptr src_ptr{g_avs_api->avs_get_frame(fi->child, n)};
     AVS_VideoFrame* src{ src_ptr.get() };
     if (!src)
@@ -251,11 +915,18 @@ static AVS_VideoFrame* AVSC_CC resample_get_frame(AVS_FilterInfo* fi, int n)
     avs_helpers::avs_video_frame_ptr dst_ptr{g_avs_api->avs_new_video_frame_p(fi->env, &fi->vi, src)};
     AVS_VideoFrame* dst{dst_ptr.get()};
 
-    if (d->resample_process(dst, src, d, fi))
+    const uint64_t staging_bytes{frame_size(src, &fi->vi) + frame_size(dst, &fi->vi)};
+    std::string err;
+    priv* vf{gpu_select(d->vf, n)};
+    if (!gpu_run(
+            vf, n, staging_bytes,
+            [&](gpu_job* job) {
+                resample_autotune(d, fi, vf, src);
+                return !d->resample_process(dst, src, d, fi, vf, job);
+            },
+            err))
     {
-        d->msg = "libplacebo_Resample: " + d->vf->log_buffer.str();
-
-        fi->error = d->msg.c_str();
+        frame_error(fi, "libplacebo_Resample: " + err);
 
         return nullptr;
     }
@@ -263,6 +934,9 @@ static AVS_VideoFrame* AVSC_CC resample_get_frame(AVS_FilterInfo* fi, int n)
     {
         g_avs_api->avs_prop_set_int(fi->env, g_avs_api->avs_get_frame_props_rw(fi->env, dst), "_ChromaLocation", d->cplace, 0);
 
+        if (d->stats)
+            resample_stats(fi, dst, vf);
+
         return dst_ptr.release();
     }
 }
@@ -271,13 +945,30 @@ static void AVSC_CC free_resample(AVS_FilterInfo* fi)
 {
     resample* d{reinterpret_cast<resample*>(fi->user_data)};
 
+    if (d->warmup.joinable())
+        d->warmup.join();
+
+    // The cached jobs hold frames, they are released with the last rung (before the environment goes away).
+    if (d->ladder_jobs)
+    {
+        std::lock_guard<std::mutex> lck(ladders_mtx);
+        d->ladder_jobs.reset();
+        for (auto itr{ladders.begin()}; itr != ladders.end();)
+        {
+            if (itr->second.expired())
+                itr = ladders.erase(itr);
+            else
+                ++itr;
+        }
+    }
+
     avs_libplacebo_uninit(d->vf);
     delete d;
 }
 
 static int AVSC_CC resample_set_cache_hints(AVS_FilterInfo* fi, int cachehints, int frame_range)
 {
-    return cachehints == AVS_CACHE_GET_MTMODE ? 2 : 0;
+    return cachehints == AVS_CACHE_GET_MTMODE ? AVS_MT_NICE_FILTER : 0;
 }
 
 AVS_Value AVSC_CC create_resample(AVS_ScriptEnvironment* env, AVS_Value args, void* param)
@@ -306,7 +997,15 @@ AVS_Value AVSC_CC create_resample(AVS_ScriptEnvironment* env, AVS_Value args, vo
         Device,
         List_device,
         Src_width,
-        Src_height
+        Src_height,
+        Stats,
+        Tile,
+        Batch,
+        Ladder,
+        Cascade,
+        Intermediate,
+        Autotune,
+        Warmup
     };
 
     AVS_FilterInfo* fi;
@@ -329,39 +1028,16 @@ AVS_Value AVSC_CC create_resample(AVS_ScriptEnvironment* env, AVS_Value args, vo
     const int w{fi->vi.width};
     const int h{fi->vi.height};
 
-    const int device{avs_defined(avs_array_elt(args, Device)) ? avs_as_int(avs_array_elt(args, Device)) : -1};
     const int list_device{avs_defined(avs_array_elt(args, List_device)) ? avs_as_bool(avs_array_elt(args, List_device)) : 0};
 
-    if (list_device || device > -1)
-    {
-        std::vector<VkPhysicalDevice> devices{};
-        VkInstance inst{};
-
-        AVS_Value dev_info{devices_info(clip, fi->env, devices, inst, params->msg, "libplacebo_Resample", device, list_device)};
-        if (avs_is_error(dev_info) || avs_is_clip(dev_info))
-        {
-            fi->user_data = params.release();
-            fi->free_filter = free_resample;
-
-            return dev_info;
-        }
-
-        params->vf = avs_libplacebo_init(devices[device], params->msg);
-
-        vkDestroyInstance(inst, nullptr);
-    }
-    else
+    AVS_Value dev_init{
+        avs_libplacebo_init(clip, fi->env, avs_array_elt(args, Device), list_device, params->vf, params->msg, "libplacebo_Resample", 0)};
+    if (avs_is_error(dev_init) || avs_is_clip(dev_init))
     {
-        if (device < -1)
-            return set_error("libplacebo_Resample: device must be greater than or equal to -1.", nullptr);
+        fi->user_data = params.release();
+        fi->free_filter = free_resample;
 
-        params->vf = avs_libplacebo_init(nullptr, params->msg);
-    }
-
-    if (params->msg.size())
-    {
-        params->msg = "libplacebo_Resample: " + params->msg;
-        return set_error(params->msg.c_str(), nullptr);
+        return dev_init;
     }
 
     fi->vi.width = avs_as_int(avs_array_elt(args, Width));
@@ -475,19 +1151,266 @@ AVS_Value AVSC_CC create_resample(AVS_ScriptEnvironment* env, AVS_Value args, vo
     else
         params->src_height = -1.0f;
 
+    params->tile = avs_defined(avs_array_elt(args, Tile)) ? avs_as_int(avs_array_elt(args, Tile)) : 0;
+    if (params->tile < 0)
+        return set_error("libplacebo_Resample: tile must be greater than or equal to 0.", params->vf);
+
+    params->filter_radius = ((params->sample_params->filter.radius > 0.0f) ? params->sample_params->filter.radius
+                                                                            : params->sample_params->filter.kernel->radius) *
+        ((params->sample_params->filter.blur > 0.0f) ? params->sample_params->filter.blur : 1.0f);
+
+    params->batch = avs_defined(avs_array_elt(args, Batch)) ? avs_as_int(avs_array_elt(args, Batch)) : 1;
+    if (params->batch < 1)
+        return set_error("libplacebo_Resample: batch must be greater than or equal to 1.", params->vf);
+    if (params->batch > 1)
+    {
+        if (params->tile > 0)
+            return set_error("libplacebo_Resample: batch and tile can't be used together.", params->vf);
+
+        // The atlases of the luma plane are the largest.
+        const float src_w{(params->src_width > -1.0f) ? params->src_width : static_cast<float>(w)};
+        const float src_h{(params->src_height > -1.0f) ? params->src_height : static_cast<float>(h)};
+        const int halo{resample_halo(
+            params.get(), params->src_y, src_h, h, std::max({src_w / fi->vi.width, src_h / fi->vi.height, 1.0f}))};
+
+        // The limit needs the device.
+        if (!gpu_context(params->vf, params->msg, "libplacebo_Resample"))
+            return set_error(params->msg.c_str(), params->vf);
+
+        for (const auto& vf : params->vf)
+        {
+            const int max_dim{static_cast<int>(vf->gpu->limits.max_tex_2d_dim)};
+            if (std::max(w, fi->vi.width) > max_dim || static_cast<int64_t>(h + 2 * halo) * params->batch > max_dim ||
+                static_cast<int64_t>(fi->vi.height) * params->batch > max_dim)
+                return set_error("libplacebo_Resample: batch is too large for the frame size.", params->vf);
+        }
+    }
+
+    params->stats = avs_defined(avs_array_elt(args, Stats)) ? avs_as_bool(avs_array_elt(args, Stats)) : 0;
+    if (params->stats)
+    {
+        // Created by the first job.
+        for (const auto& vf : params->vf)
+            vf->use_timer = 1;
+    }
+
+    const std::string intermediate{
+        (avs_defined(avs_array_elt(args, Intermediate))) ? avs_as_string(avs_array_elt(args, Intermediate)) : "input"};
+    if (intermediate != "input" && intermediate != "auto" && intermediate != "r16f" && intermediate != "r16" && intermediate != "r32f")
+        return set_error("libplacebo_Resample: intermediate must be input, auto, r16f, r16 or r32f.", params->vf);
+
+    // The format capabilities need the device.
+    if (intermediate != "input" && !gpu_context(params->vf, params->msg, "libplacebo_Resample"))
+        return set_error(params->msg.c_str(), params->vf);
+
+    for (const auto& vf : params->vf)
+    {
+        pl_fmt fmt{nullptr};
+
+        if (intermediate == "auto")
+        {
+            // Half float: more precision than 8-bit, half the bandwidth of 32-bit. 16-bit stays as is.
+            if (bits != 16)
+            {
+                fmt = pl_find_named_fmt(vf->gpu, "r16f");
+                if (fmt && (fmt->caps & intermediate_caps) != intermediate_caps)
+                    fmt = nullptr;
+            }
+        }
+        else if (intermediate != "input")
+        {
+            fmt = pl_find_named_fmt(vf->gpu, intermediate.c_str());
+            if (!fmt || (fmt->caps & intermediate_caps) != intermediate_caps)
+            {
+                params->msg = "libplacebo_Resample: the device doesn't support intermediate=" + intermediate + ".";
+                return set_error(params->msg.c_str(), params->vf);
+            }
+        }
+
+        params->variant.emplace_back(resample_variant{fmt, 0, 1, 0});
+    }
+
+    // Everything that affects the output of a frame.
+    std::ostringstream config;
+    config << std::hexfloat << fi->vi.pixel_type << ' ' << w << 'x' << h << ' '
+           << ((avs_defined(avs_array_elt(args, Filter))) ? avs_as_string(avs_array_elt(args, Filter)) : "ewa_lanczos") << ' '
+           << params->sample_params->filter.radius << ' ' << params->sample_params->filter.clamp << ' '
+           << params->sample_params->filter.taper << ' ' << params->sample_params->filter.blur << ' '
+           << params->sample_params->filter.params[0] << ' ' << params->sample_params->filter.params[1] << ' '
+           << params->sample_params->antiring << ' ' << params->src_x << ' ' << params->src_y << ' ' << params->src_width << ' '
+           << params->src_height << ' ' << params->trc << ' ' << params->linear << ' ' << params->cplace;
+    if (params->sigmoid_params)
+        config << ' ' << params->sigmoid_params->center << ' ' << params->sigmoid_params->slope;
+    config << ' ' << intermediate;
+
+    if (avs_defined(avs_array_elt(args, Ladder)))
+    {
+        const AVS_Value ladder{avs_array_elt(args, Ladder)};
+        const int ladder_size{avs_array_size(ladder)};
+        if (ladder_size < 2 || ladder_size % 2)
+            return set_error("libplacebo_Resample: ladder must be pairs of width and height.", params->vf);
+        if (params->tile > 0 || params->batch > 1)
+            return set_error("libplacebo_Resample: ladder can't be used with tile or batch.", params->vf);
+
+        params->cascade = avs_defined(avs_array_elt(args, Cascade)) ? avs_as_bool(avs_array_elt(args, Cascade)) : 0;
+        const bool subsampled{g_avs_api->avs_is_420(&fi->vi) || g_avs_api->avs_is_422(&fi->vi)};
+        params->rung = -1;
+
+        for (int k{0}; k < ladder_size / 2; ++k)
+        {
+            ladder_rung r{};
+            r.width = avs_as_int(avs_array_elt(ladder, k * 2));
+            r.height = avs_as_int(avs_array_elt(ladder, k * 2 + 1));
+            if (r.width <= 0 || r.height <= 0 || r.width % params->subw || r.height % params->subh)
+                return set_error("libplacebo_Resample: ladder sizes must be positive and multiples of the chroma subsampling.", params->vf);
+
+            // Input of the rung (luma).
+            const int in_w{(params->cascade && k) ? params->ladder.back().width : w};
+            const int in_h{(params->cascade && k) ? params->ladder.back().height : h};
+            if (subsampled)
+            {
+                r.shift_w = (params->cplace == 0 || params->cplace == 2)
+                    ? (0.5f * (1.0f - static_cast<float>(in_w) / r.width)) / params->subw
+                    : 0.0f;
+                r.shift_h = (params->cplace == 2) ? (0.5f * (1.0f - static_cast<float>(in_h) / r.height)) / params->subh : 0.0f;
+            }
+
+            if (params->rung < 0 && r.width == fi->vi.width && r.height == fi->vi.height)
+                params->rung = k;
+
+            params->ladder.emplace_back(r);
+        }
+
+        if (params->rung < 0)
+            return set_error("libplacebo_Resample: width and height must be one of the ladder sizes.", params->vf);
+
+        // The instances of the same ladder share their jobs.
+        std::ostringstream key;
+        key << config.str() << ' ' << params->cascade << ' ' << params->stats;
+        for (const ladder_rung& r : params->ladder)
+            key << ' ' << r.width << 'x' << r.height;
+
+        std::lock_guard<std::mutex> lck(ladders_mtx);
+        params->ladder_jobs = ladders[key.str()].lock();
+        if (!params->ladder_jobs)
+        {
+            params->ladder_jobs = std::make_shared<ladder_cache>();
+            ladders[key.str()] = params->ladder_jobs;
+        }
+    }
+
+    params->autotune = avs_defined(avs_array_elt(args, Autotune)) ? avs_as_bool(avs_array_elt(args, Autotune)) : 0;
+    if (params->autotune)
+    {
+        // The rungs of a ladder share their jobs, their output must not depend on the instance that ran the job.
+        params->tune_intermediate = intermediate == "auto" && params->ladder.empty();
+
+        // The cached results are per device.
+        if (!gpu_context(params->vf, params->msg, "libplacebo_Resample"))
+            return set_error(params->msg.c_str(), params->vf);
+
+        const std::filesystem::path dir{cache_dir()};
+        for (const auto& vf : params->vf)
+        {
+            if (dir.empty())
+            {
+                params->tune_file.emplace_back();
+                continue;
+            }
+
+            const std::string key{device_id(vf.get()) + " " + config.str() + " " + std::to_string(fi->vi.width) + "x" +
+                std::to_string(fi->vi.height) + " " + std::to_string(params->tune_intermediate)};
+            char name[64];
+            snprintf(name, sizeof(name), "resample_%016llx.tune",
+                static_cast<unsigned long long>(fnv1a(reinterpret_cast<const uint8_t*>(key.data()), key.size())));
+            params->tune_file.emplace_back(dir / name);
+
+            // Format, no_compute, storable. Results that don't fit the device any more are tuned again.
+            std::ifstream file(params->tune_file.back());
+            std::string format;
+            int no_compute;
+            int storable;
+            if (!(file >> format >> no_compute >> storable))
+                continue;
+
+            resample_variant& v{params->variant[vf->index]};
+            if (format != "input")
+            {
+                const pl_fmt f{pl_find_named_fmt(vf->gpu, format.c_str())};
+                if (!f || (f->caps & intermediate_caps) != intermediate_caps || (!params->tune_intermediate && f != v.intermediate))
+                    continue;
+
+                v.intermediate = f;
+            }
+            else if (params->tune_intermediate)
+                v.intermediate = nullptr;
+
+            v.no_compute = no_compute != 0;
+            v.storable = storable != 0 || !no_compute;
+            v.tuned = 1;
+        }
+    }
+
     switch (bits)
     {
     case 8:
         params->resample_process = resample_filter<uint8_t>;
+        params->resample_batch_process = resample_filter_batch<uint8_t>;
+        params->resample_ladder_process = resample_filter_ladder<uint8_t>;
         break;
     case 16:
         params->resample_process = resample_filter<uint16_t>;
+        params->resample_batch_process = resample_filter_batch<uint16_t>;
+        params->resample_ladder_process = resample_filter_ladder<uint16_t>;
         break;
     default:
         params->resample_process = resample_filter<float>;
+        params->resample_batch_process = resample_filter_batch<float>;
+        params->resample_ladder_process = resample_filter_ladder<float>;
         break;
     }
 
+    if (avs_defined(avs_array_elt(args, Warmup)) && avs_as_bool(avs_array_elt(args, Warmup)))
+    {
+        // The frames of the mode: all rungs of a ladder, one frame per frame of a batch. Autotune runs first, as on the first frame.
+        const AVS_VideoInfo* src_vi{g_avs_api->avs_get_video_info(fi->child)};
+        std::vector<AVS_VideoFrame*> src;
+        std::vector<AVS_VideoFrame*> dst;
+        for (int k{0}; k < params->batch; ++k)
+            src.emplace_back(g_avs_api->avs_new_video_frame_a(fi->env, src_vi, AVS_FRAME_ALIGN));
+
+        if (params->ladder.empty())
+        {
+            for (int k{0}; k < params->batch; ++k)
+                dst.emplace_back(g_avs_api->avs_new_video_frame_a(fi->env, &fi->vi, AVS_FRAME_ALIGN));
+        }
+        else
+        {
+            for (const ladder_rung& r : params->ladder)
+            {
+                AVS_VideoInfo vi{fi->vi};
+                vi.width = r.width;
+                vi.height = r.height;
+                dst.emplace_back(g_avs_api->avs_new_video_frame_a(fi->env, &vi, AVS_FRAME_ALIGN));
+            }
+        }
+
+        std::vector<AVS_VideoFrame*> frames{src};
+        frames.insert(frames.end(), dst.begin(), dst.end());
+
+        resample* d{params.get()};
+        params->warmup = gpu_warmup(params->vf, frames, [=](priv* vf, gpu_job* job) {
+            resample_autotune(d, fi, vf, src[0]);
+
+            if (!d->ladder.empty())
+                return !d->resample_ladder_process(dst, src[0], d, fi, vf, job);
+            if (d->batch > 1)
+                return !d->resample_batch_process(dst, src, d, fi, vf, job);
+
+            return !d->resample_process(dst[0], src[0], d, fi, vf, job);
+        });
+    }
+
     AVS_Value v;
     g_avs_api->avs_set_to_clip(&v, clip);
 
@@ -10,9 +10,9 @@
 
 struct shader
 {
-    std::mutex mtx;
-    std::unique_ptr<priv> vf;
-    const pl_hook* shader;
+    std::vector<std::unique_ptr<priv>> vf;
+    // Per device (priv::index), the shaders in the order they are applied.
+    std::vector<std::vector<const pl_hook*>> shader;
     enum pl_color_system matrix;
     enum pl_color_levels range;
     enum pl_chroma_location chromaLocation;
@@ -22,17 +22,20 @@ struct shader
     int linear;
     int subw;
     int subh;
+    int stats;
     std::string msg;
+    // warmup=true.
+    std::thread warmup;
 };
 
-static bool shader_do_plane(const shader* d, const pl_plane* planes) noexcept
+static bool shader_do_plane(const shader* d, priv* vf, const pl_plane* planes, const pl_color_levels range) noexcept
 {
     pl_color_repr crpr{};
     crpr.bits.bit_shift = 0;
     crpr.bits.color_depth = 16;
     crpr.bits.sample_depth = 16;
     crpr.sys = d->matrix;
-    crpr.levels = d->range;
+    crpr.levels = range;
 
     pl_color_space csp{};
     csp.transfer = d->trc;
@@ -55,26 +58,34 @@ static bool shader_do_plane(const shader* d, const pl_plane* planes) noexcept
 
     for (int i{0}; i < 3; ++i)
     {
-        out.planes[i].texture = d->vf->tex_out[i];
+        out.planes[i].texture = vf->tex_out[i];
         out.planes[i].components = 1;
         out.planes[i].component_mapping[0] = i;
     }
 
     pl_render_params renderParams{};
-    renderParams.hooks = &d->shader;
-    renderParams.num_hooks = 1;
+    // All shaders run in one render, their intermediate textures stay on the GPU.
+    renderParams.hooks = d->shader[vf->index].data();
+    renderParams.num_hooks = static_cast<int>(d->shader[vf->index].size());
     renderParams.sigmoid_params = d->sigmoid_params.get();
     renderParams.disable_linear_scaling = !d->linear;
     renderParams.upscaler = &d->sample_params->filter;
     renderParams.downscaler = &d->sample_params->filter;
     renderParams.antiringing_strength = d->sample_params->antiring;
 
-    return pl_render_image(d->vf->rr, &img, &out, &renderParams);
+    if (d->stats)
+    {
+        renderParams.info_callback = stats_render_info;
+        renderParams.info_priv = vf;
+    }
+
+    return pl_render_image(vf->rr, &img, &out, &renderParams);
 }
 
-static int shader_filter(AVS_VideoFrame* dst, AVS_VideoFrame* src, shader* d, const AVS_FilterInfo* fi) noexcept
+static int shader_filter(AVS_VideoFrame* dst, AVS_VideoFrame* src, shader* d, const AVS_FilterInfo* fi, priv* vf, const pl_color_levels range,
+    gpu_job* job) noexcept
 {
-    const pl_fmt fmt{pl_find_named_fmt(d->vf->gpu, "r16")};
+    const pl_fmt fmt{pl_find_named_fmt(vf->gpu, "r16")};
     if (!fmt)
         return -1;
 
@@ -88,8 +99,6 @@ static int shader_filter(AVS_VideoFrame* dst, AVS_VideoFrame* src, shader* d, co
     pl_plane pl_planes[3]{};
     constexpr int planes[3]{AVS_PLANAR_Y, AVS_PLANAR_U, AVS_PLANAR_V};
 
-    std::lock_guard<std::mutex> lck(d->mtx);
-
     for (int i{0}; i < 3; ++i)
     {
         const int plane{planes[i]};
@@ -105,27 +114,32 @@ static int shader_filter(AVS_VideoFrame* dst, AVS_VideoFrame* src, shader* d, co
         pl.component_map[0] = i;
 
         // Upload planes
-        if (!pl_upload_plane(d->vf->gpu, &pl_planes[i], &d->vf->tex_in[i], &pl))
+        if (!pl_upload_plane(vf->gpu, &pl_planes[i], &vf->tex_in[i], &pl))
             return -1;
 
-        if (!pl_tex_recreate(d->vf->gpu, &d->vf->tex_out[i], &t_r))
+        vf->bytes_uploaded += static_cast<uint64_t>(pl.width) * pl.height * 2;
+
+        if (!pl_tex_recreate(vf->gpu, &vf->tex_out[i], &t_r))
             return -1;
     }
 
     // Process plane
-    if (!shader_do_plane(d, pl_planes))
+    if (!shader_do_plane(d, vf, pl_planes, range))
         return -1;
 
     // Download planes
     for (int i{0}; i < 3; ++i)
     {
         pl_tex_transfer_params ttr1{};
-        ttr1.tex = d->vf->tex_out[i];
+        ttr1.tex = vf->tex_out[i];
         ttr1.row_pitch = g_avs_api->avs_get_pitch_p(dst, planes[i]);
         ttr1.ptr = g_avs_api->avs_get_write_ptr_p(dst, planes[i]);
+        ttr1.timer = vf->timer;
 
-        if (!pl_tex_download(d->vf->gpu, &ttr1))
+        if (!gpu_download(job, vf->gpu, ttr1))
             return -1;
+
+        vf->bytes_downloaded += static_cast<uint64_t>(t_r.w) * t_r.h * 2;
     }
 
     return 0;
@@ -143,42 +157,153 @@ static AVS_VideoFrame* AVSC_CC shader_get_frame(AVS_FilterInfo* fi, int n)
     avs_helpers::avs_video_frame_ptr dst_ptr{g_avs_api->avs_new_video_frame_p(fi->env, &fi->vi, src)};
     AVS_VideoFrame* dst{dst_ptr.get()};
 
-    if (d->range == PL_COLOR_LEVELS_UNKNOWN)
-    {
+    // Per frame, the instance is shared by all threads.
+    const pl_color_levels range{[&]() {
+        if (d->range != PL_COLOR_LEVELS_UNKNOWN)
+            return d->range;
+
         const AVS_Map* props{g_avs_api->avs_get_frame_props_ro(fi->env, src)};
 
         int err{0};
         const int64_t r{g_avs_api->avs_prop_get_int(fi->env, props, "_ColorRange", 0, &err)};
         if (err)
-            d->range = PL_COLOR_LEVELS_LIMITED;
+            return PL_COLOR_LEVELS_LIMITED;
         else
-            d->range = (r) ? PL_COLOR_LEVELS_LIMITED : PL_COLOR_LEVELS_FULL;
-    }
+            return (r) ? PL_COLOR_LEVELS_LIMITED : PL_COLOR_LEVELS_FULL;
+    }()};
 
-    if (shader_filter(dst, src, d, fi))
+    const uint64_t staging_bytes{frame_size(src, &fi->vi) + frame_size(dst, &fi->vi)};
+    std::string err;
+    priv* vf{gpu_select(d->vf, n)};
+    if (!gpu_run(vf, n, staging_bytes, [&](gpu_job* job) { return !shader_filter(dst, src, d, fi, vf, range, job); }, err))
     {
-        d->msg = "libplacebo_Shader: " + d->vf->log_buffer.str();
-
-        fi->error = d->msg.c_str();
+        frame_error(fi, "libplacebo_Shader: " + err);
 
         return nullptr;
     }
     else
+    {
+        if (d->stats)
+            set_stats_props(fi->env, dst, vf, take_stats());
+
         return dst_ptr.release();
+    }
+}
+
+// Reads the file `shader_path` (UTF-8, on Windows also the ANSI code page) into `data`.
+static bool shader_read(const char* shader_path, std::string& data, std::string& err)
+{
+    FILE* shader_file{nullptr};
+
+#ifdef _WIN32
+    const int required_size{MultiByteToWideChar(CP_UTF8, 0, shader_path, -1, nullptr, 0)};
+    std::wstring wbuffer(required_size, 0);
+    MultiByteToWideChar(CP_UTF8, 0, shader_path, -1, wbuffer.data(), required_size);
+    shader_file = _wfopen(wbuffer.c_str(), L"rb");
+    if (!shader_file)
+    {
+        const int req_size{MultiByteToWideChar(CP_ACP, 0, shader_path, -1, nullptr, 0)};
+        wbuffer.resize(req_size);
+        MultiByteToWideChar(CP_ACP, 0, shader_path, -1, wbuffer.data(), req_size);
+        shader_file = _wfopen(wbuffer.c_str(), L"rb");
+    }
+#else
+    shader_file = std::fopen(shader_path, "rb");
+#endif
+    if (!shader_file)
+    {
+        err = "libplacebo_Shader: error opening file " + std::string(shader_path) + " (" + std::strerror(errno) + ")";
+        return false;
+    }
+
+    if (std::fseek(shader_file, 0, SEEK_END))
+    {
+        std::fclose(shader_file);
+        err = "libplacebo_Shader: error seeking to the end of file " + std::string(shader_path) + " (" + std::strerror(errno) + ")";
+        return false;
+    }
+
+    const long shader_size{std::ftell(shader_file)};
+
+    if (shader_size == -1)
+    {
+        std::fclose(shader_file);
+        err = "libplacebo_Shader: error determining the size of file " + std::string(shader_path) + " (" + std::strerror(errno) + ")";
+        return false;
+    }
+
+    std::rewind(shader_file);
+
+    data.assign(shader_size, ' ');
+    std::fread(data.data(), 1, shader_size, shader_file);
+
+    std::fclose(shader_file);
+
+    return true;
+}
+
+// Replaces the values of the #defines named in `shader_p` ("name=value name=value").
+static bool shader_set_params(std::string& data, const std::string& shader_p, std::string& err)
+{
+    int num_spaces{0};
+    int num_equals{-1};
+    for (auto& string : shader_p)
+    {
+        if (string == ' ')
+            ++num_spaces;
+        if (string == '=')
+            ++num_equals;
+    }
+    if (num_spaces != num_equals)
+    {
+        err = "libplacebo_Shader: failed parsing shader_param (wrong format).";
+        return false;
+    }
+
+    std::string reg_parse{"(\\w+)=([^ >]+)"};
+    for (int i{0}; i < num_spaces; ++i)
+        reg_parse += "(?: (\\w+)=([^ >]+))";
+
+    std::regex reg(reg_parse);
+    std::smatch match;
+    if (!std::regex_match(shader_p.cbegin(), shader_p.cend(), match, reg))
+    {
+        err = "libplacebo_Shader: regex failed parsing shader_param.";
+        return false;
+    }
+
+    for (int i = 1; match[i + 1].matched; i += 2)
+        data = std::regex_replace(data, std::regex(std::string("(#define\\s") + match[i].str() + std::string("\\s+)(.+?)(?=\\/\\/|\\s)")),
+            "$01" + match[i + 1].str());
+
+    return true;
+}
+
+static void shader_destroy(shader* d)
+{
+    for (auto& hooks : d->shader)
+    {
+        for (const pl_hook*& hook : hooks)
+            pl_mpv_user_shader_destroy(&hook);
+    }
+    d->shader.clear();
 }
 
 static void AVSC_CC free_shader(AVS_FilterInfo* fi)
 {
     shader* d{reinterpret_cast<shader*>(fi->user_data)};
 
-    pl_mpv_user_shader_destroy(&d->shader);
+    if (d->warmup.joinable())
+        d->warmup.join();
+
+    shader_destroy(d);
     avs_libplacebo_uninit(d->vf);
     delete d;
 }
 
 static int AVSC_CC shader_set_cache_hints(AVS_FilterInfo* fi, int cachehints, int frame_range)
 {
-    return cachehints == AVS_CACHE_GET_MTMODE ? 2 : 0;
+    return cachehints == AVS_CACHE_GET_MTMODE ? AVS_MT_NICE_FILTER : 0;
 }
 
 AVS_Value AVSC_CC create_shader(AVS_ScriptEnvironment* env, AVS_Value args, void* param)
@@ -206,7 +331,9 @@ AVS_Value AVSC_CC create_shader(AVS_ScriptEnvironment* env, AVS_Value args, void
         Sigmoid_slope,
         Shader_param,
         Device,
-        List_device
+        List_device,
+        Stats,
+        Warmup
     };
 
     AVS_FilterInfo* fi;
@@ -226,125 +353,67 @@ AVS_Value AVSC_CC create_shader(AVS_ScriptEnvironment* env, AVS_Value args, void
     if (avs_is_rgb(&fi->vi))
         return set_error("libplacebo_Shader: only YUV formats are supported.", nullptr);
 
-    const int device{avs_defined(avs_array_elt(args, Device)) ? avs_as_int(avs_array_elt(args, Device)) : -1};
     const int list_device{avs_defined(avs_array_elt(args, List_device)) ? avs_as_bool(avs_array_elt(args, List_device)) : 0};
 
-    if (list_device || device > -1)
-    {
-        std::vector<VkPhysicalDevice> devices{};
-        VkInstance inst{};
-
-        AVS_Value dev_info{devices_info(clip, fi->env, devices, inst, params->msg, "libplacebo_Shader", device, list_device)};
-        if (avs_is_error(dev_info) || avs_is_clip(dev_info))
-        {
-            fi->user_data = params.release();
-            fi->free_filter = free_shader;
-
-            return dev_info;
-        }
-
-        params->vf = avs_libplacebo_init(devices[device], params->msg);
-
-        vkDestroyInstance(inst, nullptr);
-    }
-    else
+    AVS_Value dev_init{
+        avs_libplacebo_init(clip, fi->env, avs_array_elt(args, Device), list_device, params->vf, params->msg, "libplacebo_Shader", 1)};
+    if (avs_is_error(dev_init) || avs_is_clip(dev_init))
     {
-        if (device < -1)
-            return set_error("libplacebo_Shader: device must be greater than or equal to -1.", nullptr);
+        fi->user_data = params.release();
+        fi->free_filter = free_shader;
 
-        params->vf = avs_libplacebo_init(nullptr, params->msg);
+        return dev_init;
     }
 
-    if (params->msg.size())
-    {
-        params->msg = "libplacebo_Shader: " + params->msg;
-        return set_error(params->msg.c_str(), nullptr);
-    }
+    // One or more shaders, each with its own (optional) shader_param. They are applied in order in one render.
+    const auto strings{[](const AVS_Value value) {
+        std::vector<std::string> list;
+        if (avs_is_array(value))
+        {
+            for (int i{0}; i < avs_array_size(value); ++i)
+                list.emplace_back(avs_as_string(*(avs_as_array(value) + i)));
+        }
+        else if (avs_defined(value))
+            list.emplace_back(avs_as_string(value));
 
-    const char* shader_path{avs_as_string(avs_array_elt(args, Shader))};
-    FILE* shader_file{nullptr};
+        return list;
+    }};
+    const std::vector<std::string> shader_paths{strings(avs_array_elt(args, Shader))};
+    const std::vector<std::string> shader_ps{strings(avs_array_elt(args, Shader_param))};
 
-#ifdef _WIN32
-    const int required_size{MultiByteToWideChar(CP_UTF8, 0, shader_path, -1, nullptr, 0)};
-    std::wstring wbuffer(required_size, 0);
-    MultiByteToWideChar(CP_UTF8, 0, shader_path, -1, wbuffer.data(), required_size);
-    shader_file = _wfopen(wbuffer.c_str(), L"rb");
-    if (!shader_file)
-    {
-        const int req_size{MultiByteToWideChar(CP_ACP, 0, shader_path, -1, nullptr, 0)};
-        wbuffer.resize(req_size);
-        MultiByteToWideChar(CP_ACP, 0, shader_path, -1, wbuffer.data(), req_size);
-        shader_file = _wfopen(wbuffer.c_str(), L"rb");
-    }
-#else
-    shader_file = std::fopen(shader_path, "rb");
-#endif
-    if (!shader_file)
-    {
-        params->msg = "libplacebo_Shader: error opening file " + std::string(shader_path) + " (" + std::strerror(errno) + ")";
-        return set_error(params->msg.c_str(), params->vf);
-    }
+    if (shader_paths.empty())
+        return set_error("libplacebo_Shader: shader must have at least one path.", params->vf);
+    if (shader_ps.size() > shader_paths.size())
+        return set_error("libplacebo_Shader: shader_param must not have more elements than shader.", params->vf);
 
-    if (std::fseek(shader_file, 0, SEEK_END))
+    std::vector<std::string> bdata(shader_paths.size());
+    for (size_t i{0}; i < shader_paths.size(); ++i)
     {
-        std::fclose(shader_file);
-        params->msg = "libplacebo_Shader: error seeking to the end of file " + std::string(shader_path) + " (" + std::strerror(errno) + ")";
-        return set_error(params->msg.c_str(), params->vf);
+        if (!shader_read(shader_paths[i].c_str(), bdata[i], params->msg))
+            return set_error(params->msg.c_str(), params->vf);
+        if (i < shader_ps.size() && !shader_ps[i].empty() && !shader_set_params(bdata[i], shader_ps[i], params->msg))
+            return set_error(params->msg.c_str(), params->vf);
     }
 
-    const long shader_size{std::ftell(shader_file)};
-
-    if (shader_size == -1)
-    {
-        std::fclose(shader_file);
-        params->msg =
-            "libplacebo_Shader: error determining the size of file " + std::string(shader_path) + " (" + std::strerror(errno) + ")";
+    // Parsing is validation, it needs the device.
+    if (!gpu_context(params->vf, params->msg, "libplacebo_Shader"))
         return set_error(params->msg.c_str(), params->vf);
-    }
-
-    std::rewind(shader_file);
-
-    std::string bdata(shader_size, ' ');
-    std::fread(bdata.data(), 1, shader_size, shader_file);
-    bdata[shader_size] = '\0';
-
-    std::fclose(shader_file);
 
-    if (avs_defined(avs_array_elt(args, Shader_param)))
+    params->shader.resize(params->vf.size());
+    for (const auto& vf : params->vf)
     {
-        std::string shader_p{avs_as_string(avs_array_elt(args, Shader_param))};
-
-        int num_spaces{0};
-        int num_equals{-1};
-        for (auto& string : shader_p)
+        for (size_t i{0}; i < bdata.size(); ++i)
         {
-            if (string == ' ')
-                ++num_spaces;
-            if (string == '=')
-                ++num_equals;
+            params->shader[vf->index].emplace_back(pl_mpv_user_shader_parse(vf->gpu, bdata[i].c_str(), bdata[i].size()));
+            if (!params->shader[vf->index].back())
+            {
+                shader_destroy(params.get());
+                params->msg = "libplacebo_Shader: failed parsing shader " + shader_paths[i] + "!";
+                return set_error(params->msg.c_str(), params->vf);
+            }
         }
-        if (num_spaces != num_equals)
-            return set_error("libplacebo_Shader: failed parsing shader_param (wrong format).", params->vf);
-
-        std::string reg_parse{"(\\w+)=([^ >]+)"};
-        for (int i{0}; i < num_spaces; ++i)
-            reg_parse += "(?: (\\w+)=([^ >]+))";
-
-        std::regex reg(reg_parse);
-        std::smatch match;
-        if (!std::regex_match(shader_p.cbegin(), shader_p.cend(), match, reg))
-            return set_error("libplacebo_Shader: regex failed parsing shader_param.", params->vf);
-
-        for (int i = 1; match[i + 1].matched; i += 2)
-            bdata =
-                std::regex_replace(bdata, std::regex(std::string("(#define\\s") + match[i].str() + std::string("\\s+)(.+?)(?=\\/\\/|\\s)")),
-                    "$01" + match[i + 1].str());
     }
 
-    params->shader = pl_mpv_user_shader_parse(params->vf->gpu, bdata.c_str(), bdata.size());
-    if (!params->shader)
-        return set_error("libplacebo_Shader: failed parsing shader!", params->vf);
-
     params->range = PL_COLOR_LEVELS_UNKNOWN;
     params->matrix = static_cast<pl_color_system>((avs_defined(avs_array_elt(args, Matrix))) ? avs_as_int(avs_array_elt(args, Matrix)) : 2);
 
@@ -367,7 +436,7 @@ AVS_Value AVSC_CC create_shader(AVS_ScriptEnvironment* env, AVS_Value args, void
             (avs_defined(avs_array_elt(args, Sigmoid_center))) ? avs_as_float(avs_array_elt(args, Sigmoid_center)) : 0.75f;
         if (params->sigmoid_params->center < 0.0f || params->sigmoid_params->center > 1.0f)
         {
-            pl_mpv_user_shader_destroy(&params->shader);
+            shader_destroy(params.get());
             return set_error("libplacebo_Shader: sigmoid_center must be between 0.0 and 1.0.", params->vf);
         }
 
@@ -375,7 +444,7 @@ AVS_Value AVSC_CC create_shader(AVS_ScriptEnvironment* env, AVS_Value args, void
             (avs_defined(avs_array_elt(args, Sigmoid_slope))) ? avs_as_float(avs_array_elt(args, Sigmoid_slope)) : 6.5f;
         if (params->sigmoid_params->slope < 1.0f || params->sigmoid_params->slope > 20.0f)
         {
-            pl_mpv_user_shader_destroy(&params->shader);
+            shader_destroy(params.get());
             return set_error("libplacebo_Shader: sigmoid_slope must be between 1.0 and 20.0.", params->vf);
         }
     }
@@ -385,7 +454,7 @@ AVS_Value AVSC_CC create_shader(AVS_ScriptEnvironment* env, AVS_Value args, void
     params->sample_params->antiring = (avs_defined(avs_array_elt(args, Antiring))) ? avs_as_float(avs_array_elt(args, Antiring)) : 0.0f;
     if (params->sample_params->antiring < 0.0f || params->sample_params->antiring > 1.0f)
     {
-        pl_mpv_user_shader_destroy(&params->shader);
+        shader_destroy(params.get());
         return set_error("libplacebo_Shader: antiring must be between 0.0 and 1.0.", params->vf);
     }
 
@@ -393,7 +462,7 @@ AVS_Value AVSC_CC create_shader(AVS_ScriptEnvironment* env, AVS_Value args, void
         (avs_defined(avs_array_elt(args, Filter))) ? avs_as_string(avs_array_elt(args, Filter)) : "ewa_lanczos", PL_FILTER_UPSCALING)};
     if (!filter_config)
     {
-        pl_mpv_user_shader_destroy(&params->shader);
+        shader_destroy(params.get());
         return set_error("libplacebo_Shader: not a valid filter.", params->vf);
     }
 
@@ -401,21 +470,21 @@ AVS_Value AVSC_CC create_shader(AVS_ScriptEnvironment* env, AVS_Value args, void
     params->sample_params->filter.clamp = (avs_defined(avs_array_elt(args, Clamp))) ? avs_as_float(avs_array_elt(args, Clamp)) : 0.0f;
     if (params->sample_params->filter.clamp < 0.0f || params->sample_params->filter.clamp > 1.0f)
     {
-        pl_mpv_user_shader_destroy(&params->shader);
+        shader_destroy(params.get());
         return set_error("libplacebo_Shader: clamp must be between 0.0 and 1.0.", params->vf);
     }
 
     params->sample_params->filter.blur = (avs_defined(avs_array_elt(args, Blur))) ? avs_as_float(avs_array_elt(args, Blur)) : 0.0f;
     if (params->sample_params->filter.blur < 0.0f || params->sample_params->filter.blur > 100.0f)
     {
-        pl_mpv_user_shader_destroy(&params->shader);
+        shader_destroy(params.get());
         return set_error("libplacebo_Shader: blur must be between 0.0 and 100.0.", params->vf);
     }
 
     params->sample_params->filter.taper = (avs_defined(avs_array_elt(args, Taper))) ? avs_as_float(avs_array_elt(args, Taper)) : 0.0f;
     if (params->sample_params->filter.taper < 0.0f || params->sample_params->filter.taper > 1.0f)
     {
-        pl_mpv_user_shader_destroy(&params->shader);
+        shader_destroy(params.get());
         return set_error("libplacebo_Shader: taper must be between 0.0 and 1.0.", params->vf);
     }
 
@@ -424,7 +493,7 @@ AVS_Value AVSC_CC create_shader(AVS_ScriptEnvironment* env, AVS_Value args, void
         params->sample_params->filter.radius = avs_as_float(avs_array_elt(args, Radius));
         if (params->sample_params->filter.radius < 0.0f || params->sample_params->filter.radius > 16.0f)
         {
-            pl_mpv_user_shader_destroy(&params->shader);
+            shader_destroy(params.get());
             return set_error("libplacebo_Shader: radius must be between 0.0 and 16.0.", params->vf);
         }
     }
@@ -439,6 +508,26 @@ AVS_Value AVSC_CC create_shader(AVS_ScriptEnvironment* env, AVS_Value args, void
 
     fi->vi.pixel_type = AVS_CS_YUV444P16;
 
+    params->stats = avs_defined(avs_array_elt(args, Stats)) ? avs_as_bool(avs_array_elt(args, Stats)) : 0;
+    if (params->stats)
+    {
+        // Created by the first job.
+        for (const auto& vf : params->vf)
+            vf->use_timer = 1;
+    }
+
+    if (avs_defined(avs_array_elt(args, Warmup)) && avs_as_bool(avs_array_elt(args, Warmup)))
+    {
+        AVS_VideoFrame* src{g_avs_api->avs_new_video_frame_a(fi->env, g_avs_api->avs_get_video_info(fi->child), AVS_FRAME_ALIGN)};
+        AVS_VideoFrame* dst{g_avs_api->avs_new_video_frame_a(fi->env, &fi->vi, AVS_FRAME_ALIGN)};
+        // The blank frame has no _ColorRange.
+        const pl_color_levels range{(params->range != PL_COLOR_LEVELS_UNKNOWN) ? params->range : PL_COLOR_LEVELS_LIMITED};
+
+        shader* d{params.get()};
+        params->warmup = gpu_warmup(
+            params->vf, {src, dst}, [=](priv* vf, gpu_job* job) { return !shader_filter(dst, src, d, fi, vf, range, job); });
+    }
+
     AVS_Value v;
     g_avs_api->avs_set_to_clip(&v, clip);
 
@@ -1,8 +1,17 @@
 #include <algorithm>
 #include <array>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
 #include <cstring>
+#include <fstream>
+#include <future>
+#include <iostream>
+#include <list>
+#include <map>
 #include <mutex>
 #include <regex>
+#include <sstream>
 #include <utility>
 
 #ifdef _WIN32
@@ -113,6 +122,301 @@ done:
     return dovi_meta;
 }
 
+// Parsed RPU and the values derived from it, shared by all frames with the same RPU.
+struct dovi_rpu_info
+{
+    std::string rpu;
+    uint8_t profile;
+    std::unique_ptr<pl_dovi_metadata> meta;
+    bool has_vdr_dm;
+    uint16_t source_min_pq;
+    uint16_t source_max_pq;
+    bool has_level1;
+    uint16_t avg_pq;
+    uint16_t max_pq;
+    bool has_level6;
+    uint16_t max_cll;
+    uint16_t max_fall;
+};
+
+// Recently used RPUs, most recent first. Frames of a shot usually carry the same RPU, so only scene changes are parsed.
+struct dovi_cache
+{
+    std::mutex mtx;
+    std::list<std::pair<uint64_t, std::shared_ptr<const dovi_rpu_info>>> entries;
+};
+
+static constexpr size_t dovi_cache_size{16};
+
+static std::shared_ptr<const dovi_rpu_info> parse_dovi_rpu(const uint8_t* data, const size_t size, std::string& err)
+{
+    DoviRpuOpaque* rpu{dovi_parse_unspec62_nalu(data, size)};
+    const DoviRpuDataHeader* header{dovi_rpu_get_header(rpu)};
+    if (!header)
+    {
+        err = dovi_rpu_get_error(rpu);
+        dovi_rpu_free(rpu);
+        return nullptr;
+    }
+
+    std::shared_ptr<dovi_rpu_info> info{std::make_shared<dovi_rpu_info>()};
+    info->rpu.assign(reinterpret_cast<const char*>(data), size);
+    info->profile = header->guessed_profile;
+    info->meta = create_dovi_meta(*rpu, *header);
+
+    if (header->vdr_dm_metadata_present_flag)
+    {
+        const DoviVdrDmData* vdr_dm_data{dovi_rpu_get_vdr_dm_data(rpu)};
+        if (vdr_dm_data)
+        {
+            info->has_vdr_dm = true;
+            info->source_min_pq = vdr_dm_data->source_min_pq;
+            info->source_max_pq = vdr_dm_data->source_max_pq;
+
+            if (vdr_dm_data->dm_data.level1)
+            {
+                info->has_level1 = true;
+                info->avg_pq = vdr_dm_data->dm_data.level1->avg_pq;
+                info->max_pq = vdr_dm_data->dm_data.level1->max_pq;
+            }
+
+            if (vdr_dm_data->dm_data.level6)
+            {
+                info->has_level6 = true;
+                info->max_cll = vdr_dm_data->dm_data.level6->max_content_light_level;
+                info->max_fall = vdr_dm_data->dm_data.level6->max_frame_average_light_level;
+            }
+
+            dovi_rpu_free_vdr_dm_data(vdr_dm_data);
+        }
+    }
+
+    dovi_rpu_free_header(header);
+    dovi_rpu_free(rpu);
+
+    return info;
+}
+
+static std::shared_ptr<const dovi_rpu_info> dovi_cache_get(dovi_cache& cache, const uint8_t* data, const size_t size, std::string& err)
+{
+    const uint64_t hash{fnv1a(data, size)};
+
+    {
+        std::lock_guard<std::mutex> lck(cache.mtx);
+
+        const auto itr{std::find_if(cache.entries.begin(), cache.entries.end(), [&](const auto& e) {
+            return e.first == hash && e.second->rpu.size() == size && !memcmp(e.second->rpu.data(), data, size);
+        })};
+        if (itr != cache.entries.end())
+        {
+            cache.entries.splice(cache.entries.begin(), cache.entries, itr);
+            return itr->second;
+        }
+    }
+
+    // Parsed outside of the lock, a concurrent miss of the same RPU only costs a duplicate entry.
+    std::shared_ptr<const dovi_rpu_info> info{parse_dovi_rpu(data, size, err)};
+    if (!info)
+        return nullptr;
+
+    std::lock_guard<std::mutex> lck(cache.mtx);
+    cache.entries.emplace_front(hash, info);
+    if (cache.entries.size() > dovi_cache_size)
+        cache.entries.pop_back();
+
+    return info;
+}
+
+// Brightness of a frame (PQ), measured by the peak detection or read from a measurement/HDR10+ file.
+struct hdr_measurement
+{
+    float max_pq;
+    float avg_pq;
+};
+
+// Unsmoothed measurement of ordered peak detection and when it was last used.
+struct peak_entry
+{
+    std::shared_future<hdr_measurement> result;
+    uint64_t used;
+};
+
+// Scene cut when the average brightness changes by more than this (PQ).
+static constexpr float measure_scene_cut{0.03f};
+
+// Text file, one line per measured frame: frame number, max_pq, avg_pq, scene number.
+static bool write_measurements(const std::filesystem::path& path, const std::map<int, hdr_measurement>& frames)
+{
+    std::ostringstream file;
+    file << "# avs_libplacebo hdr measurement v1\n# frame max_pq avg_pq scene\n";
+
+    int scene{0};
+    int prev_n{-1};
+    float prev_avg{0.0f};
+    for (const auto& [n, m] : frames)
+    {
+        if (prev_n > -1 && (n != prev_n + 1 || std::abs(m.avg_pq - prev_avg) > measure_scene_cut))
+            ++scene;
+
+        file << n << " " << m.max_pq << " " << m.avg_pq << " " << scene << "\n";
+
+        prev_n = n;
+        prev_avg = m.avg_pq;
+    }
+
+    // Atomic: an interrupted write must not leave a truncated file that a later run reads as complete.
+    return write_file_atomic(path, file.str());
+}
+
+// Replaces the values of every frame with the values of its scene: the peak of the scene and the average of its frames.
+static void scene_measurements(std::vector<hdr_measurement>& frames, const std::vector<int>& scenes)
+{
+    for (size_t i{0}; i < frames.size();)
+    {
+        size_t end{i};
+        float max_pq{0.0f};
+        double sum_avg{0.0};
+        int count{0};
+
+        for (; end < frames.size() && scenes[end] == scenes[i]; ++end)
+        {
+            if (frames[end].max_pq < 0.0f)
+                continue;
+
+            max_pq = std::max(max_pq, frames[end].max_pq);
+            sum_avg += frames[end].avg_pq;
+            ++count;
+        }
+
+        for (; i < end; ++i)
+        {
+            if (frames[i].max_pq >= 0.0f)
+                frames[i] = {max_pq, static_cast<float>(sum_avg / count)};
+        }
+    }
+}
+
+// Values of every `"key": number` (`"key": [numbers]`: the largest) in `text`, in file order. A linear scan instead of a JSON parser
+// or std::regex, HDR10+ exports of a feature are hundreds of MB.
+static std::vector<float> json_values(const std::string& text, const std::string& key)
+{
+    std::vector<float> values;
+    const std::string quoted{"\"" + key + "\""};
+    constexpr const char* spaces{" \t\r\n"};
+
+    for (size_t pos{text.find(quoted)}; pos != std::string::npos; pos = text.find(quoted, pos))
+    {
+        pos = text.find_first_not_of(spaces, pos + quoted.size());
+        if (pos == std::string::npos || text[pos] != ':')
+            continue;
+
+        pos = text.find_first_not_of(spaces, pos + 1);
+        if (pos == std::string::npos)
+            break;
+
+        const bool array{text[pos] == '['};
+        if (array)
+            ++pos;
+
+        float value{-1.0f};
+        while (pos < text.size())
+        {
+            pos = text.find_first_not_of(spaces, pos);
+            if (pos == std::string::npos)
+                break;
+
+            const char* start{text.c_str() + pos};
+            char* end;
+            const float v{std::strtof(start, &end)};
+            if (end == start)
+                break;
+
+            value = std::max(value, v);
+            pos += end - start;
+
+            pos = text.find_first_not_of(spaces, pos);
+            if (!array || pos == std::string::npos || text[pos] != ',')
+                break;
+            ++pos;
+        }
+
+        if (value >= 0.0f)
+            values.emplace_back(value);
+    }
+
+    return values;
+}
+
+// Reads a file of write_measurements or an HDR10+ JSON (hdr10plus_tool export). Frames without values get max_pq -1.
+static bool read_measurements(const std::string& path, const int num_frames, std::vector<hdr_measurement>& frames, std::string& err)
+{
+    std::ifstream file(path);
+    if (!file)
+    {
+        err = "error opening file " + path + " (" + std::strerror(errno) + ")";
+        return false;
+    }
+
+    std::stringstream ss;
+    ss << file.rdbuf();
+    const std::string text{ss.str()};
+
+    frames.assign(num_frames, {-1.0f, -1.0f});
+    std::vector<int> scenes(num_frames, -1);
+
+    const size_t first_char{text.find_first_not_of(" \t\r\n")};
+    if (first_char != std::string::npos && text[first_char] == '{')
+    {
+        // HDR10+: one SceneInfo entry per frame, MaxScl/AverageRGB in 0.1 nits.
+        const std::vector<float> max_nits{json_values(text, "MaxScl")};
+        const std::vector<float> avg_nits{json_values(text, "AverageRGB")};
+        const std::vector<float> ids{json_values(text, "SceneId")};
+
+        if (max_nits.empty() || max_nits.size() != avg_nits.size())
+        {
+            err = path + " isn't a valid HDR10+ JSON";
+            return false;
+        }
+
+        for (size_t i{0}; i < max_nits.size() && i < frames.size(); ++i)
+        {
+            frames[i].max_pq = pl_hdr_rescale(PL_HDR_NITS, PL_HDR_PQ, max_nits[i] / 10.0f);
+            frames[i].avg_pq = pl_hdr_rescale(PL_HDR_NITS, PL_HDR_PQ, avg_nits[i] / 10.0f);
+            scenes[i] = (ids.size() == max_nits.size()) ? static_cast<int>(ids[i]) : static_cast<int>(i);
+        }
+    }
+    else
+    {
+        std::istringstream lines(text);
+        std::string line;
+        while (std::getline(lines, line))
+        {
+            if (line.empty() || line[0] == '#')
+                continue;
+
+            std::istringstream fields(line);
+            int n;
+            hdr_measurement m;
+            int scene;
+            if (!(fields >> n >> m.max_pq >> m.avg_pq >> scene))
+            {
+                err = "invalid line \"" + line + "\" in " + path;
+                return false;
+            }
+
+            if (n >= 0 && n < num_frames)
+            {
+                frames[n] = m;
+                scenes[n] = scene;
+            }
+        }
+    }
+
+    scene_measurements(frames, scenes);
+
+    return true;
+}
+
 enum class supported_colorspace
 {
     CSP_SDR = 0,
@@ -158,8 +462,7 @@ static constexpr auto map_primaries{Map<int, int, 10>{{frame_prop_primaries}}};
 
 struct tonemap
 {
-    std::mutex mtx;
-    std::unique_ptr<priv> vf;
+    std::vector<std::unique_ptr<priv>> vf;
     std::unique_ptr<pl_render_params> render_params;
     enum supported_colorspace src_csp;
     enum supported_colorspace dst_csp;
@@ -168,122 +471,202 @@ struct tonemap
     float original_src_max;
     float original_src_min;
     int is_subsampled;
-    enum pl_chroma_location chromaLocation;
     std::string msg;
     std::unique_ptr<pl_color_repr> src_repr;
     std::unique_ptr<pl_color_repr> dst_repr;
     int use_dovi;
     std::unique_ptr<pl_color_map_params> colorMapParams;
     std::unique_ptr<pl_peak_detect_params> peakDetectParams;
-    std::unique_ptr<pl_dovi_metadata> dovi_meta;
+    dovi_cache dovi_rpus;
+    // Measurement mode: the per frame peak detection results, written to measure_path when the filter is destroyed.
+    std::filesystem::path measure_path;
+    std::mutex measure_mtx;
+    std::map<int, hdr_measurement> measured;
+    // Playback mode: per frame values from a measurement or HDR10+ file, used instead of the peak detection.
+    std::vector<hdr_measurement> playback;
+    // Ordered peak detection (ordered_peak=true): every frame is measured once (without smoothing) and the measurements are smoothed in
+    // frame order, so the result doesn't depend on the order the threads and devices process the frames. Shared by all threads of the
+    // instance. The measurements are kept for the last `peak_max_frames` frames used (LRU).
+    int ordered_peak;
+    std::unique_ptr<pl_peak_detect_params> measure_params;
+    std::mutex peak_mtx;
+    std::map<int, peak_entry> peak_raw;
+    uint64_t peak_clock;
+    size_t peak_max_frames;
+    // Bake mode: the static conversion (from source RGB to target RGB) as a 3D LUT, applied instead of the color mapping.
+    std::vector<float> baked_data;
+    std::unique_ptr<pl_custom_lut> baked;
+    int stats;
+    // Tile size (0: only when the frame is larger than the texture limit) and the border needed around it.
+    int tile;
+    int halo;
+    // warmup=true.
+    std::thread warmup;
+};
+
+// Per frame state, built from the defaults of the filter (src_pl_csp, dst_pl_csp, src_repr, dst_repr) and the frame properties.
+// Not modified after it's built.
+struct tonemap_frame
+{
+    pl_color_space src_pl_csp;
+    pl_color_space dst_pl_csp;
+    pl_color_repr src_repr;
+    pl_color_repr dst_repr;
+    enum pl_chroma_location chromaLocation;
+    // Owns the metadata src_repr.dovi points to.
+    std::shared_ptr<const dovi_rpu_info> dovi;
 };
 
-static bool tonemap_do_plane(tonemap* d, const pl_plane* planes) noexcept
+static bool tonemap_do_plane(tonemap* d, priv* vf, const pl_plane* planes, const tonemap_frame& f, const bool tiled) noexcept
 {
     pl_frame img{};
     img.num_planes = 3;
-    img.repr = *d->src_repr;
+    img.repr = f.src_repr;
     img.planes[0] = planes[0];
     img.planes[1] = planes[1];
     img.planes[2] = planes[2];
-    img.color = *d->src_pl_csp;
+    img.color = f.src_pl_csp;
 
     if (d->is_subsampled)
-        pl_frame_set_chroma_location(&img, d->chromaLocation);
+        pl_frame_set_chroma_location(&img, f.chromaLocation);
 
     pl_frame out{};
     out.num_planes = 3;
-    out.repr = *d->dst_repr;
-    out.color = *d->dst_pl_csp;
+    out.repr = f.dst_repr;
+    out.color = f.dst_pl_csp;
 
     for (int i{0}; i < 3; ++i)
     {
-        out.planes[i].texture = d->vf->tex_out[i];
+        out.planes[i].texture = vf->tex_out[i];
         out.planes[i].components = 1;
         out.planes[i].component_mapping[0] = i;
     }
 
-    return pl_render_image(d->vf->rr, &img, &out, d->render_params.get());
+    pl_render_params render_params{*d->render_params};
+    if (d->stats)
+        render_params.info_priv = vf;
+    // The peak would be measured per tile. Contrast recovery downscales a feature map on the grid of every tile, the tiles wouldn't
+    // match at their edges.
+    pl_color_map_params color_map{*d->colorMapParams};
+    if (tiled)
+    {
+        render_params.peak_detect_params = nullptr;
+        color_map.contrast_recovery = 0.0f;
+        render_params.color_map_params = &color_map;
+    }
+    if (d->baked)
+    {
+        render_params.lut = d->baked.get();
+        render_params.lut_type = PL_LUT_CONVERSION;
+    }
+
+    return pl_render_image(vf->rr, &img, &out, &render_params);
 }
 
-static int tonemap_filter(AVS_VideoFrame* dst, AVS_VideoFrame* src, tonemap* d, const AVS_FilterInfo* fi) noexcept
+static int tonemap_filter(AVS_VideoFrame* dst, AVS_VideoFrame* src, tonemap* d, const AVS_FilterInfo* fi, priv* vf, const tonemap_frame& f,
+    pl_hdr_metadata* measured, gpu_job* job) noexcept
 {
-    const pl_fmt fmt{pl_find_named_fmt(d->vf->gpu, "r16")};
+    const pl_fmt fmt{pl_find_named_fmt(vf->gpu, "r16")};
     if (!fmt)
         return -1;
 
-    pl_tex_params t_r{};
-    t_r.w = fi->vi.width;
-    t_r.h = fi->vi.height;
-    t_r.format = fmt;
-    t_r.renderable = true;
-    t_r.host_readable = true;
-
     pl_plane pl_planes[3]{};
     constexpr int planes_y[3]{AVS_PLANAR_Y, AVS_PLANAR_U, AVS_PLANAR_V};
     constexpr int planes_r[3]{AVS_PLANAR_R, AVS_PLANAR_G, AVS_PLANAR_B};
     const int* planes{(avs_is_rgb(&fi->vi)) ? planes_r : planes_y};
 
-    for (int i{0}; i < 3; ++i)
-    {
-        const int plane{planes[i]};
+    const int width{fi->vi.width};
+    const int height{fi->vi.height};
+    // Chroma subsampling of the source, the tiles are aligned to it.
+    const int sub_w{g_avs_api->avs_get_row_size_p(src, planes[0]) / g_avs_api->avs_get_row_size_p(src, planes[1])};
+    const int sub_h{g_avs_api->avs_get_height_p(src, planes[0]) / g_avs_api->avs_get_height_p(src, planes[1])};
+    const int align{std::max(sub_w, sub_h)};
 
-        pl_plane_data pl{};
-        pl.type = PL_FMT_UNORM;
-        pl.pixel_stride = 2;
-        pl.component_size[0] = 16;
-        pl.width = g_avs_api->avs_get_row_size_p(src, plane) / g_avs_api->avs_component_size(&fi->vi);
-        pl.height = g_avs_api->avs_get_height_p(src, plane);
-        pl.row_stride = g_avs_api->avs_get_pitch_p(src, plane);
-        pl.pixels = g_avs_api->avs_get_read_ptr_p(src, plane);
-        pl.component_map[0] = i;
+    const std::vector<pl_rect2d> tiles{split_tiles(width, height, tile_size(d->tile, vf->gpu, d->halo, align))};
 
-        // Upload planes
-        if (!pl_upload_plane(d->vf->gpu, &pl_planes[i], &d->vf->tex_in[i], &pl))
-            return -1;
-        if (!pl_tex_recreate(d->vf->gpu, &d->vf->tex_out[i], &t_r))
-            return -1;
-    }
+    for (const pl_rect2d& tile : tiles)
+    {
+        const pl_rect2d in{tile_input(tile, d->halo, align, width, height)};
 
-    // Process plane
-    if (!tonemap_do_plane(d, pl_planes))
-        return -1;
+        pl_tex_params t_r{};
+        t_r.w = in.x1 - in.x0;
+        t_r.h = in.y1 - in.y0;
+        t_r.format = fmt;
+        t_r.renderable = true;
+        t_r.host_readable = true;
 
-    // Download planes
-    for (int i{0}; i < 3; ++i)
-    {
-        pl_tex_transfer_params ttr1{};
-        ttr1.tex = d->vf->tex_out[i];
-        ttr1.row_pitch = g_avs_api->avs_get_pitch_p(dst, planes[i]);
-        ttr1.ptr = g_avs_api->avs_get_write_ptr_p(dst, planes[i]);
+        for (int i{0}; i < 3; ++i)
+        {
+            const int plane{planes[i]};
+            const int ssw{(i) ? sub_w : 1};
+            const int ssh{(i) ? sub_h : 1};
+
+            pl_plane_data pl{};
+            pl.type = PL_FMT_UNORM;
+            pl.pixel_stride = 2;
+            pl.component_size[0] = 16;
+            pl.width = t_r.w / ssw;
+            pl.height = t_r.h / ssh;
+            pl.row_stride = g_avs_api->avs_get_pitch_p(src, plane);
+            pl.pixels = g_avs_api->avs_get_read_ptr_p(src, plane) + static_cast<size_t>(in.y0 / ssh) * pl.row_stride + (in.x0 / ssw) * 2;
+            pl.component_map[0] = i;
+
+            // Upload planes
+            if (!pl_upload_plane(vf->gpu, &pl_planes[i], &vf->tex_in[i], &pl))
+                return -1;
+
+            vf->bytes_uploaded += static_cast<uint64_t>(pl.width) * pl.height * 2;
+            if (!pl_tex_recreate(vf->gpu, &vf->tex_out[i], &t_r))
+                return -1;
+        }
 
-        if (!pl_tex_download(d->vf->gpu, &ttr1))
+        // Process plane
+        if (!tonemap_do_plane(d, vf, pl_planes, f, tiles.size() > 1))
             return -1;
+
+        // Result of the peak detection of this frame (not available for tiled frames).
+        if (measured && tiles.size() == 1 && !pl_renderer_get_hdr_metadata(vf->rr, measured))
+            measured->max_pq_y = -1.0f;
+
+        // Download planes
+        for (int i{0}; i < 3; ++i)
+        {
+            const int dst_pitch{g_avs_api->avs_get_pitch_p(dst, planes[i])};
+
+            // Only the inner part of the tile, the halo is covered by the neighbours.
+            pl_tex_transfer_params ttr1{};
+            ttr1.tex = vf->tex_out[i];
+            ttr1.rc.x0 = tile.x0 - in.x0;
+            ttr1.rc.y0 = tile.y0 - in.y0;
+            ttr1.rc.z0 = 0;
+            ttr1.rc.x1 = tile.x1 - in.x0;
+            ttr1.rc.y1 = tile.y1 - in.y0;
+            ttr1.rc.z1 = 1;
+            ttr1.row_pitch = dst_pitch;
+            ttr1.ptr = g_avs_api->avs_get_write_ptr_p(dst, planes[i]) + static_cast<size_t>(tile.y0) * dst_pitch + tile.x0 * 2;
+            ttr1.timer = vf->timer;
+
+            if (!gpu_download(job, vf->gpu, ttr1))
+                return -1;
+
+            vf->bytes_downloaded += static_cast<uint64_t>(tile.x1 - tile.x0) * (tile.y1 - tile.y0) * 2;
+        }
     }
 
     return 0;
 }
 
-static AVS_VideoFrame* AVSC_CC tonemap_get_frame(AVS_FilterInfo* fi, int n)
+// Builds the state of the frame from the source properties. The filter isn't modified (the RPU cache has its own lock), so concurrent
+// frames don't wait for each other and can't see each other's metadata.
+// `dynamic` (max_pq -1: none) replaces the dynamic metadata of the frame.
+static bool tonemap_frame_info(tonemap* d, const AVS_FilterInfo* fi, AVS_VideoFrame* src, const hdr_measurement& dynamic, tonemap_frame& f,
+    std::string& err_msg)
 {
-    tonemap* d{reinterpret_cast<tonemap*>(fi->user_data)};
-
-    avs_helpers::avs_video_frame_ptr src_ptr{g_avs_api->avs_get_frame(fi->child, n)};
-    AVS_VideoFrame* src{src_ptr.get()};
-    if (!src)
-        return nullptr;
-
-    avs_helpers::avs_video_frame_ptr dst_ptr{g_avs_api->avs_new_video_frame_p(fi->env, &fi->vi, src)};
-    AVS_VideoFrame* dst{dst_ptr.get()};
-
-    const auto error{[&](const std::string& msg) {
-        d->msg = msg;
-        fi->error = d->msg.c_str();
-
-        return nullptr;
-    }};
-
-    std::lock_guard<std::mutex> lck(d->mtx);
+    f.src_pl_csp = *d->src_pl_csp;
+    f.dst_pl_csp = *d->dst_pl_csp;
+    f.src_repr = *d->src_repr;
+    f.dst_repr = *d->dst_repr;
+    f.chromaLocation = PL_CHROMA_UNKNOWN;
 
     int err;
     const AVS_Map* props{g_avs_api->avs_get_frame_props_ro(fi->env, src)};
@@ -291,13 +674,13 @@ static AVS_VideoFrame* AVSC_CC tonemap_get_frame(AVS_FilterInfo* fi, int n)
     int64_t props_levels{g_avs_api->avs_prop_get_int(fi->env, props, "_ColorRange", 0, &err)};
     if (!err)
         // Existing range prop
-        d->src_repr->levels = (props_levels) ? PL_COLOR_LEVELS_LIMITED : PL_COLOR_LEVELS_FULL;
+        f.src_repr.levels = (props_levels) ? PL_COLOR_LEVELS_LIMITED : PL_COLOR_LEVELS_FULL;
 
     if (!avs_is_rgb(&fi->vi))
     {
         if (!err && !props_levels)
             // Existing range & not limited
-            d->dst_repr->levels = PL_COLOR_LEVELS_FULL;
+            f.dst_repr.levels = PL_COLOR_LEVELS_FULL;
     }
 
     // ST2086 metadata
@@ -306,13 +689,13 @@ static AVS_VideoFrame* AVSC_CC tonemap_get_frame(AVS_FilterInfo* fi, int n)
     const double maxCll{g_avs_api->avs_prop_get_float(fi->env, props, "ContentLightLevelMax", 0, &err)};
     const double maxFall{g_avs_api->avs_prop_get_float(fi->env, props, "ContentLightLevelAverage", 0, &err)};
 
-    d->src_pl_csp->hdr.max_cll = maxCll;
-    d->src_pl_csp->hdr.max_fall = maxFall;
+    f.src_pl_csp.hdr.max_cll = maxCll;
+    f.src_pl_csp.hdr.max_fall = maxFall;
 
     if (d->original_src_max < 1)
-        d->src_pl_csp->hdr.max_luma = g_avs_api->avs_prop_get_float(fi->env, props, "MasteringDisplayMaxLuminance", 0, &err);
+        f.src_pl_csp.hdr.max_luma = g_avs_api->avs_prop_get_float(fi->env, props, "MasteringDisplayMaxLuminance", 0, &err);
     if (d->original_src_min <= 0)
-        d->src_pl_csp->hdr.min_luma = g_avs_api->avs_prop_get_float(fi->env, props, "MasteringDisplayMinLuminance", 0, &err);
+        f.src_pl_csp.hdr.min_luma = g_avs_api->avs_prop_get_float(fi->env, props, "MasteringDisplayMinLuminance", 0, &err);
 
     const double* primariesX{g_avs_api->avs_prop_get_float_array(fi->env, props, "MasteringDisplayPrimariesX", &err)};
     const double* primariesY{g_avs_api->avs_prop_get_float_array(fi->env, props, "MasteringDisplayPrimariesY", &err)};
@@ -320,12 +703,12 @@ static AVS_VideoFrame* AVSC_CC tonemap_get_frame(AVS_FilterInfo* fi, int n)
     if (primariesX && primariesY && g_avs_api->avs_prop_num_elements(fi->env, props, "MasteringDisplayPrimariesX") == 3 &&
         g_avs_api->avs_prop_num_elements(fi->env, props, "MasteringDisplayPrimariesY") == 3)
     {
-        d->src_pl_csp->hdr.prim.red.x = primariesX[0];
-        d->src_pl_csp->hdr.prim.red.y = primariesY[0];
-        d->src_pl_csp->hdr.prim.green.x = primariesX[1];
-        d->src_pl_csp->hdr.prim.green.y = primariesY[1];
-        d->src_pl_csp->hdr.prim.blue.x = primariesX[2];
-        d->src_pl_csp->hdr.prim.blue.y = primariesY[2];
+        f.src_pl_csp.hdr.prim.red.x = primariesX[0];
+        f.src_pl_csp.hdr.prim.red.y = primariesY[0];
+        f.src_pl_csp.hdr.prim.green.x = primariesX[1];
+        f.src_pl_csp.hdr.prim.green.y = primariesY[1];
+        f.src_pl_csp.hdr.prim.blue.x = primariesX[2];
+        f.src_pl_csp.hdr.prim.blue.y = primariesY[2];
 
         // White point comes with primaries
         const double whitePointX{g_avs_api->avs_prop_get_float(fi->env, props, "MasteringDisplayWhitePointX", 0, &err)};
@@ -333,18 +716,18 @@ static AVS_VideoFrame* AVSC_CC tonemap_get_frame(AVS_FilterInfo* fi, int n)
 
         if (whitePointX && whitePointY)
         {
-            d->src_pl_csp->hdr.prim.white.x = whitePointX;
-            d->src_pl_csp->hdr.prim.white.y = whitePointY;
+            f.src_pl_csp.hdr.prim.white.x = whitePointX;
+            f.src_pl_csp.hdr.prim.white.y = whitePointY;
         }
     }
     else
         // Assume DCI-P3 D65 default?
-        pl_raw_primaries_merge(&d->src_pl_csp->hdr.prim,
-            pl_raw_primaries_get((d->src_csp == supported_colorspace::CSP_SDR) ? d->src_pl_csp->primaries : PL_COLOR_PRIM_DISPLAY_P3));
+        pl_raw_primaries_merge(&f.src_pl_csp.hdr.prim,
+            pl_raw_primaries_get((d->src_csp == supported_colorspace::CSP_SDR) ? f.src_pl_csp.primaries : PL_COLOR_PRIM_DISPLAY_P3));
 
-    d->chromaLocation = static_cast<pl_chroma_location>(g_avs_api->avs_prop_get_int(fi->env, props, "_ChromaLocation", 0, &err));
+    f.chromaLocation = static_cast<pl_chroma_location>(g_avs_api->avs_prop_get_int(fi->env, props, "_ChromaLocation", 0, &err));
     if (!err)
-        d->chromaLocation = static_cast<pl_chroma_location>(static_cast<int>(d->chromaLocation) + 1);
+        f.chromaLocation = static_cast<pl_chroma_location>(static_cast<int>(f.chromaLocation) + 1);
 
     // DOVI
     if (d->src_csp == supported_colorspace::CSP_DOVI)
@@ -359,92 +742,515 @@ static AVS_VideoFrame* AVSC_CC tonemap_get_frame(AVS_FilterInfo* fi, int n)
 
                 if (doviRpu && doviRpuSize)
                 {
-                    DoviRpuOpaque* rpu{dovi_parse_unspec62_nalu(doviRpu, doviRpuSize)};
-                    const DoviRpuDataHeader* header{dovi_rpu_get_header(rpu)};
-
-                    if (!header)
-                    {
-                        std::string err{dovi_rpu_get_error(rpu)};
-                        dovi_rpu_free(rpu);
-                        return error("libplacebo_Tonemap: failed parsing RPU: " + err);
-                    }
-                    else
+                    std::string rpu_err;
+                    std::shared_ptr<const dovi_rpu_info> rpu{dovi_cache_get(d->dovi_rpus, doviRpu, doviRpuSize, rpu_err)};
+                    if (!rpu)
                     {
-                        dovi_profile = header->guessed_profile;
-                        d->dovi_meta = create_dovi_meta(*rpu, *header);
-                        dovi_rpu_free_header(header);
+                        err_msg = "failed parsing RPU: " + rpu_err;
+                        return false;
                     }
 
+                    f.dovi = std::move(rpu);
+                    dovi_profile = f.dovi->profile;
+
                     // Profile 5, 7 or 8 mapping
-                    d->src_repr->sys = PL_COLOR_SYSTEM_DOLBYVISION;
-                    d->src_repr->dovi = d->dovi_meta.get();
+                    f.src_repr.sys = PL_COLOR_SYSTEM_DOLBYVISION;
+                    f.src_repr.dovi = f.dovi->meta.get();
 
                     if (dovi_profile == 5)
-                        d->dst_repr->levels = PL_COLOR_LEVELS_FULL;
+                        f.dst_repr.levels = PL_COLOR_LEVELS_FULL;
 
                     // Update mastering display from RPU
-                    if (header->vdr_dm_metadata_present_flag)
+                    if (f.dovi->has_vdr_dm)
                     {
-                        const DoviVdrDmData* vdr_dm_data{dovi_rpu_get_vdr_dm_data(rpu)};
-
                         // Should avoid changing the source black point when mapping to PQ
                         // As the source image already has a specific black point,
                         // and the RPU isn't necessarily ground truth on the actual coded values
 
                         // Set target black point to the same as source
                         if (d->dst_csp == supported_colorspace::CSP_HDR10)
-                            d->dst_pl_csp->hdr.min_luma = d->src_pl_csp->hdr.min_luma;
+                            f.dst_pl_csp.hdr.min_luma = f.src_pl_csp.hdr.min_luma;
                         else
-                            d->src_pl_csp->hdr.min_luma = pl_hdr_rescale(PL_HDR_PQ, PL_HDR_NITS, vdr_dm_data->source_min_pq / 4095.0f);
+                            f.src_pl_csp.hdr.min_luma = pl_hdr_rescale(PL_HDR_PQ, PL_HDR_NITS, f.dovi->source_min_pq / 4095.0f);
 
-                        d->src_pl_csp->hdr.max_luma = pl_hdr_rescale(PL_HDR_PQ, PL_HDR_NITS, vdr_dm_data->source_max_pq / 4095.0f);
+                        f.src_pl_csp.hdr.max_luma = pl_hdr_rescale(PL_HDR_PQ, PL_HDR_NITS, f.dovi->source_max_pq / 4095.0f);
 
-                        if (vdr_dm_data->dm_data.level1)
+                        if (f.dovi->has_level1)
                         {
-                            const DoviExtMetadataBlockLevel1* l1{vdr_dm_data->dm_data.level1};
-                            d->src_pl_csp->hdr.avg_pq_y = l1->avg_pq / 4095.0f;
-                            d->src_pl_csp->hdr.max_pq_y = l1->max_pq / 4095.0f;
-                            d->src_pl_csp->hdr.scene_avg = pl_hdr_rescale(PL_HDR_PQ, PL_HDR_NITS, l1->avg_pq / 4095.0f);
-                            d->src_pl_csp->hdr.scene_max[0] = d->src_pl_csp->hdr.scene_max[1] = d->src_pl_csp->hdr.scene_max[2] =
-                                pl_hdr_rescale(PL_HDR_PQ, PL_HDR_NITS, l1->max_pq / 4095.0f);
+                            f.src_pl_csp.hdr.avg_pq_y = f.dovi->avg_pq / 4095.0f;
+                            f.src_pl_csp.hdr.max_pq_y = f.dovi->max_pq / 4095.0f;
+                            f.src_pl_csp.hdr.scene_avg = pl_hdr_rescale(PL_HDR_PQ, PL_HDR_NITS, f.dovi->avg_pq / 4095.0f);
+                            f.src_pl_csp.hdr.scene_max[0] = f.src_pl_csp.hdr.scene_max[1] = f.src_pl_csp.hdr.scene_max[2] =
+                                pl_hdr_rescale(PL_HDR_PQ, PL_HDR_NITS, f.dovi->max_pq / 4095.0f);
                         }
 
-                        if (vdr_dm_data->dm_data.level6)
+                        if (f.dovi->has_level6)
                         {
-                            const DoviExtMetadataBlockLevel6* meta{vdr_dm_data->dm_data.level6};
-
                             if (!maxCll || !maxFall)
                             {
-                                d->src_pl_csp->hdr.max_cll = meta->max_content_light_level;
-                                d->src_pl_csp->hdr.max_fall = meta->max_frame_average_light_level;
+                                f.src_pl_csp.hdr.max_cll = f.dovi->max_cll;
+                                f.src_pl_csp.hdr.max_fall = f.dovi->max_fall;
                             }
                         }
-
-                        dovi_rpu_free_vdr_dm_data(vdr_dm_data);
                     }
-
-                    dovi_rpu_free(rpu);
                 }
                 else
-                    return error("libplacebo_Tonemap: invlid DolbyVisionRPU frame property!");
+                {
+                    err_msg = "invlid DolbyVisionRPU frame property!";
+                    return false;
+                }
             }
         }
         else
-            return error("libplacebo_Tonemap: DolbyVisionRPU frame property is required for src_csp=3!");
+        {
+            err_msg = "DolbyVisionRPU frame property is required for src_csp=3!";
+            return false;
+        }
+    }
+
+    if (dynamic.max_pq >= 0.0f)
+    {
+        f.src_pl_csp.hdr.max_pq_y = dynamic.max_pq;
+        f.src_pl_csp.hdr.avg_pq_y = dynamic.avg_pq;
+        f.src_pl_csp.hdr.scene_avg = pl_hdr_rescale(PL_HDR_PQ, PL_HDR_NITS, dynamic.avg_pq);
+        f.src_pl_csp.hdr.scene_max[0] = f.src_pl_csp.hdr.scene_max[1] = f.src_pl_csp.hdr.scene_max[2] =
+            pl_hdr_rescale(PL_HDR_PQ, PL_HDR_NITS, dynamic.max_pq);
+    }
+
+    pl_color_space_infer_map(&f.src_pl_csp, &f.dst_pl_csp);
+
+    return true;
+}
+
+// Peak detection of one frame: rendered to a small RGB target, only the detected metadata is used.
+static int tonemap_measure(
+    AVS_VideoFrame* src, tonemap* d, const AVS_FilterInfo* fi, priv* vf, const tonemap_frame& f, hdr_measurement& m) noexcept
+{
+    // The peak is detected on the whole frame, larger frames are tiled and have no measurement.
+    if (std::max(fi->vi.width, fi->vi.height) > static_cast<int>(vf->gpu->limits.max_tex_2d_dim))
+        return 0;
+
+    constexpr int planes_y[3]{AVS_PLANAR_Y, AVS_PLANAR_U, AVS_PLANAR_V};
+    constexpr int planes_r[3]{AVS_PLANAR_R, AVS_PLANAR_G, AVS_PLANAR_B};
+    const int* planes{(avs_is_rgb(&fi->vi)) ? planes_r : planes_y};
+
+    pl_frame img{};
+    img.num_planes = 3;
+    img.repr = f.src_repr;
+    img.color = f.src_pl_csp;
+
+    for (int i{0}; i < 3; ++i)
+    {
+        pl_plane_data pl{};
+        pl.type = PL_FMT_UNORM;
+        pl.pixel_stride = 2;
+        pl.component_size[0] = 16;
+        pl.width = g_avs_api->avs_get_row_size_p(src, planes[i]) / 2;
+        pl.height = g_avs_api->avs_get_height_p(src, planes[i]);
+        pl.row_stride = g_avs_api->avs_get_pitch_p(src, planes[i]);
+        pl.pixels = g_avs_api->avs_get_read_ptr_p(src, planes[i]);
+        pl.component_map[0] = i;
+
+        if (!pl_upload_plane(vf->gpu, &img.planes[i], &vf->tex_in[i], &pl))
+            return -1;
+
+        vf->bytes_uploaded += static_cast<uint64_t>(pl.width) * pl.height * 2;
+    }
+
+    if (d->is_subsampled)
+        pl_frame_set_chroma_location(&img, f.chromaLocation);
+
+    // The output isn't used, a small target keeps the scaling and tone mapping passes cheap.
+    pl_tex_params t_r{};
+    t_r.w = 16;
+    t_r.h = 16;
+    t_r.format = pl_find_named_fmt(vf->gpu, "rgba16");
+    t_r.renderable = true;
+    if (!t_r.format || !pl_tex_recreate(vf->gpu, &vf->sample_fbo, &t_r))
+        return -1;
+
+    pl_frame out{};
+    out.num_planes = 1;
+    out.planes[0].texture = vf->sample_fbo;
+    out.planes[0].components = 4;
+    for (int i{0}; i < 4; ++i)
+        out.planes[0].component_mapping[i] = i;
+    out.repr = pl_color_repr_rgb;
+    out.color = f.dst_pl_csp;
+
+    pl_render_params render_params{*d->render_params};
+    render_params.peak_detect_params = d->measure_params.get();
+    if (d->stats)
+        render_params.info_priv = vf;
+
+    if (!pl_render_image(vf->rr, &img, &out, &render_params))
+        return -1;
+
+    pl_hdr_metadata hdr{};
+    if (pl_renderer_get_hdr_metadata(vf->rr, &hdr) && hdr.max_pq_y > 0.0f)
+        m = {hdr.max_pq_y, hdr.avg_pq_y};
+
+    return 0;
+}
+
+// Unsmoothed measurement of frame `n` (max_pq -1: the frame can't be measured). Every frame is measured once, concurrent requests of a
+// frame wait for the first one.
+static bool peak_raw(tonemap* d, AVS_FilterInfo* fi, const int n, hdr_measurement& m, std::string& err)
+{
+    std::promise<hdr_measurement> promise;
+    std::shared_future<hdr_measurement> result;
+
+    {
+        std::lock_guard<std::mutex> lck(d->peak_mtx);
+
+        const auto itr{d->peak_raw.find(n)};
+        if (itr != d->peak_raw.end())
+        {
+            result = itr->second.result;
+            itr->second.used = ++d->peak_clock;
+        }
+        else
+        {
+            // Evicts the least recently used finished measurement, the ones in progress have waiting threads.
+            if (d->peak_raw.size() >= d->peak_max_frames)
+            {
+                auto lru{d->peak_raw.end()};
+                for (auto e{d->peak_raw.begin()}; e != d->peak_raw.end(); ++e)
+                {
+                    if ((lru == d->peak_raw.end() || e->second.used < lru->second.used) &&
+                        e->second.result.wait_for(std::chrono::seconds(0)) == std::future_status::ready)
+                        lru = e;
+                }
+                if (lru != d->peak_raw.end())
+                    d->peak_raw.erase(lru);
+            }
+
+            d->peak_raw.emplace(n, peak_entry{promise.get_future().share(), ++d->peak_clock});
+        }
+    }
+
+    if (result.valid())
+    {
+        m = result.get();
+        if (m.max_pq < -1.5f)
+        {
+            err = "measuring frame " + std::to_string(n) + " failed";
+            return false;
+        }
+
+        return true;
+    }
+
+    const auto fail{[&]() {
+        {
+            std::lock_guard<std::mutex> lck(d->peak_mtx);
+            d->peak_raw.erase(n);
+        }
+
+        promise.set_value({-2.0f, -2.0f});
+        return false;
+    }};
+
+    avs_helpers::avs_video_frame_ptr src_ptr{g_avs_api->avs_get_frame(fi->child, n)};
+    AVS_VideoFrame* src{src_ptr.get()};
+    if (!src)
+    {
+        err = "getting frame " + std::to_string(n) + " failed";
+        return fail();
+    }
+
+    tonemap_frame f{};
+    if (!tonemap_frame_info(d, fi, src, {-1.0f, -1.0f}, f, err))
+        return fail();
+
+    m = {-1.0f, -1.0f};
+    priv* vf{gpu_select(d->vf, n)};
+    if (!gpu_run(vf, n, frame_size(src, &fi->vi), [&](gpu_job* job) { return !tonemap_measure(src, d, fi, vf, f, m); }, err))
+        return fail();
+
+    promise.set_value(m);
+
+    return true;
+}
+
+// Measurements smoothed in frame order, over the last `peak_window` smoothing periods (older frames have a weight below 5%).
+static constexpr float peak_window{3.0f};
+// Measurements kept besides the window of every frame in flight.
+static constexpr size_t peak_extra_frames{64};
+
+static int peak_window_frames(const pl_peak_detect_params& p) noexcept
+{
+    return (p.smoothing_period > 0.0f) ? static_cast<int>(std::ceil(p.smoothing_period * peak_window)) : 0;
+}
+
+static bool peak_smoothed(tonemap* d, AVS_FilterInfo* fi, const int n, hdr_measurement& out, std::string& err)
+{
+    const pl_peak_detect_params& p{*d->peakDetectParams};
+    const int window{peak_window_frames(p)};
+    const float coeff{(p.smoothing_period > 1.0f) ? 1.0f / p.smoothing_period : 1.0f};
+
+    out = {-1.0f, -1.0f};
+    hdr_measurement m;
+
+    for (int i{std::max(n - window, 0)}; i <= n; ++i)
+    {
+        if (!peak_raw(d, fi, i, m, err))
+            return false;
+        if (m.max_pq < 0.0f)
+            continue;
+        if (out.max_pq < 0.0f)
+        {
+            out = m;
+            continue;
+        }
+
+        // Scene changes (percent of the PQ range) blend towards the new value, above the high threshold it's used as it is.
+        const float delta{std::abs(m.avg_pq - out.avg_pq) * 100.0f};
+        float mix{0.0f};
+        if (p.scene_threshold_low > 0.0f && p.scene_threshold_high > 0.0f)
+            mix = (p.scene_threshold_high > p.scene_threshold_low)
+                ? std::clamp((delta - p.scene_threshold_low) / (p.scene_threshold_high - p.scene_threshold_low), 0.0f, 1.0f)
+                : static_cast<float>(delta > p.scene_threshold_high);
+
+        const float k{coeff + (1.0f - coeff) * mix};
+        out.max_pq += (m.max_pq - out.max_pq) * k;
+        out.avg_pq += (m.avg_pq - out.avg_pq) * k;
+    }
+
+    // No measurement of the frame itself (the last one of the loop), the static metadata is used.
+    if (m.max_pq < 0.0f)
+        out = {-1.0f, -1.0f};
+
+    return true;
+}
+
+// Points per dimension of the baked LUT when bake_size isn't defined. The lattice is rendered as a (size * size) x size image.
+static constexpr int bake_default_size{64};
+
+// `f`: the color spaces of the first frame (static parameters and HDR10 metadata of its properties).
+static int tonemap_bake(tonemap* d, priv* vf, const int size, const tonemap_frame& f, std::vector<float>& rgb) noexcept
+{
+    const pl_fmt fmt{pl_find_named_fmt(vf->gpu, "rgba32f")};
+    if (!fmt)
+        return -1;
+
+    std::vector<float> lattice(static_cast<size_t>(size) * size * size * 4);
+    for (int b{0}; b < size; ++b)
+    {
+        for (int g{0}; g < size; ++g)
+        {
+            for (int r{0}; r < size; ++r)
+            {
+                float* px{&lattice[((static_cast<size_t>(b) * size + g) * size + r) * 4]};
+                px[0] = static_cast<float>(r) / (size - 1);
+                px[1] = static_cast<float>(g) / (size - 1);
+                px[2] = static_cast<float>(b) / (size - 1);
+                px[3] = 1.0f;
+            }
+        }
+    }
+
+    pl_tex_params t_in{};
+    t_in.w = size * size;
+    t_in.h = size;
+    t_in.format = fmt;
+    t_in.sampleable = true;
+    t_in.initial_data = lattice.data();
+
+    pl_tex_params t_out{};
+    t_out.w = t_in.w;
+    t_out.h = t_in.h;
+    t_out.format = fmt;
+    t_out.renderable = true;
+    t_out.host_readable = true;
+
+    if (!pl_tex_recreate(vf->gpu, &vf->tex_in[0], &t_in) || !pl_tex_recreate(vf->gpu, &vf->tex_out[0], &t_out))
+        return -1;
+
+    pl_frame img{};
+    img.num_planes = 1;
+    img.planes[0].texture = vf->tex_in[0];
+    img.planes[0].components = 3;
+    for (int i{0}; i < 3; ++i)
+        img.planes[0].component_mapping[i] = i;
+    img.repr = pl_color_repr_rgb;
+    img.color = f.src_pl_csp;
+
+    pl_frame out{};
+    out.num_planes = 1;
+    out.planes[0].texture = vf->tex_out[0];
+    out.planes[0].components = 4;
+    for (int i{0}; i < 4; ++i)
+        out.planes[0].component_mapping[i] = i;
+    out.repr = pl_color_repr_rgb;
+    out.color = f.dst_pl_csp;
+
+    pl_color_space_infer_map(&img.color, &out.color);
+
+    // Dithering would end up in the LUT. Contrast recovery is spatial, on the lattice it would mix neighbouring entries.
+    pl_color_map_params color_map{*d->colorMapParams};
+    color_map.contrast_recovery = 0.0f;
+
+    pl_render_params render_params{*d->render_params};
+    render_params.dither_params = nullptr;
+    render_params.info_callback = nullptr;
+    render_params.color_map_params = &color_map;
+
+    if (!pl_render_image(vf->rr, &img, &out, &render_params))
+        return -1;
+
+    std::vector<float> result(lattice.size());
+    pl_tex_transfer_params ttr{};
+    ttr.tex = vf->tex_out[0];
+    ttr.ptr = result.data();
+
+    if (!pl_tex_download(vf->gpu, &ttr))
+        return -1;
+
+    rgb.resize(result.size() / 4 * 3);
+    for (size_t i{0}; i < result.size() / 4; ++i)
+    {
+        rgb[i * 3] = result[i * 4];
+        rgb[i * 3 + 1] = result[i * 4 + 1];
+        rgb[i * 3 + 2] = result[i * 4 + 2];
+    }
+
+    return 0;
+}
+
+// Everything the baked transform depends on, the cached LUT is only used when its key matches.
+static std::string bake_key(const tonemap* d, const int size, const tonemap_frame& f)
+{
+    std::ostringstream key;
+    key << std::hexfloat << "api" << PL_API_VER << " size" << size;
+
+    for (const pl_color_space* csp : {&f.src_pl_csp, &f.dst_pl_csp})
+    {
+        const pl_hdr_metadata& hdr{csp->hdr};
+        key << " csp" << csp->primaries << ',' << csp->transfer << ',' << hdr.prim.red.x << ',' << hdr.prim.red.y << ','
+            << hdr.prim.green.x << ',' << hdr.prim.green.y << ',' << hdr.prim.blue.x << ',' << hdr.prim.blue.y << ','
+            << hdr.prim.white.x << ',' << hdr.prim.white.y << ',' << hdr.min_luma << ',' << hdr.max_luma << ',' << hdr.max_cll
+            << ',' << hdr.max_fall;
+    }
+
+    const pl_color_map_params& cm{*d->colorMapParams};
+    const pl_tone_map_constants& tc{cm.tone_constants};
+    key << " map" << (cm.gamut_mapping ? cm.gamut_mapping->name : "none") << ','
+        << (cm.tone_mapping_function ? cm.tone_mapping_function->name : "none") << ',' << tc.knee_adaptation << ','
+        << tc.knee_minimum << ',' << tc.knee_maximum << ',' << tc.knee_default << ',' << tc.knee_offset << ',' << tc.slope_tuning
+        << ',' << tc.slope_offset << ',' << tc.spline_contrast << ',' << tc.reinhard_contrast << ',' << tc.linear_knee << ','
+        << tc.exposure << ',' << cm.metadata << ',' << cm.visualize_lut << ',' << cm.show_clipping;
+
+    return key.str();
+}
+
+static std::string cube_header(const std::string& key)
+{
+    return "# avs_libplacebo Tonemap " + key + "\n";
+}
+
+// .cube text of a baked LUT (red changes fastest, like pl_custom_lut).
+static std::string cube_text(const std::string& key, const int size, const std::vector<float>& rgb)
+{
+    std::string text{cube_header(key) + "TITLE \"avs_libplacebo Tonemap\"\nLUT_3D_SIZE " + std::to_string(size) +
+                     "\nDOMAIN_MIN 0 0 0\nDOMAIN_MAX 1 1 1\n"};
+    text.reserve(text.size() + rgb.size() * 12);
+
+    char line[64];
+    for (size_t i{0}; i < rgb.size(); i += 3)
+    {
+        // 9 significant digits round-trip a float.
+        std::snprintf(line, sizeof(line), "%.9g %.9g %.9g\n", rgb[i], rgb[i + 1], rgb[i + 2]);
+        text += line;
+    }
+
+    return text;
+}
+
+// Parses .cube text written by cube_text. Baked LUTs are always used as parsed, so a freshly baked LUT and one loaded from a file
+// give identical output.
+static bool cube_parse(pl_log log, const std::string& text, const int size, std::vector<float>& rgb)
+{
+    pl_custom_lut* lut{pl_lut_parse_cube(log, text.c_str(), text.size())};
+    if (!lut)
+        return false;
+
+    const bool ok{lut->size[0] == size && lut->size[1] == size && lut->size[2] == size};
+    if (ok)
+        rgb.assign(lut->data, lut->data + static_cast<size_t>(size) * size * size * 3);
+
+    pl_lut_free(&lut);
+
+    return ok;
+}
+
+// Cached LUT of the same key, false if there is none.
+static bool cube_load(pl_log log, const std::filesystem::path& path, const std::string& key, const int size, std::vector<float>& rgb)
+{
+    std::ifstream file(path, std::ios::binary);
+    if (!file)
+        return false;
+
+    std::ostringstream text;
+    text << file.rdbuf();
+    const std::string str{text.str()};
+
+    return str.starts_with(cube_header(key)) && cube_parse(log, str, size, rgb);
+}
+
+static AVS_VideoFrame* AVSC_CC tonemap_get_frame(AVS_FilterInfo* fi, int n)
+{
+    tonemap* d{reinterpret_cast<tonemap*>(fi->user_data)};
+
+    avs_helpers::avs_video_frame_ptr src_ptr{g_avs_api->avs_get_frame(fi->child, n)};
+    AVS_VideoFrame* src{src_ptr.get()};
+    if (!src)
+        return nullptr;
+
+    avs_helpers::avs_video_frame_ptr dst_ptr{g_avs_api->avs_new_video_frame_p(fi->env, &fi->vi, src)};
+    AVS_VideoFrame* dst{dst_ptr.get()};
+
+    // Playback file or ordered peak detection.
+    hdr_measurement dynamic{-1.0f, -1.0f};
+    std::string info_err;
+    if (n < static_cast<int>(d->playback.size()))
+        dynamic = d->playback[n];
+
+    tonemap_frame f{};
+    if ((d->ordered_peak && !peak_smoothed(d, fi, n, dynamic, info_err)) || !tonemap_frame_info(d, fi, src, dynamic, f, info_err))
+    {
+        frame_error(fi, "libplacebo_Tonemap: " + info_err);
+
+        return nullptr;
     }
 
-    pl_color_space_infer_map(d->src_pl_csp.get(), d->dst_pl_csp.get());
+    const uint64_t staging_bytes{frame_size(src, &fi->vi) + frame_size(dst, &fi->vi)};
+    std::string gpu_err;
+    priv* vf{gpu_select(d->vf, n)};
+    pl_hdr_metadata measured{};
+    measured.max_pq_y = -1.0f;
+    if (!gpu_run(vf, n, staging_bytes,
+            [&](gpu_job* job) { return !tonemap_filter(dst, src, d, fi, vf, f, (d->measure_path.empty()) ? nullptr : &measured, job); },
+            gpu_err))
+    {
+        frame_error(fi, "libplacebo_Tonemap: " + gpu_err);
 
-    if (tonemap_filter(dst, src, d, fi))
-        return error("libplacebo_Tonemap: " + d->vf->log_buffer.str());
+        return nullptr;
+    }
+
+    if (!d->measure_path.empty() && measured.max_pq_y >= 0.0f)
+    {
+        std::lock_guard<std::mutex> lck(d->measure_mtx);
+        d->measured[n] = {measured.max_pq_y, measured.avg_pq_y};
+    }
 
     AVS_Map* dst_props{g_avs_api->avs_get_frame_props_rw(fi->env, dst)};
-    g_avs_api->avs_prop_set_int(fi->env, dst_props, "_ColorRange", (d->dst_repr->levels == PL_COLOR_LEVELS_FULL) ? 0 : 1, 0);
-    g_avs_api->avs_prop_set_int(fi->env, dst_props, "_Matrix", (d->dst_repr->sys == PL_COLOR_SYSTEM_RGB) ? 0 : map_matrix.at(d->dst_repr->sys), 0);
-    g_avs_api->avs_prop_set_int(fi->env, dst_props, "_Transfer", map_transfer.at(d->dst_pl_csp->transfer), 0);
-    g_avs_api->avs_prop_set_int(fi->env, dst_props, "_Primaries", map_primaries.at(d->dst_pl_csp->primaries), 0);
+    g_avs_api->avs_prop_set_int(fi->env, dst_props, "_ColorRange", (f.dst_repr.levels == PL_COLOR_LEVELS_FULL) ? 0 : 1, 0);
+    g_avs_api->avs_prop_set_int(fi->env, dst_props, "_Matrix", (f.dst_repr.sys == PL_COLOR_SYSTEM_RGB) ? 0 : map_matrix.at(f.dst_repr.sys), 0);
+    g_avs_api->avs_prop_set_int(fi->env, dst_props, "_Transfer", map_transfer.at(f.dst_pl_csp.transfer), 0);
+    g_avs_api->avs_prop_set_int(fi->env, dst_props, "_Primaries", map_primaries.at(f.dst_pl_csp.primaries), 0);
 
-    if (d->dst_pl_csp->transfer <= PL_COLOR_TRC_ST428)
+    if (f.dst_pl_csp.transfer <= PL_COLOR_TRC_ST428)
     {
         g_avs_api->avs_prop_delete_key(fi->env, dst_props, "ContentLightLevelMax");
         g_avs_api->avs_prop_delete_key(fi->env, dst_props, "ContentLightLevelAverage");
@@ -457,18 +1263,18 @@ static AVS_VideoFrame* AVSC_CC tonemap_get_frame(AVS_FilterInfo* fi, int n)
     }
     else
     {
-        g_avs_api->avs_prop_set_float(fi->env, dst_props, "ContentLightLevelMax", d->dst_pl_csp->hdr.max_cll, 0);
-        g_avs_api->avs_prop_set_float(fi->env, dst_props, "ContentLightLevelAverage", d->dst_pl_csp->hdr.max_fall, 0);
-        g_avs_api->avs_prop_set_float(fi->env, dst_props, "MasteringDisplayMaxLuminance", d->dst_pl_csp->hdr.max_luma, 0);
-        g_avs_api->avs_prop_set_float(fi->env, dst_props, "MasteringDisplayMinLuminance", d->dst_pl_csp->hdr.min_luma, 0);
+        g_avs_api->avs_prop_set_float(fi->env, dst_props, "ContentLightLevelMax", f.dst_pl_csp.hdr.max_cll, 0);
+        g_avs_api->avs_prop_set_float(fi->env, dst_props, "ContentLightLevelAverage", f.dst_pl_csp.hdr.max_fall, 0);
+        g_avs_api->avs_prop_set_float(fi->env, dst_props, "MasteringDisplayMaxLuminance", f.dst_pl_csp.hdr.max_luma, 0);
+        g_avs_api->avs_prop_set_float(fi->env, dst_props, "MasteringDisplayMinLuminance", f.dst_pl_csp.hdr.min_luma, 0);
 
-        const std::array<double, 3> prims_x{d->dst_pl_csp->hdr.prim.red.x, d->dst_pl_csp->hdr.prim.green.x, d->dst_pl_csp->hdr.prim.blue.x};
-        const std::array<double, 3> prims_y{d->dst_pl_csp->hdr.prim.red.y, d->dst_pl_csp->hdr.prim.green.y, d->dst_pl_csp->hdr.prim.blue.y};
+        const std::array<double, 3> prims_x{f.dst_pl_csp.hdr.prim.red.x, f.dst_pl_csp.hdr.prim.green.x, f.dst_pl_csp.hdr.prim.blue.x};
+        const std::array<double, 3> prims_y{f.dst_pl_csp.hdr.prim.red.y, f.dst_pl_csp.hdr.prim.green.y, f.dst_pl_csp.hdr.prim.blue.y};
 
         g_avs_api->avs_prop_set_float_array(fi->env, dst_props, "MasteringDisplayPrimariesX", prims_x.data(), 3);
         g_avs_api->avs_prop_set_float_array(fi->env, dst_props, "MasteringDisplayPrimariesY", prims_y.data(), 3);
-        g_avs_api->avs_prop_set_float(fi->env, dst_props, "MasteringDisplayWhitePointX", d->dst_pl_csp->hdr.prim.white.x, 0);
-        g_avs_api->avs_prop_set_float(fi->env, dst_props, "MasteringDisplayWhitePointY", d->dst_pl_csp->hdr.prim.white.y, 0);
+        g_avs_api->avs_prop_set_float(fi->env, dst_props, "MasteringDisplayWhitePointX", f.dst_pl_csp.hdr.prim.white.x, 0);
+        g_avs_api->avs_prop_set_float(fi->env, dst_props, "MasteringDisplayWhitePointY", f.dst_pl_csp.hdr.prim.white.y, 0);
     }
 
     if (g_avs_api->avs_num_components(&fi->vi) > 3)
@@ -476,6 +1282,9 @@ static AVS_VideoFrame* AVSC_CC tonemap_get_frame(AVS_FilterInfo* fi, int n)
             g_avs_api->avs_get_read_ptr_p(src, AVS_PLANAR_A), g_avs_api->avs_get_pitch_p(src, AVS_PLANAR_A),
             g_avs_api->avs_get_row_size_p(src, AVS_PLANAR_A), g_avs_api->avs_get_height_p(src, AVS_PLANAR_A));
 
+    if (d->stats)
+        set_stats_props(fi->env, dst, vf, take_stats());
+
     return dst_ptr.release();
 }
 
@@ -483,16 +1292,23 @@ static void AVSC_CC free_tonemap(AVS_FilterInfo* fi)
 {
     tonemap* d{reinterpret_cast<tonemap*>(fi->user_data)};
 
+    if (d->warmup.joinable())
+        d->warmup.join();
+
     if (d->render_params->lut)
         pl_lut_free(const_cast<pl_custom_lut**>(&d->render_params->lut));
 
     avs_libplacebo_uninit(d->vf);
+
+    if (!d->measure_path.empty() && !d->measured.empty() && !write_measurements(d->measure_path, d->measured))
+        std::cerr << "libplacebo_Tonemap: error writing file " << d->measure_path.string() << "\n";
+
     delete d;
 }
 
 static int AVSC_CC tonemap_set_cache_hints(AVS_FilterInfo* fi, int cachehints, int frame_range)
 {
-    return cachehints == AVS_CACHE_GET_MTMODE ? 2 : 0;
+    return cachehints == AVS_CACHE_GET_MTMODE ? AVS_MT_NICE_FILTER : 0;
 }
 
 AVS_Value AVSC_CC create_tonemap(AVS_ScriptEnvironment* env, AVS_Value args, void* param)
@@ -528,7 +1344,16 @@ AVS_Value AVSC_CC create_tonemap(AVS_ScriptEnvironment* env, AVS_Value args, voi
         Lut_type,
         Dst_prim,
         Dst_trc,
-        Dst_sys
+        Dst_sys,
+        Stats,
+        Tile,
+        Measure,
+        Playback,
+        Bake,
+        Export_lut,
+        Bake_size,
+        Warmup,
+        Ordered_peak
     };
 
     AVS_FilterInfo* fi;
@@ -549,39 +1374,16 @@ AVS_Value AVSC_CC create_tonemap(AVS_ScriptEnvironment* env, AVS_Value args, voi
     if (g_avs_api->avs_num_components(&fi->vi) < 3)
         return set_error("libplacebo_Tonemap: the clip must have at least three planes.", nullptr);
 
-    const int device{avs_defined(avs_array_elt(args, Device)) ? avs_as_int(avs_array_elt(args, Device)) : -1};
     const int list_device{avs_defined(avs_array_elt(args, List_device)) ? avs_as_bool(avs_array_elt(args, List_device)) : 0};
 
-    if (list_device || device > -1)
-    {
-        std::vector<VkPhysicalDevice> devices{};
-        VkInstance inst{};
-
-        AVS_Value dev_info{devices_info(clip, fi->env, devices, inst, params->msg, "libplacebo_Tonemap", device, list_device)};
-        if (avs_is_error(dev_info) || avs_is_clip(dev_info))
-        {
-            fi->user_data = params.release();
-            fi->free_filter = free_tonemap;
-
-            return dev_info;
-        }
-
-        params->vf = avs_libplacebo_init(devices[device], params->msg);
-
-        vkDestroyInstance(inst, nullptr);
-    }
-    else
+    AVS_Value dev_init{
+        avs_libplacebo_init(clip, fi->env, avs_array_elt(args, Device), list_device, params->vf, params->msg, "libplacebo_Tonemap", 1)};
+    if (avs_is_error(dev_init) || avs_is_clip(dev_init))
     {
-        if (device < -1)
-            return set_error("libplacebo_Tonemap: device must be greater than or equal to -1.", nullptr);
+        fi->user_data = params.release();
+        fi->free_filter = free_tonemap;
 
-        params->vf = avs_libplacebo_init(nullptr, params->msg);
-    }
-
-    if (params->msg.size())
-    {
-        params->msg = "libplacebo_Tonemap: " + params->msg;
-        return set_error(params->msg.c_str(), nullptr);
+        return dev_init;
     }
 
     params->src_pl_csp = std::make_unique<pl_color_space>();
@@ -714,9 +1516,6 @@ AVS_Value AVSC_CC create_tonemap(AVS_ScriptEnvironment* env, AVS_Value args, voi
     }
     else
     {
-        if (params->src_csp == supported_colorspace::CSP_DOVI)
-            params->dovi_meta = std::make_unique<pl_dovi_metadata>();
-
         params->colorMapParams = std::make_unique<pl_color_map_params>(pl_color_map_default_params);
 
         // Tone mapping function
@@ -856,6 +1655,91 @@ AVS_Value AVSC_CC create_tonemap(AVS_ScriptEnvironment* env, AVS_Value args, voi
 
     params->render_params->plane_upscaler = cscaler;
 
+    params->tile = avs_defined(avs_array_elt(args, Tile)) ? avs_as_int(avs_array_elt(args, Tile)) : 0;
+    if (params->tile < 0)
+    {
+        if (lut_defined)
+            pl_lut_free(const_cast<pl_custom_lut**>(&params->render_params->lut));
+
+        return set_error("libplacebo_Tonemap: tile must be greater than or equal to 0.", params->vf);
+    }
+
+    // Chroma upscaling reads `radius` chroma pixels around every pixel, up to 4 luma pixels each.
+    params->halo = (static_cast<int>(std::ceil((cscaler->radius > 0.0f) ? cscaler->radius : cscaler->kernel->radius)) + 1) * 4;
+
+    if (avs_defined(avs_array_elt(args, Measure)) || avs_defined(avs_array_elt(args, Playback)))
+    {
+        const auto mode_error{[&](const std::string& msg) {
+            if (lut_defined)
+                pl_lut_free(const_cast<pl_custom_lut**>(&params->render_params->lut));
+
+            params->msg = "libplacebo_Tonemap: " + msg;
+            return set_error(params->msg.c_str(), params->vf);
+        }};
+
+        if (lut_defined)
+            return mode_error("measure/playback can't be used with lut.");
+        if (avs_defined(avs_array_elt(args, Measure)) && avs_defined(avs_array_elt(args, Playback)))
+            return mode_error("measure and playback can't be used together.");
+
+        if (avs_defined(avs_array_elt(args, Measure)))
+        {
+            if (!params->render_params->peak_detect_params)
+                return mode_error("measure requires dynamic_peak_detection=true.");
+            if (params->tile > 0)
+                return mode_error("measure can't be used with tile.");
+
+            // Raw per frame values, independent of the order of the frames.
+            params->peakDetectParams->smoothing_period = 0.0f;
+            params->peakDetectParams->scene_threshold_low = 0.0f;
+            params->peakDetectParams->scene_threshold_high = 0.0f;
+
+            params->measure_path = utf8_path(avs_as_string(avs_array_elt(args, Measure)));
+
+            // The file is written when the filter is destroyed, too late to report an error. Without truncating an existing file.
+            std::error_code ec;
+            const bool existed{std::filesystem::exists(params->measure_path, ec)};
+            if (!std::ofstream(params->measure_path, std::ios::app))
+                return mode_error("error opening file " + std::string(avs_as_string(avs_array_elt(args, Measure))) + " for writing (" +
+                                  std::strerror(errno) + ")");
+            if (!existed)
+                std::filesystem::remove(params->measure_path, ec);
+        }
+        else
+        {
+            std::string err;
+            if (!read_measurements(avs_as_string(avs_array_elt(args, Playback)), fi->vi.num_frames, params->playback, err))
+                return mode_error(err);
+
+            params->render_params->peak_detect_params = nullptr;
+        }
+    }
+
+    // ordered_peak: without a measurement/playback file the peak is detected per frame and smoothed in frame order, independent of the
+    // renderer that processes the frame.
+    if (params->render_params->peak_detect_params && params->measure_path.empty() && avs_defined(avs_array_elt(args, Ordered_peak)) &&
+        avs_as_bool(avs_array_elt(args, Ordered_peak)))
+    {
+        params->ordered_peak = 1;
+        // The windows of a few frames in flight (threads, seeking).
+        params->peak_max_frames = 2 * static_cast<size_t>(peak_window_frames(*params->peakDetectParams) + 1) + peak_extra_frames;
+        params->measure_params = std::make_unique<pl_peak_detect_params>(*params->peakDetectParams);
+        params->measure_params->smoothing_period = 0.0f;
+        params->measure_params->scene_threshold_low = 0.0f;
+        params->measure_params->scene_threshold_high = 0.0f;
+        params->render_params->peak_detect_params = nullptr;
+    }
+
+    params->stats = avs_defined(avs_array_elt(args, Stats)) ? avs_as_bool(avs_array_elt(args, Stats)) : 0;
+    if (params->stats)
+    {
+        // Created by the first job.
+        for (const auto& vf : params->vf)
+            vf->use_timer = 1;
+
+        params->render_params->info_callback = stats_render_info;
+    }
+
     if (srcIsRGB)
         params->is_subsampled = 0;
     else
@@ -928,6 +1812,122 @@ AVS_Value AVSC_CC create_tonemap(AVS_ScriptEnvironment* env, AVS_Value args, voi
         params->dst_repr->sys = PL_COLOR_SYSTEM_RGB;
     }
 
+    const int export_lut{avs_defined(avs_array_elt(args, Export_lut))};
+    if (export_lut || (avs_defined(avs_array_elt(args, Bake)) && avs_as_bool(avs_array_elt(args, Bake))))
+    {
+        if (lut_defined)
+        {
+            pl_lut_free(const_cast<pl_custom_lut**>(&params->render_params->lut));
+            return set_error("libplacebo_Tonemap: bake/export_lut can't be used with lut.", params->vf);
+        }
+        if (params->ordered_peak || params->render_params->peak_detect_params || !params->measure_path.empty() ||
+            !params->playback.empty())
+            return set_error(
+                "libplacebo_Tonemap: bake/export_lut requires dynamic_peak_detection=false and can't be used with measure/playback.",
+                params->vf);
+        if (params->src_csp == supported_colorspace::CSP_DOVI && params->use_dovi)
+            return set_error("libplacebo_Tonemap: bake/export_lut can't be used with Dolby Vision reshaping.", params->vf);
+
+        priv* vf{params->vf[0].get()};
+        if (!gpu_context(vf, params->msg))
+        {
+            params->msg = "libplacebo_Tonemap: " + params->msg;
+            return set_error(params->msg.c_str(), params->vf);
+        }
+
+        const int size{avs_defined(avs_array_elt(args, Bake_size)) ? avs_as_int(avs_array_elt(args, Bake_size)) : bake_default_size};
+        if (size < 2 || size > 256 || size * size > static_cast<int>(vf->gpu->limits.max_tex_2d_dim))
+            return set_error("libplacebo_Tonemap: bake_size must be between 2 and 256 (and its square within the texture size limit).",
+                params->vf);
+
+        // The HDR10 metadata (mastering display, content light level) is static, it's taken from the properties of the first frame like
+        // the frames without bake do.
+        avs_helpers::avs_video_frame_ptr first_ptr{g_avs_api->avs_get_frame(fi->child, 0)};
+        AVS_VideoFrame* first{first_ptr.get()};
+        if (!first)
+            return set_error("libplacebo_Tonemap: bake/export_lut failed getting the first frame.", params->vf);
+
+        tonemap_frame f{};
+        std::string info_err;
+        if (!tonemap_frame_info(params.get(), fi, first, {-1.0f, -1.0f}, f, info_err))
+        {
+            params->msg = "libplacebo_Tonemap: " + info_err;
+            return set_error(params->msg.c_str(), params->vf);
+        }
+
+        // Baked LUTs are cached by the hash of their key, later runs with the same parameters skip the baking.
+        const std::string key{bake_key(params.get(), size, f)};
+        std::filesystem::path cached{cache_dir()};
+        if (!cached.empty())
+        {
+            const uint64_t hash{fnv1a(reinterpret_cast<const uint8_t*>(key.data()), key.size())};
+            char name[40];
+            std::snprintf(name, sizeof(name), "tonemap_%016llx.cube", static_cast<unsigned long long>(hash));
+            cached /= name;
+        }
+
+        if (cached.empty() || !cube_load(vf->log, cached, key, size, params->baked_data))
+        {
+            // The same LUT serves all devices, the renderers upload it on first use.
+            std::string err;
+            std::vector<float> rgb;
+            if (!gpu_run(vf, 0, 0, [&](gpu_job*) { return !tonemap_bake(params.get(), vf, size, f, rgb); }, err) ||
+                !cube_parse(vf->log, cube_text(key, size, rgb), size, params->baked_data))
+            {
+                params->msg = "libplacebo_Tonemap: failed baking the LUT: " + err;
+                return set_error(params->msg.c_str(), params->vf);
+            }
+
+            // Only a cache, the next run bakes again if it can't be written.
+            if (!cached.empty())
+                write_file_atomic(cached, cube_text(key, size, params->baked_data));
+        }
+
+        if (export_lut && !write_file_atomic(utf8_path(avs_as_string(avs_array_elt(args, Export_lut))),
+                              cube_text(key, size, params->baked_data)))
+        {
+            params->msg = "libplacebo_Tonemap: error writing export_lut " + std::string(avs_as_string(avs_array_elt(args, Export_lut)));
+            return set_error(params->msg.c_str(), params->vf);
+        }
+
+        params->baked = std::make_unique<pl_custom_lut>();
+        params->baked->signature =
+            fnv1a(reinterpret_cast<const uint8_t*>(params->baked_data.data()), params->baked_data.size() * sizeof(float));
+        params->baked->size[0] = params->baked->size[1] = params->baked->size[2] = size;
+        params->baked->data = params->baked_data.data();
+        params->baked->repr_in = pl_color_repr_rgb;
+        params->baked->color_in = f.src_pl_csp;
+        params->baked->repr_out = pl_color_repr_rgb;
+        params->baked->color_out = f.dst_pl_csp;
+        pl_color_space_infer_map(&params->baked->color_in, &params->baked->color_out);
+    }
+
+    if (avs_defined(avs_array_elt(args, Warmup)) && avs_as_bool(avs_array_elt(args, Warmup)))
+    {
+        const AVS_VideoInfo* src_vi{g_avs_api->avs_get_video_info(fi->child)};
+        AVS_VideoFrame* src{g_avs_api->avs_new_video_frame_a(fi->env, src_vi, AVS_FRAME_ALIGN)};
+        AVS_VideoFrame* dst{g_avs_api->avs_new_video_frame_a(fi->env, &fi->vi, AVS_FRAME_ALIGN)};
+
+        tonemap_frame f{};
+        std::string err;
+        if (tonemap_frame_info(params.get(), fi, src, {-1.0f, -1.0f}, f, err))
+        {
+            // The blank frame mustn't seed the peak detection of the first real frame.
+            tonemap* d{params.get()};
+            params->warmup = gpu_warmup(params->vf, {src, dst}, [=](priv* vf, gpu_job* job) {
+                const bool ok{!tonemap_filter(dst, src, d, fi, vf, f, nullptr, job)};
+                pl_renderer_flush_cache(vf->rr);
+
+                return ok;
+            });
+        }
+        else
+        {
+            g_avs_api->avs_release_video_frame(src);
+            g_avs_api->avs_release_video_frame(dst);
+        }
+    }
+
     AVS_Value v;
     g_avs_api->avs_set_to_clip(&v, clip);
 
@@ -0,0 +1,1234 @@
+#include <algorithm>
+#include <array>
+#include <atomic>
+#include <cmath>
+#include <cstdio>
+#include <cstring>
+#include <deque>
+#include <map>
+#include <mutex>
+#include <stdexcept>
+#include <string_view>
+
+#ifdef _WIN32
+#include <windows.h>
+#else
+#include <dlfcn.h>
+#endif
+
+#include "avs_mock.h"
+
+namespace
+{
+    // Reported through avs_check_version/avs_get_env_property. The plugin requires interface 9 with bugfix 2 or later.
+    constexpr int interface_version{11};
+    constexpr int interface_bugfix{2};
+
+    struct prop_entry
+    {
+        char type; // 'i', 'f' or 'd'
+        std::vector<int64_t> ints;
+        std::vector<double> floats;
+        std::vector<std::string> data;
+    };
+
+    using prop_map = std::map<std::string, prop_entry, std::less<>>;
+
+    struct frame_plane
+    {
+        std::vector<BYTE> buffer;
+        BYTE* data;
+        int pitch;
+        int row_size;
+        int height;
+    };
+
+    struct mock_frame
+    {
+        std::atomic<long> refcount{1};
+        // Y/U/V/A or G/B/R/A.
+        std::array<frame_plane, 4> planes{};
+        prop_map props;
+    };
+
+    struct mock_clip
+    {
+        std::atomic<long> refcount{1};
+        AVS_VideoInfo vi{};
+        std::mutex error_mtx;
+        std::string error;
+
+        virtual ~mock_clip() = default;
+        virtual AVS_VideoFrame* get_frame(int n) = 0;
+
+        virtual int set_cache_hints(int cachehints, int frame_range)
+        {
+            return 0;
+        }
+    };
+
+    struct function_entry
+    {
+        std::string params;
+        AVS_ApplyFunc apply;
+        void* user_data;
+    };
+
+    struct mock_env
+    {
+        std::mutex mtx;
+        std::map<std::string, function_entry, std::less<>> functions;
+        std::deque<std::string> strings;
+        std::deque<std::vector<AVS_Value>> arrays;
+        std::vector<void*> libraries;
+    };
+
+    mock_env* to_env(AVS_ScriptEnvironment* env)
+    {
+        return reinterpret_cast<mock_env*>(env);
+    }
+
+    mock_clip* to_clip(AVS_Clip* clip)
+    {
+        return reinterpret_cast<mock_clip*>(clip);
+    }
+
+    AVS_Clip* to_avs(mock_clip* clip)
+    {
+        return reinterpret_cast<AVS_Clip*>(clip);
+    }
+
+    mock_frame* to_frame(const AVS_VideoFrame* frame)
+    {
+        return reinterpret_cast<mock_frame*>(const_cast<AVS_VideoFrame*>(frame));
+    }
+
+    AVS_VideoFrame* to_avs(mock_frame* frame)
+    {
+        return reinterpret_cast<AVS_VideoFrame*>(frame);
+    }
+
+    prop_map* to_props(const AVS_Map* map)
+    {
+        return reinterpret_cast<prop_map*>(const_cast<AVS_Map*>(map));
+    }
+
+    void release_frame(mock_frame* frame)
+    {
+        if (frame && --frame->refcount == 0)
+            delete frame;
+    }
+
+    void release_clip(mock_clip* clip)
+    {
+        if (clip && --clip->refcount == 0)
+            delete clip;
+    }
+
+    AVS_VideoFrame* clip_get_frame(mock_clip* clip, int n)
+    {
+        n = std::clamp(n, 0, std::max(clip->vi.num_frames - 1, 0));
+        return clip->get_frame(n);
+    }
+
+    //
+    // pixel_type decoding
+    //
+
+    bool is_y(const AVS_VideoInfo* vi)
+    {
+        return (vi->pixel_type & ~AVS_CS_SAMPLE_BITS_MASK) == (AVS_CS_Y8 & ~AVS_CS_SAMPLE_BITS_MASK);
+    }
+
+    bool has_alpha(const AVS_VideoInfo* vi)
+    {
+        if (avs_is_rgb(vi))
+            return (vi->pixel_type & ~AVS_CS_SAMPLE_BITS_MASK) == (AVS_CS_RGBAP & ~AVS_CS_SAMPLE_BITS_MASK);
+
+        return !!(vi->pixel_type & AVS_CS_YUVA);
+    }
+
+    int bits_per_component(const AVS_VideoInfo* vi)
+    {
+        switch (vi->pixel_type & AVS_CS_SAMPLE_BITS_MASK)
+        {
+        case AVS_CS_SAMPLE_BITS_10:
+            return 10;
+        case AVS_CS_SAMPLE_BITS_12:
+            return 12;
+        case AVS_CS_SAMPLE_BITS_14:
+            return 14;
+        case AVS_CS_SAMPLE_BITS_16:
+            return 16;
+        case AVS_CS_SAMPLE_BITS_32:
+            return 32;
+        default:
+            return 8;
+        }
+    }
+
+    int component_size(const AVS_VideoInfo* vi)
+    {
+        const int bits{bits_per_component(vi)};
+        return (bits == 8) ? 1 : ((bits == 32) ? 4 : 2);
+    }
+
+    int num_components(const AVS_VideoInfo* vi)
+    {
+        return is_y(vi) ? 1 : (has_alpha(vi) ? 4 : 3);
+    }
+
+    int subsampling_w(const AVS_VideoInfo* vi)
+    {
+        if (avs_is_rgb(vi) || is_y(vi))
+            return 0;
+
+        switch (vi->pixel_type & AVS_CS_SUB_WIDTH_MASK)
+        {
+        case AVS_CS_SUB_WIDTH_2:
+            return 1;
+        case AVS_CS_SUB_WIDTH_4:
+            return 2;
+        default:
+            return 0;
+        }
+    }
+
+    int subsampling_h(const AVS_VideoInfo* vi)
+    {
+        if (avs_is_rgb(vi) || is_y(vi))
+            return 0;
+
+        switch (vi->pixel_type & AVS_CS_SUB_HEIGHT_MASK)
+        {
+        case AVS_CS_SUB_HEIGHT_2:
+            return 1;
+        case AVS_CS_SUB_HEIGHT_4:
+            return 2;
+        default:
+            return 0;
+        }
+    }
+
+    int plane_slot(int plane)
+    {
+        switch (plane)
+        {
+        case AVS_PLANAR_U:
+        case AVS_PLANAR_B:
+            return 1;
+        case AVS_PLANAR_V:
+        case AVS_PLANAR_R:
+            return 2;
+        case AVS_PLANAR_A:
+            return 3;
+        default:
+            return 0;
+        }
+    }
+
+    bool is_chroma_slot(const AVS_VideoInfo* vi, int slot)
+    {
+        return !avs_is_rgb(vi) && (slot == 1 || slot == 2);
+    }
+
+    mock_frame* alloc_frame(const AVS_VideoInfo* vi)
+    {
+        mock_frame* frame{new mock_frame};
+        const int comp{component_size(vi)};
+
+        for (int slot{0}; slot < num_components(vi); ++slot)
+        {
+            const bool chroma{is_chroma_slot(vi, slot)};
+            frame_plane& p{frame->planes[slot]};
+            p.row_size = ((chroma) ? (vi->width >> subsampling_w(vi)) : vi->width) * comp;
+            p.height = (chroma) ? (vi->height >> subsampling_h(vi)) : vi->height;
+            p.pitch = (p.row_size + 63) & ~63;
+            p.buffer.resize(static_cast<size_t>(p.pitch) * p.height + 64);
+            p.data = p.buffer.data() + ((64 - reinterpret_cast<uintptr_t>(p.buffer.data()) % 64) % 64);
+        }
+
+        return frame;
+    }
+
+    //
+    // clips
+    //
+
+    struct filter_clip : mock_clip
+    {
+        AVS_FilterInfo fi{};
+
+        ~filter_clip() override
+        {
+            if (fi.free_filter)
+                fi.free_filter(&fi);
+            if (fi.child)
+                release_clip(to_clip(fi.child));
+        }
+
+        AVS_VideoFrame* get_frame(int n) override
+        {
+            if (!fi.get_frame)
+                return clip_get_frame(to_clip(fi.child), n);
+
+            AVS_VideoFrame* frame{fi.get_frame(&fi, n)};
+            if (!frame)
+            {
+                std::lock_guard<std::mutex> lck(error_mtx);
+                error = (fi.error) ? fi.error : "get_frame failed without an error message.";
+            }
+
+            return frame;
+        }
+
+        int set_cache_hints(int cachehints, int frame_range) override
+        {
+            return (fi.set_cache_hints) ? fi.set_cache_hints(&fi, cachehints, frame_range) : 0;
+        }
+    };
+
+    struct source_clip : mock_clip
+    {
+        std::vector<mock_frame*> frames;
+
+        ~source_clip() override
+        {
+            for (mock_frame* frame : frames)
+                release_frame(frame);
+        }
+
+        AVS_VideoFrame* get_frame(int n) override
+        {
+            mock_frame* frame{frames[n % frames.size()]};
+            ++frame->refcount;
+
+            return to_avs(frame);
+        }
+    };
+
+    struct callback_clip : mock_clip
+    {
+        std::function<AVS_VideoFrame*(int, std::string&)> callback;
+
+        AVS_VideoFrame* get_frame(int n) override
+        {
+            std::string err;
+            AVS_VideoFrame* frame{callback(n, err)};
+            if (!frame)
+            {
+                std::lock_guard<std::mutex> lck(error_mtx);
+                error = (err.empty()) ? "source frame isn't available." : err;
+            }
+
+            return frame;
+        }
+    };
+
+    // Gradient quantized to coarse steps (something for Deband to work on) plus a little noise.
+    void fill_plane(frame_plane& p, const AVS_VideoInfo* vi, bool chroma, uint32_t& state)
+    {
+        const int comp{component_size(vi)};
+        const int bits{bits_per_component(vi)};
+        const int w{p.row_size / comp};
+        const double peak{static_cast<double>((1 << std::min(bits, 16)) - 1)};
+
+        for (int y{0}; y < p.height; ++y)
+        {
+            BYTE* row{p.data + static_cast<size_t>(y) * p.pitch};
+
+            for (int x{0}; x < w; ++x)
+            {
+                state ^= state << 13;
+                state ^= state >> 17;
+                state ^= state << 5;
+
+                const double ramp{0.5 * (static_cast<double>(x) / w + static_cast<double>(y) / p.height)};
+                double v{std::floor(ramp * 48.0) / 48.0 + ((state & 0xFF) / 255.0 - 0.5) / 256.0};
+                v = std::clamp((chroma) ? (0.5 + (v - 0.5) * 0.25) : v, 0.0, 1.0);
+
+                if (comp == 4)
+                    reinterpret_cast<float*>(row)[x] = static_cast<float>((chroma) ? (v - 0.5) : v);
+                else if (comp == 2)
+                    reinterpret_cast<uint16_t*>(row)[x] = static_cast<uint16_t>(std::lround(v * peak));
+                else
+                    row[x] = static_cast<BYTE>(std::lround(v * peak));
+            }
+        }
+    }
+
+    //
+    // function calls
+    //
+
+    struct param_spec
+    {
+        std::string name;
+        char type;
+        bool array;
+    };
+
+    std::vector<param_spec> parse_params(std::string_view spec)
+    {
+        std::vector<param_spec> params;
+
+        for (size_t i{0}; i < spec.size();)
+        {
+            param_spec p{};
+
+            if (spec[i] == '[')
+            {
+                const size_t end{spec.find(']', i)};
+                p.name = spec.substr(i + 1, end - i - 1);
+                i = end + 1;
+            }
+
+            p.type = spec[i++];
+
+            if (i < spec.size() && (spec[i] == '*' || spec[i] == '+'))
+            {
+                p.array = true;
+                ++i;
+            }
+
+            params.emplace_back(std::move(p));
+        }
+
+        return params;
+    }
+
+    const char* save_string(mock_env* e, std::string_view s)
+    {
+        std::lock_guard<std::mutex> lck(e->mtx);
+        return e->strings.emplace_back(s).c_str();
+    }
+
+    AVS_Value parse_scalar(mock_env* e, char type, const std::string& s)
+    {
+        switch (type)
+        {
+        case 'i':
+            return avs_new_value_int(std::stoi(s));
+        case 'f':
+            return avs_new_value_float(std::stof(s));
+        case 'b':
+            if (s == "true" || s == "1")
+                return avs_new_value_bool(1);
+            if (s == "false" || s == "0")
+                return avs_new_value_bool(0);
+            throw std::invalid_argument("expected true/false");
+        case 's':
+            return avs_new_value_string(save_string(e, s));
+        default:
+            throw std::invalid_argument("unsupported parameter type");
+        }
+    }
+
+    AVS_Value parse_value(mock_env* e, const param_spec& p, const std::string& s)
+    {
+        if (!p.array)
+            return parse_scalar(e, p.type, s);
+
+        std::vector<AVS_Value> values;
+        for (size_t start{0};;)
+        {
+            const size_t end{s.find(',', start)};
+            values.emplace_back(parse_scalar(e, p.type, s.substr(start, end - start)));
+            if (end == std::string::npos)
+                break;
+            start = end + 1;
+        }
+
+        std::lock_guard<std::mutex> lck(e->mtx);
+        std::vector<AVS_Value>& stored{e->arrays.emplace_back(std::move(values))};
+
+        return avs_new_value_array(stored.data(), static_cast<int>(stored.size()));
+    }
+} // namespace
+
+//
+// AviSynth C API
+//
+
+extern "C"
+{
+    int AVSC_CC avs_check_version(AVS_ScriptEnvironment*, int version)
+    {
+        return version > interface_version;
+    }
+
+    size_t AVSC_CC avs_get_env_property(AVS_ScriptEnvironment*, int prop)
+    {
+        switch (prop)
+        {
+        case AVS_AEP_INTERFACE_VERSION:
+            return interface_version;
+        case AVS_AEP_INTERFACE_BUGFIX:
+            return interface_bugfix;
+        default:
+            return 0;
+        }
+    }
+
+    const char* AVSC_CC avs_get_error(AVS_ScriptEnvironment*)
+    {
+        return nullptr;
+    }
+
+    char* AVSC_CC avs_save_string(AVS_ScriptEnvironment* env, const char* s, int length)
+    {
+        return const_cast<char*>(save_string(to_env(env), (length < 0) ? std::string_view{s} : std::string_view{s, static_cast<size_t>(length)}));
+    }
+
+    void AVSC_CC avs_pool_free(AVS_ScriptEnvironment*, void*)
+    {
+    }
+
+    int AVSC_CC avs_add_function(AVS_ScriptEnvironment* env, const char* name, const char* params, AVS_ApplyFunc apply, void* user_data)
+    {
+        mock_env* e{to_env(env)};
+        std::lock_guard<std::mutex> lck(e->mtx);
+        e->functions[name] = function_entry{params, apply, user_data};
+
+        return 0;
+    }
+
+    int AVSC_CC avs_function_exists(AVS_ScriptEnvironment* env, const char* name)
+    {
+        mock_env* e{to_env(env)};
+        std::lock_guard<std::mutex> lck(e->mtx);
+
+        return e->functions.contains(name);
+    }
+
+    AVS_Value AVSC_CC avs_invoke(AVS_ScriptEnvironment* env, const char* name, AVS_Value args, const char**)
+    {
+        mock_env* e{to_env(env)};
+        function_entry f{};
+        {
+            std::lock_guard<std::mutex> lck(e->mtx);
+            const auto itr{e->functions.find(name)};
+            if (itr == e->functions.end())
+                return avs_new_value_error(save_string(e, std::string("avs_mock: function ") + name + " is not available."));
+            f = itr->second;
+        }
+
+        return f.apply(env, args, f.user_data);
+    }
+
+    void AVSC_CC avs_bit_blt(AVS_ScriptEnvironment*, BYTE* dstp, int dst_pitch, const BYTE* srcp, int src_pitch, int row_size, int height)
+    {
+        for (int y{0}; y < height; ++y)
+            std::memcpy(dstp + static_cast<ptrdiff_t>(y) * dst_pitch, srcp + static_cast<ptrdiff_t>(y) * src_pitch, row_size);
+    }
+
+    //
+    // clips and values
+    //
+
+    AVS_Clip* AVSC_CC avs_new_c_filter(AVS_ScriptEnvironment* env, AVS_FilterInfo** fi, AVS_Value child, int store_child)
+    {
+        filter_clip* clip{new filter_clip};
+        clip->fi.env = env;
+
+        if (avs_is_clip(child))
+        {
+            mock_clip* c{reinterpret_cast<mock_clip*>(child.d.clip)};
+            clip->fi.vi = c->vi;
+
+            if (store_child)
+            {
+                ++c->refcount;
+                clip->fi.child = to_avs(c);
+            }
+        }
+
+        clip->vi = clip->fi.vi;
+        *fi = &clip->fi;
+
+        return to_avs(clip);
+    }
+
+    AVS_Clip* AVSC_CC avs_take_clip(AVS_Value v, AVS_ScriptEnvironment*)
+    {
+        mock_clip* clip{reinterpret_cast<mock_clip*>(v.d.clip)};
+        ++clip->refcount;
+
+        return to_avs(clip);
+    }
+
+    void AVSC_CC avs_set_to_clip(AVS_Value* v, AVS_Clip* clip)
+    {
+        ++to_clip(clip)->refcount;
+        v->type = 'c';
+        v->array_size = 0;
+        v->d.clip = clip;
+    }
+
+    void AVSC_CC avs_copy_value(AVS_Value* dest, AVS_Value src)
+    {
+        if (avs_is_clip(src))
+            ++reinterpret_cast<mock_clip*>(src.d.clip)->refcount;
+
+        *dest = src;
+    }
+
+    void AVSC_CC avs_release_value(AVS_Value v)
+    {
+        if (avs_is_clip(v))
+            release_clip(reinterpret_cast<mock_clip*>(v.d.clip));
+    }
+
+    AVS_Clip* AVSC_CC avs_copy_clip(AVS_Clip* clip)
+    {
+        ++to_clip(clip)->refcount;
+        return clip;
+    }
+
+    void AVSC_CC avs_release_clip(AVS_Clip* clip)
+    {
+        release_clip(to_clip(clip));
+    }
+
+    const char* AVSC_CC avs_clip_get_error(AVS_Clip* clip)
+    {
+        mock_clip* c{to_clip(clip)};
+        std::lock_guard<std::mutex> lck(c->error_mtx);
+
+        return (c->error.empty()) ? nullptr : c->error.c_str();
+    }
+
+    const AVS_VideoInfo* AVSC_CC avs_get_video_info(AVS_Clip* clip)
+    {
+        // Filters may change their output format after avs_new_c_filter.
+        if (filter_clip* f{dynamic_cast<filter_clip*>(to_clip(clip))})
+            f->vi = f->fi.vi;
+
+        return &to_clip(clip)->vi;
+    }
+
+    AVS_VideoFrame* AVSC_CC avs_get_frame(AVS_Clip* clip, int n)
+    {
+        return clip_get_frame(to_clip(clip), n);
+    }
+
+    int AVSC_CC avs_set_cache_hints(AVS_Clip* clip, int cachehints, int frame_range)
+    {
+        return to_clip(clip)->set_cache_hints(cachehints, frame_range);
+    }
+
+    //
+    // frames
+    //
+
+    AVS_VideoFrame* AVSC_CC avs_new_video_frame_a(AVS_ScriptEnvironment*, const AVS_VideoInfo* vi, int)
+    {
+        return to_avs(alloc_frame(vi));
+    }
+
+    AVS_VideoFrame* AVSC_CC avs_new_video_frame_p(AVS_ScriptEnvironment*, const AVS_VideoInfo* vi, const AVS_VideoFrame* prop_src)
+    {
+        mock_frame* frame{alloc_frame(vi)};
+        if (prop_src)
+            frame->props = to_frame(prop_src)->props;
+
+        return to_avs(frame);
+    }
+
+    AVS_VideoFrame* AVSC_CC avs_copy_video_frame(AVS_VideoFrame* frame)
+    {
+        ++to_frame(frame)->refcount;
+        return frame;
+    }
+
+    void AVSC_CC avs_release_video_frame(AVS_VideoFrame* frame)
+    {
+        release_frame(to_frame(frame));
+    }
+
+    int AVSC_CC avs_get_pitch_p(const AVS_VideoFrame* p, int plane)
+    {
+        return to_frame(p)->planes[plane_slot(plane)].pitch;
+    }
+
+    int AVSC_CC avs_get_row_size_p(const AVS_VideoFrame* p, int plane)
+    {
+        return to_frame(p)->planes[plane_slot(plane)].row_size;
+    }
+
+    int AVSC_CC avs_get_height_p(const AVS_VideoFrame* p, int plane)
+    {
+        return to_frame(p)->planes[plane_slot(plane)].height;
+    }
+
+    const BYTE* AVSC_CC avs_get_read_ptr_p(const AVS_VideoFrame* p, int plane)
+    {
+        return to_frame(p)->planes[plane_slot(plane)].data;
+    }
+
+    BYTE* AVSC_CC avs_get_write_ptr_p(const AVS_VideoFrame* p, int plane)
+    {
+        return to_frame(p)->planes[plane_slot(plane)].data;
+    }
+
+    int AVSC_CC avs_is_writable(const AVS_VideoFrame* p)
+    {
+        return to_frame(p)->refcount == 1;
+    }
+
+    //
+    // video info
+    //
+
+    int AVSC_CC avs_num_components(const AVS_VideoInfo* p)
+    {
+        return num_components(p);
+    }
+
+    int AVSC_CC avs_component_size(const AVS_VideoInfo* p)
+    {
+        return component_size(p);
+    }
+
+    int AVSC_CC avs_bits_per_component(const AVS_VideoInfo* p)
+    {
+        return bits_per_component(p);
+    }
+
+    int AVSC_CC avs_is_y(const AVS_VideoInfo* p)
+    {
+        return is_y(p);
+    }
+
+    int AVSC_CC avs_is_420(const AVS_VideoInfo* p)
+    {
+        return avs_is_planar(p) && !avs_is_rgb(p) && !is_y(p) && subsampling_w(p) == 1 && subsampling_h(p) == 1;
+    }
+
+    int AVSC_CC avs_is_422(const AVS_VideoInfo* p)
+    {
+        return avs_is_planar(p) && !avs_is_rgb(p) && !is_y(p) && subsampling_w(p) == 1 && subsampling_h(p) == 0;
+    }
+
+    int AVSC_CC avs_is_444(const AVS_VideoInfo* p)
+    {
+        return avs_is_planar(p) && !avs_is_rgb(p) && !is_y(p) && subsampling_w(p) == 0 && subsampling_h(p) == 0;
+    }
+
+    int AVSC_CC avs_get_plane_width_subsampling(const AVS_VideoInfo* p, int plane)
+    {
+        return is_chroma_slot(p, plane_slot(plane)) ? subsampling_w(p) : 0;
+    }
+
+    int AVSC_CC avs_get_plane_height_subsampling(const AVS_VideoInfo* p, int plane)
+    {
+        return is_chroma_slot(p, plane_slot(plane)) ? subsampling_h(p) : 0;
+    }
+
+    //
+    // frame properties
+    //
+
+    const AVS_Map* AVSC_CC avs_get_frame_props_ro(AVS_ScriptEnvironment*, const AVS_VideoFrame* frame)
+    {
+        return reinterpret_cast<const AVS_Map*>(&to_frame(frame)->props);
+    }
+
+    AVS_Map* AVSC_CC avs_get_frame_props_rw(AVS_ScriptEnvironment*, AVS_VideoFrame* frame)
+    {
+        return reinterpret_cast<AVS_Map*>(&to_frame(frame)->props);
+    }
+
+    int AVSC_CC avs_prop_num_elements(AVS_ScriptEnvironment*, const AVS_Map* map, const char* key)
+    {
+        const prop_map* m{to_props(map)};
+        const auto itr{m->find(key)};
+        if (itr == m->end())
+            return -1;
+
+        const prop_entry& p{itr->second};
+        return static_cast<int>((p.type == 'i') ? p.ints.size() : ((p.type == 'f') ? p.floats.size() : p.data.size()));
+    }
+
+    int AVSC_CC avs_prop_delete_key(AVS_ScriptEnvironment*, AVS_Map* map, const char* key)
+    {
+        prop_map* m{to_props(map)};
+        const auto itr{m->find(key)};
+        if (itr == m->end())
+            return 0;
+
+        m->erase(itr);
+        return 1;
+    }
+
+    int64_t AVSC_CC avs_prop_get_int(AVS_ScriptEnvironment*, const AVS_Map* map, const char* key, int index, int* error)
+    {
+        const prop_map* m{to_props(map)};
+        const auto itr{m->find(key)};
+        int err{AVS_GETPROPERROR_UNSET};
+        int64_t ret{0};
+
+        if (itr != m->end())
+        {
+            if (itr->second.type != 'i')
+                err = AVS_GETPROPERROR_TYPE;
+            else if (index < 0 || index >= static_cast<int>(itr->second.ints.size()))
+                err = AVS_GETPROPERROR_INDEX;
+            else
+            {
+                err = 0;
+                ret = itr->second.ints[index];
+            }
+        }
+
+        if (error)
+            *error = err;
+
+        return ret;
+    }
+
+    double AVSC_CC avs_prop_get_float(AVS_ScriptEnvironment*, const AVS_Map* map, const char* key, int index, int* error)
+    {
+        const prop_map* m{to_props(map)};
+        const auto itr{m->find(key)};
+        int err{AVS_GETPROPERROR_UNSET};
+        double ret{0.0};
+
+        if (itr != m->end())
+        {
+            if (itr->second.type != 'f')
+                err = AVS_GETPROPERROR_TYPE;
+            else if (index < 0 || index >= static_cast<int>(itr->second.floats.size()))
+                err = AVS_GETPROPERROR_INDEX;
+            else
+            {
+                err = 0;
+                ret = itr->second.floats[index];
+            }
+        }
+
+        if (error)
+            *error = err;
+
+        return ret;
+    }
+
+    const double* AVSC_CC avs_prop_get_float_array(AVS_ScriptEnvironment*, const AVS_Map* map, const char* key, int* error)
+    {
+        const prop_map* m{to_props(map)};
+        const auto itr{m->find(key)};
+        const bool ok{itr != m->end() && itr->second.type == 'f'};
+
+        if (error)
+            *error = (ok) ? 0 : ((itr == m->end()) ? AVS_GETPROPERROR_UNSET : AVS_GETPROPERROR_TYPE);
+
+        return (ok) ? itr->second.floats.data() : nullptr;
+    }
+
+    const char* AVSC_CC avs_prop_get_data(AVS_ScriptEnvironment*, const AVS_Map* map, const char* key, int index, int* error)
+    {
+        const prop_map* m{to_props(map)};
+        const auto itr{m->find(key)};
+        const bool ok{itr != m->end() && itr->second.type == 'd' && index >= 0 && index < static_cast<int>(itr->second.data.size())};
+
+        if (error)
+            *error = (ok) ? 0 : ((itr == m->end()) ? AVS_GETPROPERROR_UNSET : AVS_GETPROPERROR_TYPE);
+
+        return (ok) ? itr->second.data[index].data() : nullptr;
+    }
+
+    int AVSC_CC avs_prop_get_data_size(AVS_ScriptEnvironment*, const AVS_Map* map, const char* key, int index, int* error)
+    {
+        const prop_map* m{to_props(map)};
+        const auto itr{m->find(key)};
+        const bool ok{itr != m->end() && itr->second.type == 'd' && index >= 0 && index < static_cast<int>(itr->second.data.size())};
+
+        if (error)
+            *error = (ok) ? 0 : ((itr == m->end()) ? AVS_GETPROPERROR_UNSET : AVS_GETPROPERROR_TYPE);
+
+        return (ok) ? static_cast<int>(itr->second.data[index].size()) : -1;
+    }
+
+    int AVSC_CC avs_prop_set_int(AVS_ScriptEnvironment*, AVS_Map* map, const char* key, int64_t i, int append)
+    {
+        prop_entry& p{(*to_props(map))[key]};
+        if (append != AVS_PROPAPPENDMODE_APPEND || p.type != 'i')
+            p = prop_entry{'i'};
+
+        p.ints.emplace_back(i);
+        return 0;
+    }
+
+    int AVSC_CC avs_prop_set_float(AVS_ScriptEnvironment*, AVS_Map* map, const char* key, double d, int append)
+    {
+        prop_entry& p{(*to_props(map))[key]};
+        if (append != AVS_PROPAPPENDMODE_APPEND || p.type != 'f')
+            p = prop_entry{'f'};
+
+        p.floats.emplace_back(d);
+        return 0;
+    }
+
+    int AVSC_CC avs_prop_set_float_array(AVS_ScriptEnvironment*, AVS_Map* map, const char* key, const double* d, int size)
+    {
+        prop_entry& p{(*to_props(map))[key]};
+        p = prop_entry{'f'};
+        p.floats.assign(d, d + size);
+
+        return 0;
+    }
+
+    int AVSC_CC avs_prop_set_data(AVS_ScriptEnvironment*, AVS_Map* map, const char* key, const char* d, int length, int append)
+    {
+        prop_entry& p{(*to_props(map))[key]};
+        if (append != AVS_PROPAPPENDMODE_APPEND || p.type != 'd')
+            p = prop_entry{'d'};
+
+        p.data.emplace_back(d, (length < 0) ? std::strlen(d) : static_cast<size_t>(length));
+        return 0;
+    }
+}
+
+//
+// host side
+//
+
+namespace avs_mock
+{
+    AVS_ScriptEnvironment* create_env()
+    {
+        return reinterpret_cast<AVS_ScriptEnvironment*>(new mock_env);
+    }
+
+    void destroy_env(AVS_ScriptEnvironment* env)
+    {
+        mock_env* e{to_env(env)};
+
+        for (void* lib : e->libraries)
+#ifdef _WIN32
+            FreeLibrary(reinterpret_cast<HMODULE>(lib));
+#else
+            dlclose(lib);
+#endif
+
+        delete e;
+    }
+
+    bool load_plugin(AVS_ScriptEnvironment* env, const std::string& path, std::string& err)
+    {
+        using init_func = const char*(AVSC_CC*)(AVS_ScriptEnvironment*);
+
+#ifdef _WIN32
+        HMODULE lib{LoadLibraryA(path.c_str())};
+        if (!lib)
+        {
+            err = "cannot load " + path;
+            return false;
+        }
+
+        const init_func init{reinterpret_cast<init_func>(GetProcAddress(lib, "avisynth_c_plugin_init"))};
+#else
+        void* lib{dlopen(path.c_str(), RTLD_NOW | RTLD_LOCAL)};
+        if (!lib)
+        {
+            err = dlerror();
+            return false;
+        }
+
+        const init_func init{reinterpret_cast<init_func>(dlsym(lib, "avisynth_c_plugin_init"))};
+#endif
+        mock_env* e{to_env(env)};
+        e->libraries.emplace_back(reinterpret_cast<void*>(lib));
+
+        if (!init)
+        {
+            err = path + " is not an AviSynth C plugin.";
+            return false;
+        }
+
+        size_t num_functions{};
+        {
+            std::lock_guard<std::mutex> lck(e->mtx);
+            num_functions = e->functions.size();
+        }
+
+        const char* ret{init(env)};
+
+        std::lock_guard<std::mutex> lck(e->mtx);
+        if (e->functions.size() == num_functions)
+        {
+            err = (ret) ? ret : "the plugin didn't register any function.";
+            return false;
+        }
+
+        return true;
+    }
+
+    AVS_Value invoke(AVS_ScriptEnvironment* env, const std::string& name, AVS_Clip* clip, const std::vector<named_arg>& args)
+    {
+        mock_env* e{to_env(env)};
+        std::string spec;
+        {
+            std::lock_guard<std::mutex> lck(e->mtx);
+            const auto itr{e->functions.find(name)};
+            if (itr == e->functions.end())
+                return avs_new_value_error(save_string(e, "avs_mock: function " + name + " is not registered."));
+            spec = itr->second.params;
+        }
+
+        const std::vector<param_spec> params{parse_params(spec)};
+        std::vector<AVS_Value> values(params.size(), avs_void);
+        size_t next_unnamed{0};
+
+        for (size_t i{0}; i < params.size(); ++i)
+        {
+            if (params[i].type == 'c' && params[i].name.empty())
+            {
+                values[i].type = 'c';
+                values[i].d.clip = clip;
+                next_unnamed = i + 1;
+                break;
+            }
+        }
+
+        for (const auto& [key, value] : args)
+        {
+            size_t idx{params.size()};
+
+            if (key.empty())
+            {
+                while (next_unnamed < params.size() && !params[next_unnamed].name.empty())
+                    ++next_unnamed;
+                idx = next_unnamed++;
+            }
+            else
+            {
+                for (size_t i{0}; i < params.size(); ++i)
+                {
+                    if (params[i].name == key)
+                    {
+                        idx = i;
+                        break;
+                    }
+                }
+            }
+
+            if (idx >= params.size())
+                return avs_new_value_error(save_string(e, "avs_mock: " + name + " has no parameter " + ((key.empty()) ? value : key) + "."));
+
+            try
+            {
+                values[idx] = parse_value(e, params[idx], value);
+            }
+            catch (const std::exception&)
+            {
+                return avs_new_value_error(save_string(e, "avs_mock: invalid value " + value + " for " + name + "." + key + "."));
+            }
+        }
+
+        return avs_invoke(env, name.c_str(), avs_new_value_array(values.data(), static_cast<int>(values.size())), nullptr);
+    }
+
+    AVS_Clip* new_source_clip(AVS_ScriptEnvironment* env, const AVS_VideoInfo& vi, int num_distinct, uint32_t seed)
+    {
+        source_clip* clip{new source_clip};
+        clip->vi = vi;
+
+        uint32_t state{(seed) ? seed : 0x9E3779B9u};
+
+        for (int i{0}; i < std::max(num_distinct, 1); ++i)
+        {
+            mock_frame* frame{alloc_frame(&vi)};
+
+            for (int slot{0}; slot < num_components(&vi); ++slot)
+                fill_plane(frame->planes[slot], &vi, is_chroma_slot(&vi, slot), state);
+
+            AVS_Map* props{reinterpret_cast<AVS_Map*>(&frame->props)};
+            avs_prop_set_int(env, props, "_ColorRange", (avs_is_rgb(&vi)) ? 0 : 1, 0);
+            if (subsampling_w(&vi))
+                avs_prop_set_int(env, props, "_ChromaLocation", 0, 0);
+
+            clip->frames.emplace_back(frame);
+        }
+
+        return to_avs(clip);
+    }
+
+    AVS_Clip* take_clip(AVS_ScriptEnvironment* env, AVS_Value v)
+    {
+        return avs_take_clip(v, env);
+    }
+
+    void release_value(AVS_Value v)
+    {
+        avs_release_value(v);
+    }
+
+    void release_clip(AVS_Clip* clip)
+    {
+        avs_release_clip(clip);
+    }
+
+    const AVS_VideoInfo* video_info(AVS_Clip* clip)
+    {
+        return avs_get_video_info(clip);
+    }
+
+    AVS_VideoFrame* get_frame(AVS_Clip* clip, int n)
+    {
+        return avs_get_frame(clip, n);
+    }
+
+    void release_frame(AVS_VideoFrame* frame)
+    {
+        avs_release_video_frame(frame);
+    }
+
+    AVS_VideoFrame* copy_frame(AVS_VideoFrame* frame)
+    {
+        return avs_copy_video_frame(frame);
+    }
+
+    int set_cache_hints(AVS_Clip* clip, int cachehints, int frame_range)
+    {
+        return avs_set_cache_hints(clip, cachehints, frame_range);
+    }
+
+    const char* clip_error(AVS_Clip* clip)
+    {
+        return avs_clip_get_error(clip);
+    }
+
+    int64_t prop_int(AVS_ScriptEnvironment* env, AVS_VideoFrame* frame, const char* key, int64_t def)
+    {
+        int err{0};
+        const int64_t v{avs_prop_get_int(env, avs_get_frame_props_ro(env, frame), key, 0, &err)};
+
+        return (err) ? def : v;
+    }
+
+    AVS_Clip* new_callback_clip(const AVS_VideoInfo& vi, std::function<AVS_VideoFrame*(int n, std::string& err)> get_frame)
+    {
+        callback_clip* clip{new callback_clip};
+        clip->vi = vi;
+        clip->callback = std::move(get_frame);
+
+        return to_avs(clip);
+    }
+
+    AVS_VideoFrame* new_frame(const AVS_VideoInfo& vi)
+    {
+        return to_avs(alloc_frame(&vi));
+    }
+
+    plane_view plane(AVS_VideoFrame* frame, int plane)
+    {
+        frame_plane& p{to_frame(frame)->planes[plane_slot(plane)]};
+
+        return {(p.buffer.empty()) ? nullptr : p.data, p.pitch, p.row_size, p.height};
+    }
+
+    void set_prop_int(AVS_VideoFrame* frame, const std::string& key, int64_t value)
+    {
+        prop_entry& e{to_frame(frame)->props[key]};
+        e = prop_entry{'i', {value}, {}, {}};
+    }
+
+    void set_prop_float(AVS_VideoFrame* frame, const std::string& key, const std::vector<double>& values)
+    {
+        prop_entry& e{to_frame(frame)->props[key]};
+        e = prop_entry{'f', {}, values, {}};
+    }
+
+    void set_prop_data(AVS_VideoFrame* frame, const std::string& key, const std::string& data)
+    {
+        prop_entry& e{to_frame(frame)->props[key]};
+        e = prop_entry{'d', {}, {}, {data}};
+    }
+
+    std::vector<named_arg> props_text(AVS_VideoFrame* frame)
+    {
+        std::vector<named_arg> out;
+
+        for (const auto& [key, e] : to_frame(frame)->props)
+        {
+            if (e.type == 'd')
+                continue;
+
+            std::string values;
+            const size_t size{(e.type == 'i') ? e.ints.size() : e.floats.size()};
+            for (size_t i{0}; i < size; ++i)
+            {
+                if (i)
+                    values += ',';
+
+                if (e.type == 'i')
+                    values += std::to_string(e.ints[i]);
+                else
+                {
+                    char buf[32];
+                    std::snprintf(buf, sizeof(buf), "%.17g", e.floats[i]);
+                    values += buf;
+                }
+            }
+
+            out.emplace_back(key, values);
+        }
+
+        return out;
+    }
+
+    int bits(const AVS_VideoInfo& vi)
+    {
+        return bits_per_component(&vi);
+    }
+
+    std::string format(const AVS_VideoInfo& vi)
+    {
+        if (avs_is_rgb(&vi))
+            return "rgb";
+        if (is_y(&vi))
+            return "y";
+        if (subsampling_h(&vi))
+            return "420";
+
+        return (subsampling_w(&vi)) ? "422" : "444";
+    }
+
+    int pixel_type(int bits, const std::string& format)
+    {
+        const int idx{(bits == 8) ? 0 : ((bits == 16) ? 1 : ((bits == 32) ? 2 : -1))};
+        if (idx < 0)
+            return 0;
+
+        constexpr int yuv420[3]{AVS_CS_YV12, AVS_CS_YUV420P16, AVS_CS_YUV420PS};
+        constexpr int yuv422[3]{AVS_CS_YV16, AVS_CS_YUV422P16, AVS_CS_YUV422PS};
+        constexpr int yuv444[3]{AVS_CS_YV24, AVS_CS_YUV444P16, AVS_CS_YUV444PS};
+        constexpr int rgb[3]{AVS_CS_RGBP, AVS_CS_RGBP16, AVS_CS_RGBPS};
+        constexpr int y[3]{AVS_CS_Y8, AVS_CS_Y16, AVS_CS_Y32};
+
+        if (format == "420")
+            return yuv420[idx];
+        if (format == "422")
+            return yuv422[idx];
+        if (format == "444")
+            return yuv444[idx];
+        if (format == "rgb")
+            return rgb[idx];
+        if (format == "y")
+            return y[idx];
+
+        return 0;
+    }
+
+    uint64_t frame_bytes(const AVS_VideoInfo& vi)
+    {
+        const uint64_t luma{static_cast<uint64_t>(vi.width) * vi.height * component_size(&vi)};
+        if (is_y(&vi))
+            return luma;
+
+        const uint64_t chroma{static_cast<uint64_t>(vi.width >> subsampling_w(&vi)) * (vi.height >> subsampling_h(&vi)) * component_size(&vi)};
+
+        return luma + 2 * chroma + ((has_alpha(&vi)) ? luma : 0);
+    }
+} // namespace avs_mock
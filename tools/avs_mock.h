@@ -0,0 +1,76 @@
+#pragma once
+
+#include <cstdint>
+#include <functional>
+#include <string>
+#include <utility>
+#include <vector>
+
+#include <avisynth_c.h>
+
+// Minimal stand-in for the AviSynth+ C API.
+// It's built as the `avisynth` shared library so avs_c_api_loader resolves the API from it instead of a real AviSynth+.
+// Only what the plugin and the tools need is implemented: planar frames, frame properties, C filters and function calls.
+namespace avs_mock
+{
+    // Unnamed arguments (empty key) fill the unnamed parameters that follow the clip, in order.
+    // Array parameters take comma separated values.
+    using named_arg = std::pair<std::string, std::string>;
+
+    AVS_ScriptEnvironment* create_env();
+    void destroy_env(AVS_ScriptEnvironment* env);
+
+    // Loads an AviSynth C plugin and runs avisynth_c_plugin_init. The library stays loaded until destroy_env.
+    bool load_plugin(AVS_ScriptEnvironment* env, const std::string& path, std::string& err);
+
+    // Calls a function registered by a plugin. The returned value owns its clip (avs_release_value).
+    AVS_Value invoke(AVS_ScriptEnvironment* env, const std::string& name, AVS_Clip* clip, const std::vector<named_arg>& args);
+
+    // Clip that cycles through `num_distinct` generated frames (gradients with fine steps and noise).
+    AVS_Clip* new_source_clip(AVS_ScriptEnvironment* env, const AVS_VideoInfo& vi, int num_distinct, uint32_t seed);
+
+    // Host access to clips and frames, the API symbols aren't declared for the tools when avisynth_c.h is used dynamically.
+    AVS_Clip* take_clip(AVS_ScriptEnvironment* env, AVS_Value v);
+    void release_value(AVS_Value v);
+    void release_clip(AVS_Clip* clip);
+    const AVS_VideoInfo* video_info(AVS_Clip* clip);
+    AVS_VideoFrame* get_frame(AVS_Clip* clip, int n);
+    void release_frame(AVS_VideoFrame* frame);
+    // New reference to the same frame.
+    AVS_VideoFrame* copy_frame(AVS_VideoFrame* frame);
+    int set_cache_hints(AVS_Clip* clip, int cachehints, int frame_range);
+    // nullptr when the last get_frame didn't fail.
+    const char* clip_error(AVS_Clip* clip);
+    // `def` when the property is missing.
+    int64_t prop_int(AVS_ScriptEnvironment* env, AVS_VideoFrame* frame, const char* key, int64_t def);
+
+    // Clip whose frames come from the host. The callback returns a new reference (or nullptr with clip_error set to `err`).
+    AVS_Clip* new_callback_clip(const AVS_VideoInfo& vi, std::function<AVS_VideoFrame*(int n, std::string& err)> get_frame);
+    AVS_VideoFrame* new_frame(const AVS_VideoInfo& vi);
+
+    struct plane_view
+    {
+        BYTE* data;
+        int pitch;
+        int row_size;
+        int height;
+    };
+
+    // AVS_PLANAR_* plane of a frame. data is nullptr if the frame doesn't have the plane.
+    plane_view plane(AVS_VideoFrame* frame, int plane);
+
+    void set_prop_int(AVS_VideoFrame* frame, const std::string& key, int64_t value);
+    void set_prop_float(AVS_VideoFrame* frame, const std::string& key, const std::vector<double>& values);
+    void set_prop_data(AVS_VideoFrame* frame, const std::string& key, const std::string& data);
+    // Int and float properties as `key` and comma separated values, data properties are skipped.
+    std::vector<named_arg> props_text(AVS_VideoFrame* frame);
+
+    // Inverse of pixel_type.
+    int bits(const AVS_VideoInfo& vi);
+    std::string format(const AVS_VideoInfo& vi);
+
+    // Builds a planar pixel type. format: 420, 422, 444, rgb or y.
+    int pixel_type(int bits, const std::string& format);
+    // Sum of the visible bytes of all planes.
+    uint64_t frame_bytes(const AVS_VideoInfo& vi);
+} // namespace avs_mock
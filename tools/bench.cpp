@@ -0,0 +1,304 @@
+#include <chrono>
+#include <fstream>
+#include <iostream>
+#include <map>
+#include <regex>
+#include <sstream>
+#include <string>
+#include <vector>
+
+#include "tool_common.h"
+
+namespace
+{
+    struct options : tools::filter_options
+    {
+        std::vector<std::string> filters{"deband", "resample", "shader", "tonemap"};
+        int frames{200};
+        int warmup{10};
+        std::string output;
+        std::string baseline;
+        double tolerance{0.05};
+    };
+
+    struct result
+    {
+        std::string filter;
+        std::string error;
+        int frames;
+        double seconds;
+        double fps;
+        double gpu_ms;
+        double upload_mib_s;
+        double download_mib_s;
+        double baseline_fps;
+        bool regression;
+    };
+
+    void usage()
+    {
+        std::cerr << "usage: avs_libplacebo_bench [options]\n"
+                  << tools::filter_usage
+                  << "  --filter <list>          comma separated: deband, resample, shader, tonemap (default: all)\n"
+                     "  --frames <n>             measured frames (default: 200)\n"
+                     "  --warmup <n>             frames requested before measuring (default: 10)\n"
+                     "  --output <path>          write the JSON report to a file instead of stdout\n"
+                     "  --baseline <path>        compare fps against a previous report\n"
+                     "  --tolerance <x>          allowed relative fps drop against the baseline (default: 0.05)\n";
+    }
+
+    bool parse_options(int argc, char** argv, options& o)
+    {
+        for (int i{1}; i < argc; ++i)
+        {
+            const std::string opt{argv[i]};
+            if (opt == "-h" || opt == "--help")
+                return false;
+            if (i + 1 >= argc)
+            {
+                std::cerr << "missing value for " << opt << "\n";
+                return false;
+            }
+
+            const std::string val{argv[++i]};
+
+            try
+            {
+                if (tools::parse_filter_option(opt, val, o))
+                    continue;
+
+                if (opt == "--filter")
+                    o.filters = tools::split(val, ',');
+                else if (opt == "--frames")
+                    o.frames = std::stoi(val);
+                else if (opt == "--warmup")
+                    o.warmup = std::stoi(val);
+                else if (opt == "--output")
+                    o.output = val;
+                else if (opt == "--baseline")
+                    o.baseline = val;
+                else if (opt == "--tolerance")
+                    o.tolerance = std::stod(val);
+                else
+                {
+                    std::cerr << "unknown option " << opt << "\n";
+                    return false;
+                }
+            }
+            catch (const std::exception&)
+            {
+                std::cerr << "invalid value " << val << " for " << opt << "\n";
+                return false;
+            }
+        }
+
+        if (o.frames < 1 || o.warmup < 0 || !tools::valid_source(o))
+        {
+            std::cerr << "invalid source configuration\n";
+            return false;
+        }
+
+        return true;
+    }
+
+    result run(AVS_ScriptEnvironment* env, AVS_Clip* source, const options& o, const std::string& filter)
+    {
+        result r{};
+        r.filter = filter;
+
+        AVS_Clip* clip{tools::create_filter(env, source, o, filter, {{"stats", "true"}}, r.error)};
+        if (!clip)
+            return r;
+
+        const auto fetch{[&](int n, uint64_t& gpu_ns, uint64_t& up, uint64_t& down) {
+            AVS_VideoFrame* frame{avs_mock::get_frame(clip, n)};
+            if (!frame)
+            {
+                const char* err{avs_mock::clip_error(clip)};
+                r.error = (err) ? err : "get_frame failed";
+                return false;
+            }
+
+            gpu_ns += avs_mock::prop_int(env, frame, "PlaceboGpuTime", 0);
+            up += avs_mock::prop_int(env, frame, "PlaceboBytesUploaded", 0);
+            down += avs_mock::prop_int(env, frame, "PlaceboBytesDownloaded", 0);
+            avs_mock::release_frame(frame);
+
+            return true;
+        }};
+
+        uint64_t gpu_ns{0};
+        uint64_t up{0};
+        uint64_t down{0};
+
+        bool ok{true};
+        for (int n{0}; ok && n < o.warmup; ++n)
+            ok = fetch(n, gpu_ns, up, down);
+
+        gpu_ns = up = down = 0;
+
+        const auto start{std::chrono::steady_clock::now()};
+        for (int n{0}; ok && n < o.frames; ++n)
+            ok = fetch(o.warmup + n, gpu_ns, up, down);
+        const auto end{std::chrono::steady_clock::now()};
+
+        avs_mock::release_clip(clip);
+
+        if (!ok)
+            return r;
+
+        constexpr double mib{1024.0 * 1024.0};
+
+        r.frames = o.frames;
+        r.seconds = std::chrono::duration<double>(end - start).count();
+        r.fps = o.frames / r.seconds;
+        r.gpu_ms = gpu_ns / 1e6;
+        r.upload_mib_s = up / mib / r.seconds;
+        r.download_mib_s = down / mib / r.seconds;
+
+        return r;
+    }
+
+    std::string config_key(const std::string& filter, int width, int height, int bits, const std::string& format)
+    {
+        return filter + "/" + std::to_string(width) + "x" + std::to_string(height) + "/" + std::to_string(bits) + "/" + format;
+    }
+
+    // Reads the results of a previous report, keyed by config_key.
+    bool read_baseline(const std::string& path, std::map<std::string, double>& fps)
+    {
+        std::ifstream f(path);
+        if (!f)
+            return false;
+
+        std::stringstream ss;
+        ss << f.rdbuf();
+        const std::string text{ss.str()};
+
+        const std::regex object("\\{[^{}]*\\}");
+        const std::regex str_field("\"(filter|format)\":\\s*\"([^\"]*)\"");
+        const std::regex num_field("\"(width|height|bits|fps)\":\\s*([-0-9.eE+]+)");
+
+        for (auto itr{std::sregex_iterator(text.begin(), text.end(), object)}; itr != std::sregex_iterator(); ++itr)
+        {
+            const std::string obj{itr->str()};
+            std::map<std::string, std::string> fields;
+
+            for (auto m{std::sregex_iterator(obj.begin(), obj.end(), str_field)}; m != std::sregex_iterator(); ++m)
+                fields[(*m)[1]] = (*m)[2];
+            for (auto m{std::sregex_iterator(obj.begin(), obj.end(), num_field)}; m != std::sregex_iterator(); ++m)
+                fields[(*m)[1]] = (*m)[2];
+
+            if (fields.size() == 6)
+                fps[config_key(fields["filter"], std::stoi(fields["width"]), std::stoi(fields["height"]), std::stoi(fields["bits"]),
+                    fields["format"])] = std::stod(fields["fps"]);
+        }
+
+        return true;
+    }
+
+    std::string to_json(const options& o, const std::vector<result>& results)
+    {
+        std::ostringstream js;
+        js.precision(6);
+        js << std::fixed;
+
+        js << "{\n  \"device\": " << o.device << ",\n  \"results\": [";
+
+        for (size_t i{0}; i < results.size(); ++i)
+        {
+            const result& r{results[i]};
+
+            js << ((i) ? ",\n" : "\n") << "    {\"filter\": \"" << r.filter << "\", \"width\": " << o.width << ", \"height\": " << o.height
+               << ", \"bits\": " << o.bits << ", \"format\": \"" << o.format << "\"";
+
+            if (!r.error.empty())
+                js << ", \"error\": \"" << tools::json_escape(r.error) << "\"";
+            else
+            {
+                js << ", \"frames\": " << r.frames << ", \"seconds\": " << r.seconds << ", \"fps\": " << r.fps << ", \"gpu_time_ms\": " << r.gpu_ms
+                   << ", \"gpu_ms_per_frame\": " << r.gpu_ms / r.frames << ", \"upload_mib_s\": " << r.upload_mib_s
+                   << ", \"download_mib_s\": " << r.download_mib_s;
+
+                if (r.baseline_fps > 0.0)
+                    js << ", \"baseline_fps\": " << r.baseline_fps << ", \"regression\": " << ((r.regression) ? "true" : "false");
+            }
+
+            js << "}";
+        }
+
+        js << "\n  ]\n}\n";
+
+        return js.str();
+    }
+} // namespace
+
+int main(int argc, char** argv)
+{
+    options o;
+    if (!parse_options(argc, argv, o))
+    {
+        usage();
+        return 1;
+    }
+
+    AVS_ScriptEnvironment* env{avs_mock::create_env()};
+
+    std::string err;
+    if (!avs_mock::load_plugin(env, o.plugin, err))
+    {
+        std::cerr << "failed loading " << o.plugin << ": " << err << "\n";
+        avs_mock::destroy_env(env);
+        return 1;
+    }
+
+    AVS_Clip* source{tools::new_source(env, o, o.warmup + o.frames)};
+
+    std::map<std::string, double> baseline;
+    if (!o.baseline.empty() && !read_baseline(o.baseline, baseline))
+        std::cerr << "cannot read baseline " << o.baseline << "\n";
+
+    std::vector<result> results;
+    bool failed{false};
+    bool regressed{false};
+
+    for (const std::string& filter : o.filters)
+    {
+        result r{run(env, source, o, filter)};
+
+        if (!r.error.empty())
+            failed |= r.error.rfind("skipped", 0) != 0;
+        else
+        {
+            const auto itr{baseline.find(config_key(filter, o.width, o.height, o.bits, o.format))};
+            if (itr != baseline.end())
+            {
+                r.baseline_fps = itr->second;
+                r.regression = r.fps < r.baseline_fps * (1.0 - o.tolerance);
+                regressed |= r.regression;
+            }
+        }
+
+        results.emplace_back(std::move(r));
+    }
+
+    avs_mock::release_clip(source);
+    avs_mock::destroy_env(env);
+
+    const std::string report{to_json(o, results)};
+
+    if (o.output.empty())
+        std::cout << report;
+    else
+    {
+        std::ofstream f(o.output);
+        f << report;
+        if (!f)
+        {
+            std::cerr << "failed writing " << o.output << "\n";
+            return 1;
+        }
+    }
+
+    return (failed) ? 1 : ((regressed) ? 2 : 0);
+}
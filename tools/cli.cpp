@@ -0,0 +1,879 @@
+#include <algorithm>
+#include <atomic>
+#include <condition_variable>
+#include <cstdio>
+#include <cstring>
+#include <deque>
+#include <fstream>
+#include <iostream>
+#include <limits>
+#include <map>
+#include <mutex>
+#include <optional>
+#include <sstream>
+#include <string>
+#include <thread>
+#include <vector>
+
+#ifdef _WIN32
+#include <fcntl.h>
+#include <io.h>
+#endif
+
+#include "tool_common.h"
+
+namespace
+{
+    struct options : tools::filter_options
+    {
+        std::string filter;
+        std::vector<avs_mock::named_arg> args;
+        int depth{0};
+        int queue{4};
+        std::string sidecar;
+        std::string sidecar_out;
+        std::string rpu;
+    };
+
+    void usage()
+    {
+        std::cerr << "usage: placebo-cli <deband|resample|shader|tonemap> [options] [key=value ...] < in.y4m > out.y4m\n"
+                     "  key=value                filter argument (value is the filter's unnamed parameter when key is empty: =value)\n"
+                     "  --plugin <path>          plugin to load (default: the one built alongside)\n"
+                     "  --device <n>             Vulkan device index (default: libplacebo's choice)\n"
+                     "  --resample-size <WxH>    Resample target size (default: twice the source size)\n"
+                     "  --shader <path>          mpv user shader for libplacebo_Shader\n"
+                     "  --depth <n>              output bit depth (default: input bit depth)\n"
+                     "  --queue <n>              frames buffered between the reader, GPU and writer stages (default: 4)\n"
+                     "  --sidecar <path>         frame properties (HDR metadata) for the input frames\n"
+                     "  --sidecar-out <path>     write the frame properties of the output frames\n"
+                     "  --rpu <path>             Dolby Vision RPUs (dovi_tool extract-rpu), one per frame in order\n";
+    }
+
+    bool parse_options(int argc, char** argv, options& o)
+    {
+        if (argc < 2 || argv[1][0] == '-')
+            return false;
+
+        o.filter = argv[1];
+
+        for (int i{2}; i < argc; ++i)
+        {
+            const std::string opt{argv[i]};
+            if (opt == "-h" || opt == "--help")
+                return false;
+
+            if (opt.rfind("--", 0) != 0)
+            {
+                const size_t eq{opt.find('=')};
+                if (eq == std::string::npos)
+                {
+                    std::cerr << "filter arguments must be in the form key=value\n";
+                    return false;
+                }
+
+                o.args.emplace_back(opt.substr(0, eq), opt.substr(eq + 1));
+                continue;
+            }
+
+            if (i + 1 >= argc)
+            {
+                std::cerr << "missing value for " << opt << "\n";
+                return false;
+            }
+
+            const std::string val{argv[++i]};
+
+            try
+            {
+                if (opt != "--width" && opt != "--height" && opt != "--bits" && opt != "--format" && tools::parse_filter_option(opt, val, o))
+                    continue;
+
+                if (opt == "--depth")
+                    o.depth = std::stoi(val);
+                else if (opt == "--queue")
+                    o.queue = std::stoi(val);
+                else if (opt == "--sidecar")
+                    o.sidecar = val;
+                else if (opt == "--sidecar-out")
+                    o.sidecar_out = val;
+                else if (opt == "--rpu")
+                    o.rpu = val;
+                else
+                {
+                    std::cerr << "unknown option " << opt << "\n";
+                    return false;
+                }
+            }
+            catch (const std::exception&)
+            {
+                std::cerr << "invalid value " << val << " for " << opt << "\n";
+                return false;
+            }
+        }
+
+        if (o.queue < 1 || (o.depth && (o.depth < 8 || o.depth > 16)))
+        {
+            std::cerr << "invalid --queue or --depth\n";
+            return false;
+        }
+
+        return true;
+    }
+
+    // Fixed capacity FIFO between two pipeline stages. push blocks while it's full, pop blocks while it's empty.
+    // After close() push fails and pop drains what's left.
+    template<typename T>
+    class bounded_queue
+    {
+    public:
+        explicit bounded_queue(size_t capacity) : capacity_(capacity)
+        {
+        }
+
+        bool push(T v)
+        {
+            std::unique_lock<std::mutex> lck(mtx_);
+            not_full_.wait(lck, [this] { return closed_ || items_.size() < capacity_; });
+            if (closed_)
+                return false;
+
+            items_.emplace_back(std::move(v));
+            not_empty_.notify_one();
+
+            return true;
+        }
+
+        std::optional<T> pop()
+        {
+            std::unique_lock<std::mutex> lck(mtx_);
+            not_empty_.wait(lck, [this] { return closed_ || !items_.empty(); });
+            if (items_.empty())
+                return std::nullopt;
+
+            T v{std::move(items_.front())};
+            items_.pop_front();
+            not_full_.notify_one();
+
+            return v;
+        }
+
+        void close()
+        {
+            std::lock_guard<std::mutex> lck(mtx_);
+            closed_ = true;
+            not_full_.notify_all();
+            not_empty_.notify_all();
+        }
+
+    private:
+        std::mutex mtx_;
+        std::condition_variable not_full_;
+        std::condition_variable not_empty_;
+        std::deque<T> items_;
+        size_t capacity_;
+        bool closed_{false};
+    };
+
+    //
+    // y4m
+    //
+
+    struct y4m_format
+    {
+        AVS_VideoInfo vi;
+        // Bit depth in the stream, the frames are 8-bit or 16-bit.
+        int bits;
+        int chroma_location;
+        int color_range;
+        std::string interlace;
+        std::string aspect;
+    };
+
+    bool read_line(std::FILE* f, std::string& line)
+    {
+        line.clear();
+        for (int c{std::fgetc(f)}; c != '\n'; c = std::fgetc(f))
+        {
+            if (c == EOF)
+                return false;
+
+            line += static_cast<char>(c);
+        }
+
+        return true;
+    }
+
+    bool parse_y4m_header(const std::string& header, y4m_format& fmt, std::string& err)
+    {
+        std::istringstream ss(header);
+        std::string tag;
+        ss >> tag;
+        if (tag != "YUV4MPEG2")
+        {
+            err = "input isn't y4m";
+            return false;
+        }
+
+        std::string colorspace{"420jpeg"};
+        fmt = {};
+        fmt.vi.fps_numerator = 25;
+        fmt.vi.fps_denominator = 1;
+        fmt.color_range = 1;
+
+        while (ss >> tag)
+        {
+            const std::string v{tag.substr(1)};
+
+            switch (tag[0])
+            {
+            case 'W':
+                fmt.vi.width = std::stoi(v);
+                break;
+            case 'H':
+                fmt.vi.height = std::stoi(v);
+                break;
+            case 'F':
+                fmt.vi.fps_numerator = std::stoi(v.substr(0, v.find(':')));
+                fmt.vi.fps_denominator = std::stoi(v.substr(v.find(':') + 1));
+                break;
+            case 'I':
+                fmt.interlace = v;
+                break;
+            case 'A':
+                fmt.aspect = v;
+                break;
+            case 'C':
+                colorspace = v;
+                break;
+            case 'X':
+                if (v == "COLORRANGE=FULL")
+                    fmt.color_range = 0;
+                break;
+            }
+        }
+
+        std::string format;
+        if (colorspace.rfind("mono", 0) == 0)
+        {
+            format = "y";
+            fmt.bits = (colorspace.size() > 4) ? std::stoi(colorspace.substr(4)) : 8;
+        }
+        else if (colorspace.size() >= 3 && (colorspace.rfind("420", 0) == 0 || colorspace.rfind("422", 0) == 0 || colorspace.rfind("444", 0) == 0))
+        {
+            format = colorspace.substr(0, 3);
+            const std::string rest{colorspace.substr(3)};
+
+            if (rest.empty() || rest == "jpeg" || rest == "mpeg2" || rest == "paldv")
+                fmt.bits = 8;
+            else if (rest[0] == 'p')
+                fmt.bits = std::stoi(rest.substr(1));
+            else
+            {
+                err = "unsupported y4m colorspace " + colorspace;
+                return false;
+            }
+
+            // 420 and 420jpeg are center, 420paldv is top-left, everything else is left.
+            fmt.chroma_location = (rest.empty() || rest == "jpeg") ? 1 : ((rest == "paldv") ? 2 : 0);
+        }
+        else
+        {
+            err = "unsupported y4m colorspace " + colorspace;
+            return false;
+        }
+
+        if (fmt.bits < 8 || fmt.bits > 16 || fmt.vi.width < 1 || fmt.vi.height < 1)
+        {
+            err = "unsupported y4m stream";
+            return false;
+        }
+
+        fmt.vi.pixel_type = avs_mock::pixel_type((fmt.bits == 8) ? 8 : 16, format);
+        // The length of a stream isn't known, frames past the end are never requested.
+        fmt.vi.num_frames = std::numeric_limits<int>::max();
+
+        return true;
+    }
+
+    std::string y4m_header(const AVS_VideoInfo& vi, int bits, int chroma_location, int color_range, const y4m_format& in)
+    {
+        const std::string format{avs_mock::format(vi)};
+        std::string colorspace;
+
+        if (format == "y")
+            colorspace = (bits == 8) ? "mono" : "mono" + std::to_string(bits);
+        else if (bits > 8)
+            colorspace = format + "p" + std::to_string(bits);
+        else if (format == "420")
+            colorspace = (chroma_location == 1) ? "420jpeg" : ((chroma_location == 2) ? "420paldv" : "420mpeg2");
+        else
+            colorspace = format;
+
+        std::string header{"YUV4MPEG2 W" + std::to_string(vi.width) + " H" + std::to_string(vi.height) + " F" +
+            std::to_string(vi.fps_numerator) + ":" + std::to_string(vi.fps_denominator)};
+        if (!in.interlace.empty())
+            header += " I" + in.interlace;
+        if (!in.aspect.empty())
+            header += " A" + in.aspect;
+        header += " C" + colorspace + " XCOLORRANGE=" + ((color_range == 0) ? "FULL" : "LIMITED") + "\n";
+
+        return header;
+    }
+
+    constexpr int y4m_planes[3]{AVS_PLANAR_Y, AVS_PLANAR_U, AVS_PLANAR_V};
+
+    // Samples are shifted between bit depths the way AviSynth+ does (no range scaling), with rounding when reducing.
+    uint32_t rescale(uint32_t v, int from, int to)
+    {
+        if (from == to)
+            return v;
+        if (from < to)
+            return v << (to - from);
+
+        const int shift{from - to};
+        return std::min((v + (1u << (shift - 1))) >> shift, (1u << to) - 1);
+    }
+
+    bool read_frame(std::FILE* f, const y4m_format& fmt, AVS_VideoFrame* frame, std::vector<uint8_t>& row)
+    {
+        const int in_size{(fmt.bits > 8) ? 2 : 1};
+        const int frame_bits{avs_mock::bits(fmt.vi)};
+
+        for (const int p : y4m_planes)
+        {
+            const avs_mock::plane_view v{avs_mock::plane(frame, p)};
+            if (!v.data)
+                break;
+
+            const int width{v.row_size / ((frame_bits > 8) ? 2 : 1)};
+            row.resize(static_cast<size_t>(width) * in_size);
+
+            for (int y{0}; y < v.height; ++y)
+            {
+                if (std::fread(row.data(), 1, row.size(), f) != row.size())
+                    return false;
+
+                uint8_t* dst{v.data + static_cast<size_t>(y) * v.pitch};
+
+                if (in_size == 1)
+                    std::memcpy(dst, row.data(), row.size());
+                else
+                {
+                    for (int x{0}; x < width; ++x)
+                    {
+                        const uint32_t s{static_cast<uint32_t>(row[2 * x] | (row[2 * x + 1] << 8))};
+                        reinterpret_cast<uint16_t*>(dst)[x] = static_cast<uint16_t>(rescale(s, fmt.bits, 16));
+                    }
+                }
+            }
+        }
+
+        return true;
+    }
+
+    bool write_frame(std::FILE* f, const AVS_VideoInfo& vi, int bits, AVS_VideoFrame* frame, std::vector<uint8_t>& row)
+    {
+        const int frame_bits{avs_mock::bits(vi)};
+        const int out_size{(bits > 8) ? 2 : 1};
+
+        if (std::fputs("FRAME\n", f) < 0)
+            return false;
+
+        for (const int p : y4m_planes)
+        {
+            const avs_mock::plane_view v{avs_mock::plane(frame, p)};
+            if (!v.data)
+                break;
+
+            const int width{v.row_size / ((frame_bits > 8) ? 2 : 1)};
+            row.resize(static_cast<size_t>(width) * out_size);
+
+            for (int y{0}; y < v.height; ++y)
+            {
+                const uint8_t* src{v.data + static_cast<size_t>(y) * v.pitch};
+
+                for (int x{0}; x < width; ++x)
+                {
+                    const uint32_t s{(frame_bits > 8) ? reinterpret_cast<const uint16_t*>(src)[x] : src[x]};
+                    const uint32_t d{rescale(s, frame_bits, bits)};
+
+                    if (out_size == 1)
+                        row[x] = static_cast<uint8_t>(d);
+                    else
+                    {
+                        row[2 * x] = static_cast<uint8_t>(d & 0xFF);
+                        row[2 * x + 1] = static_cast<uint8_t>(d >> 8);
+                    }
+                }
+
+                if (std::fwrite(row.data(), 1, row.size(), f) != row.size())
+                    return false;
+            }
+        }
+
+        return true;
+    }
+
+    //
+    // sidecar
+    //
+
+    // Text file with one line per change: `<frame> key=value ...`.
+    // A value applies from that frame until it's changed again, an empty value removes the property.
+    // Keys starting with `_` are integers, the rest are floats (comma separated arrays).
+    using sidecar = std::map<int, std::vector<avs_mock::named_arg>>;
+
+    bool read_sidecar(const std::string& path, sidecar& out, std::string& err)
+    {
+        std::ifstream f(path);
+        if (!f)
+        {
+            err = "cannot open " + path;
+            return false;
+        }
+
+        for (std::string line; std::getline(f, line);)
+        {
+            if (line.empty() || line[0] == '#')
+                continue;
+
+            std::istringstream ss(line);
+            int n{};
+            if (!(ss >> n) || n < 0)
+            {
+                err = "invalid sidecar line: " + line;
+                return false;
+            }
+
+            for (std::string kv; ss >> kv;)
+            {
+                const size_t eq{kv.find('=')};
+                if (eq == std::string::npos || eq == 0)
+                {
+                    err = "invalid sidecar entry: " + kv;
+                    return false;
+                }
+
+                out[n].emplace_back(kv.substr(0, eq), kv.substr(eq + 1));
+            }
+        }
+
+        return true;
+    }
+
+    void set_props(AVS_VideoFrame* frame, const std::map<std::string, std::string>& props)
+    {
+        for (const auto& [key, value] : props)
+        {
+            const std::vector<std::string> values{tools::split(value, ',')};
+
+            if (key[0] == '_')
+                avs_mock::set_prop_int(frame, key, std::stoll(values[0]));
+            else
+            {
+                std::vector<double> d;
+                for (const std::string& v : values)
+                    d.emplace_back(std::stod(v));
+
+                avs_mock::set_prop_float(frame, key, d);
+            }
+        }
+    }
+
+    // Annex B stream of UNSPEC62 NAL units as written by dovi_tool extract-rpu. The start codes are stripped.
+    bool read_rpus(const std::string& path, std::vector<std::string>& rpus, std::string& err)
+    {
+        std::ifstream f(path, std::ios::binary);
+        if (!f)
+        {
+            err = "cannot open " + path;
+            return false;
+        }
+
+        const std::string data{std::istreambuf_iterator<char>(f), std::istreambuf_iterator<char>()};
+        const std::string start_code("\0\0\1", 3);
+
+        for (size_t pos{data.find(start_code)}; pos != std::string::npos;)
+        {
+            const size_t begin{pos + 3};
+            pos = data.find(start_code, begin);
+
+            std::string nalu{data.substr(begin, (pos == std::string::npos) ? std::string::npos : pos - begin)};
+            // The leading zero of the next 4-byte start code. RPUs end with the 0x80 stop bit.
+            while (!nalu.empty() && nalu.back() == '\0')
+                nalu.pop_back();
+
+            if (!nalu.empty())
+                rpus.emplace_back(std::move(nalu));
+        }
+
+        if (rpus.empty())
+        {
+            err = path + " doesn't contain RPUs";
+            return false;
+        }
+
+        return true;
+    }
+
+    //
+    // pipeline
+    //
+
+    // Reads frames on its own thread. The filter chain pulls them in order through get_frame, a few recent frames are kept for
+    // filters that request a frame more than once.
+    class y4m_source
+    {
+    public:
+        y4m_source(std::FILE* f, const y4m_format& fmt, int queue, sidecar props, std::vector<std::string> rpus)
+            : f_(f), fmt_(fmt), queue_(queue), props_(std::move(props)), rpus_(std::move(rpus))
+        {
+            reader_ = std::thread([this] { read(); });
+        }
+
+        ~y4m_source()
+        {
+            queue_.close();
+            reader_.join();
+
+            while (std::optional<AVS_VideoFrame*> frame{queue_.pop()})
+                avs_mock::release_frame(*frame);
+            for (AVS_VideoFrame* frame : window_)
+                avs_mock::release_frame(frame);
+        }
+
+        // False when the stream ends before frame n.
+        bool wait(int n)
+        {
+            std::lock_guard<std::mutex> lck(mtx_);
+            return fill(n);
+        }
+
+        AVS_VideoFrame* get_frame(int n, std::string& err)
+        {
+            std::lock_guard<std::mutex> lck(mtx_);
+            if (!fill(n))
+                n = first_ + static_cast<int>(window_.size()) - 1;
+
+            if (n < first_ || window_.empty())
+            {
+                const std::string reader_err{error()};
+                err = (reader_err.empty()) ? "frame " + std::to_string(n) + " isn't available anymore." : reader_err;
+                return nullptr;
+            }
+
+            return avs_mock::copy_frame(window_[n - first_]);
+        }
+
+        std::string error()
+        {
+            std::lock_guard<std::mutex> lck(error_mtx_);
+            return error_;
+        }
+
+    private:
+        static constexpr size_t window_size{16};
+
+        bool fill(int n)
+        {
+            while (first_ + static_cast<int>(window_.size()) <= n)
+            {
+                std::optional<AVS_VideoFrame*> frame{queue_.pop()};
+                if (!frame)
+                    return false;
+
+                window_.emplace_back(*frame);
+                if (window_.size() > window_size)
+                {
+                    avs_mock::release_frame(window_.front());
+                    window_.pop_front();
+                    ++first_;
+                }
+            }
+
+            return true;
+        }
+
+        void read()
+        {
+            std::vector<uint8_t> row;
+            std::map<std::string, std::string> current;
+
+            for (int n{0};; ++n)
+            {
+                std::string line;
+                if (!read_line(f_, line))
+                    break;
+
+                if (line.rfind("FRAME", 0) != 0)
+                {
+                    set_error("invalid y4m frame header");
+                    break;
+                }
+
+                AVS_VideoFrame* frame{avs_mock::new_frame(fmt_.vi)};
+                if (!read_frame(f_, fmt_, frame, row))
+                {
+                    avs_mock::release_frame(frame);
+                    set_error("truncated y4m frame " + std::to_string(n));
+                    break;
+                }
+
+                const auto itr{props_.find(n)};
+                if (itr != props_.end())
+                {
+                    for (const auto& [key, value] : itr->second)
+                    {
+                        if (value.empty())
+                            current.erase(key);
+                        else
+                            current[key] = value;
+                    }
+                }
+
+                try
+                {
+                    avs_mock::set_prop_int(frame, "_ColorRange", fmt_.color_range);
+                    if (avs_mock::format(fmt_.vi) == "420" || avs_mock::format(fmt_.vi) == "422")
+                        avs_mock::set_prop_int(frame, "_ChromaLocation", fmt_.chroma_location);
+                    set_props(frame, current);
+                }
+                catch (const std::exception&)
+                {
+                    avs_mock::release_frame(frame);
+                    set_error("invalid sidecar value for frame " + std::to_string(n));
+                    break;
+                }
+
+                if (!rpus_.empty())
+                    avs_mock::set_prop_data(frame, "DolbyVisionRPU", rpus_[std::min<size_t>(n, rpus_.size() - 1)]);
+
+                if (!queue_.push(frame))
+                {
+                    avs_mock::release_frame(frame);
+                    break;
+                }
+            }
+
+            queue_.close();
+        }
+
+        // Not under mtx_: fill() holds it while it waits for the reader.
+        void set_error(const std::string& err)
+        {
+            std::lock_guard<std::mutex> lck(error_mtx_);
+            error_ = err;
+        }
+
+        std::FILE* f_;
+        const y4m_format fmt_;
+        bounded_queue<AVS_VideoFrame*> queue_;
+        const sidecar props_;
+        const std::vector<std::string> rpus_;
+        std::thread reader_;
+
+        std::mutex mtx_;
+        std::deque<AVS_VideoFrame*> window_;
+        int first_{0};
+
+        std::mutex error_mtx_;
+        std::string error_;
+    };
+
+    // Writes the properties that changed since the previous frame in the sidecar format.
+    void write_sidecar_line(std::ofstream& f, int n, AVS_VideoFrame* frame, std::map<std::string, std::string>& last)
+    {
+        std::map<std::string, std::string> props;
+        for (auto& [key, value] : avs_mock::props_text(frame))
+            props.emplace(std::move(key), std::move(value));
+
+        std::string line;
+        for (const auto& [key, value] : props)
+        {
+            const auto itr{last.find(key)};
+            if (itr == last.end() || itr->second != value)
+                line += " " + key + "=" + value;
+        }
+        for (const auto& [key, value] : last)
+        {
+            if (!props.count(key))
+                line += " " + key + "=";
+        }
+
+        if (!line.empty())
+            f << n << line << "\n";
+
+        last = std::move(props);
+    }
+} // namespace
+
+int main(int argc, char** argv)
+{
+    options o;
+    if (!parse_options(argc, argv, o))
+    {
+        usage();
+        return 1;
+    }
+
+#ifdef _WIN32
+    _setmode(_fileno(stdin), _O_BINARY);
+    _setmode(_fileno(stdout), _O_BINARY);
+#endif
+
+    std::vector<char> in_buf(1 << 20);
+    std::vector<char> out_buf(1 << 20);
+    std::setvbuf(stdin, in_buf.data(), _IOFBF, in_buf.size());
+    std::setvbuf(stdout, out_buf.data(), _IOFBF, out_buf.size());
+
+    std::string err;
+    y4m_format fmt;
+    std::string header;
+    bool header_ok{false};
+    try
+    {
+        header_ok = read_line(stdin, header) && parse_y4m_header(header, fmt, err);
+    }
+    catch (const std::exception&)
+    {
+        err = "invalid y4m header";
+    }
+
+    if (!header_ok)
+    {
+        std::cerr << "placebo-cli: " << ((err.empty()) ? "cannot read the y4m header" : err) << "\n";
+        return 1;
+    }
+
+    sidecar props;
+    std::vector<std::string> rpus;
+    if ((!o.sidecar.empty() && !read_sidecar(o.sidecar, props, err)) || (!o.rpu.empty() && !read_rpus(o.rpu, rpus, err)))
+    {
+        std::cerr << "placebo-cli: " << err << "\n";
+        return 1;
+    }
+
+    std::ofstream sidecar_out;
+    if (!o.sidecar_out.empty())
+    {
+        sidecar_out.open(o.sidecar_out);
+        if (!sidecar_out)
+        {
+            std::cerr << "placebo-cli: cannot create " << o.sidecar_out << "\n";
+            return 1;
+        }
+    }
+
+    AVS_ScriptEnvironment* env{avs_mock::create_env()};
+    if (!avs_mock::load_plugin(env, o.plugin, err))
+    {
+        std::cerr << "placebo-cli: failed loading " << o.plugin << ": " << err << "\n";
+        avs_mock::destroy_env(env);
+        return 1;
+    }
+
+    o.width = fmt.vi.width;
+    o.height = fmt.vi.height;
+
+    int ret{0};
+    {
+        y4m_source source(stdin, fmt, o.queue, std::move(props), std::move(rpus));
+        AVS_Clip* src_clip{avs_mock::new_callback_clip(fmt.vi, [&](int n, std::string& e) { return source.get_frame(n, e); })};
+        AVS_Clip* clip{tools::create_filter(env, src_clip, o, o.filter, o.args, err)};
+        avs_mock::release_clip(src_clip);
+
+        if (!clip)
+        {
+            std::cerr << "placebo-cli: " << err << "\n";
+            avs_mock::destroy_env(env);
+            return 1;
+        }
+
+        const AVS_VideoInfo out_vi{*avs_mock::video_info(clip)};
+        const int out_bits{(o.depth) ? o.depth : fmt.bits};
+
+        if (avs_mock::bits(out_vi) == 32 || avs_mock::format(out_vi) == "rgb")
+        {
+            std::cerr << "placebo-cli: the output format can't be stored in y4m (use 8/16-bit YUV output)\n";
+            avs_mock::release_clip(clip);
+            avs_mock::destroy_env(env);
+            return 1;
+        }
+
+        bounded_queue<AVS_VideoFrame*> out_queue(o.queue);
+        std::atomic<bool> write_failed{false};
+
+        std::thread writer([&] {
+            std::vector<uint8_t> row;
+            std::map<std::string, std::string> last_props;
+            bool header_written{false};
+
+            for (int n{0};; ++n)
+            {
+                std::optional<AVS_VideoFrame*> frame{out_queue.pop()};
+                if (!frame)
+                    break;
+
+                if (!write_failed && !header_written)
+                {
+                    const std::string h{y4m_header(out_vi, out_bits, static_cast<int>(avs_mock::prop_int(env, *frame, "_ChromaLocation", 0)),
+                        static_cast<int>(avs_mock::prop_int(env, *frame, "_ColorRange", 1)), fmt)};
+                    write_failed = std::fputs(h.c_str(), stdout) < 0;
+                    header_written = true;
+                }
+
+                if (!write_failed)
+                    write_failed = !write_frame(stdout, out_vi, out_bits, *frame, row);
+                if (sidecar_out.is_open())
+                    write_sidecar_line(sidecar_out, n, *frame, last_props);
+
+                avs_mock::release_frame(*frame);
+
+                // Stop the GPU stage too, the consumer is gone.
+                if (write_failed)
+                    out_queue.close();
+            }
+
+            std::fflush(stdout);
+        });
+
+        for (int n{0}; !write_failed && source.wait(n); ++n)
+        {
+            AVS_VideoFrame* frame{avs_mock::get_frame(clip, n)};
+            if (!frame)
+            {
+                const char* e{avs_mock::clip_error(clip)};
+                std::cerr << "placebo-cli: frame " << n << ": " << ((e) ? e : "get_frame failed") << "\n";
+                ret = 1;
+                break;
+            }
+
+            if (!out_queue.push(frame))
+            {
+                avs_mock::release_frame(frame);
+                break;
+            }
+        }
+
+        out_queue.close();
+        writer.join();
+        avs_mock::release_clip(clip);
+
+        if (write_failed)
+        {
+            std::cerr << "placebo-cli: failed writing the output\n";
+            ret = 1;
+        }
+
+        if (const std::string e{source.error()}; !e.empty())
+        {
+            std::cerr << "placebo-cli: " << e << "\n";
+            ret = 1;
+        }
+    }
+
+    avs_mock::destroy_env(env);
+
+    return ret;
+}
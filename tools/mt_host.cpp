@@ -0,0 +1,489 @@
+#include <atomic>
+#include <chrono>
+#include <fstream>
+#include <iostream>
+#include <mutex>
+#include <sstream>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include <vulkan/vulkan.h>
+
+#include "tool_common.h"
+
+namespace
+{
+    struct options : tools::filter_options
+    {
+        std::vector<std::string> filters{"deband", "resample", "shader", "tonemap"};
+        std::vector<std::string> modes{"nice", "multi", "serialized"};
+        std::vector<int> threads{1, 2, 4, 8};
+        int frames{200};
+        int warmup{4};
+        std::string output;
+    };
+
+    struct run_result
+    {
+        std::string mode;
+        int threads;
+        std::string error;
+        double seconds;
+        double fps;
+        double speedup;
+        // -1 when VK_EXT_memory_budget isn't available.
+        double peak_device_mib;
+    };
+
+    struct filter_result
+    {
+        std::string filter;
+        std::string error;
+        int mt_mode;
+        std::vector<run_result> runs;
+    };
+
+    void usage()
+    {
+        std::cerr << "usage: avs_libplacebo_mt [options]\n"
+                  << tools::filter_usage
+                  << "  --filter <list>          comma separated: deband, resample, shader, tonemap (default: all)\n"
+                     "  --mode <list>            comma separated: nice, multi, serialized (default: all)\n"
+                     "  --threads <list>         comma separated thread counts (default: 1,2,4,8)\n"
+                     "  --frames <n>             frames per run (default: 200)\n"
+                     "  --warmup <n>             frames requested from every instance before measuring (default: 4)\n"
+                     "  --output <path>          write the JSON report to a file instead of stdout\n";
+    }
+
+    bool parse_options(int argc, char** argv, options& o)
+    {
+        for (int i{1}; i < argc; ++i)
+        {
+            const std::string opt{argv[i]};
+            if (opt == "-h" || opt == "--help")
+                return false;
+            if (i + 1 >= argc)
+            {
+                std::cerr << "missing value for " << opt << "\n";
+                return false;
+            }
+
+            const std::string val{argv[++i]};
+
+            try
+            {
+                if (tools::parse_filter_option(opt, val, o))
+                    continue;
+
+                if (opt == "--filter")
+                    o.filters = tools::split(val, ',');
+                else if (opt == "--mode")
+                    o.modes = tools::split(val, ',');
+                else if (opt == "--threads")
+                {
+                    o.threads.clear();
+                    for (const std::string& t : tools::split(val, ','))
+                        o.threads.emplace_back(std::stoi(t));
+                }
+                else if (opt == "--frames")
+                    o.frames = std::stoi(val);
+                else if (opt == "--warmup")
+                    o.warmup = std::stoi(val);
+                else if (opt == "--output")
+                    o.output = val;
+                else
+                {
+                    std::cerr << "unknown option " << opt << "\n";
+                    return false;
+                }
+            }
+            catch (const std::exception&)
+            {
+                std::cerr << "invalid value " << val << " for " << opt << "\n";
+                return false;
+            }
+        }
+
+        for (const std::string& m : o.modes)
+        {
+            if (m != "nice" && m != "multi" && m != "serialized")
+            {
+                std::cerr << "unknown mode " << m << "\n";
+                return false;
+            }
+        }
+
+        for (const int t : o.threads)
+        {
+            if (t < 1)
+            {
+                std::cerr << "thread count must be greater than 0\n";
+                return false;
+            }
+        }
+
+        if (o.frames < 1 || o.warmup < 0 || !tools::valid_source(o))
+        {
+            std::cerr << "invalid source configuration\n";
+            return false;
+        }
+
+        return true;
+    }
+
+    // Samples the device memory used by this process (VK_EXT_memory_budget reports per-process usage) and keeps the peak.
+    class memory_sampler
+    {
+    public:
+        explicit memory_sampler(int device)
+        {
+            VkApplicationInfo app_info{};
+            app_info.sType = VK_STRUCTURE_TYPE_APPLICATION_INFO;
+            app_info.apiVersion = VK_API_VERSION_1_1;
+
+            VkInstanceCreateInfo info{};
+            info.sType = VK_STRUCTURE_TYPE_INSTANCE_CREATE_INFO;
+            info.pApplicationInfo = &app_info;
+
+            if (vkCreateInstance(&info, nullptr, &inst_))
+            {
+                inst_ = VK_NULL_HANDLE;
+                return;
+            }
+
+            uint32_t dev_count{0};
+            vkEnumeratePhysicalDevices(inst_, &dev_count, nullptr);
+            std::vector<VkPhysicalDevice> devices(dev_count);
+            vkEnumeratePhysicalDevices(inst_, &dev_count, devices.data());
+
+            for (uint32_t i{0}; i < dev_count; ++i)
+            {
+                if (device > -1 && static_cast<uint32_t>(device) != i)
+                    continue;
+
+                uint32_t ext_count{0};
+                vkEnumerateDeviceExtensionProperties(devices[i], nullptr, &ext_count, nullptr);
+                std::vector<VkExtensionProperties> exts(ext_count);
+                vkEnumerateDeviceExtensionProperties(devices[i], nullptr, &ext_count, exts.data());
+
+                for (const VkExtensionProperties& e : exts)
+                {
+                    if (std::string(e.extensionName) == VK_EXT_MEMORY_BUDGET_EXTENSION_NAME)
+                    {
+                        devices_.emplace_back(devices[i]);
+                        break;
+                    }
+                }
+            }
+        }
+
+        ~memory_sampler()
+        {
+            stop();
+
+            if (inst_)
+                vkDestroyInstance(inst_, nullptr);
+        }
+
+        bool available() const
+        {
+            return !devices_.empty();
+        }
+
+        void start()
+        {
+            if (!available())
+                return;
+
+            base_ = usage();
+            peak_ = base_;
+            running_ = true;
+            thread_ = std::thread([this] {
+                while (running_)
+                {
+                    const uint64_t u{usage()};
+                    if (u > peak_)
+                        peak_ = u;
+
+                    std::this_thread::sleep_for(std::chrono::milliseconds(5));
+                }
+            });
+        }
+
+        // Peak usage above the usage at start() in MiB, -1 if not available.
+        double stop()
+        {
+            if (!thread_.joinable())
+                return -1.0;
+
+            running_ = false;
+            thread_.join();
+
+            return (peak_ - base_) / (1024.0 * 1024.0);
+        }
+
+    private:
+        // Sum of the device local heaps of the sampled devices.
+        uint64_t usage() const
+        {
+            uint64_t total{0};
+
+            for (const VkPhysicalDevice dev : devices_)
+            {
+                VkPhysicalDeviceMemoryBudgetPropertiesEXT budget{};
+                budget.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_MEMORY_BUDGET_PROPERTIES_EXT;
+
+                VkPhysicalDeviceMemoryProperties2 props{};
+                props.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_MEMORY_PROPERTIES_2;
+                props.pNext = &budget;
+                vkGetPhysicalDeviceMemoryProperties2(dev, &props);
+
+                for (uint32_t h{0}; h < props.memoryProperties.memoryHeapCount; ++h)
+                {
+                    if (props.memoryProperties.memoryHeaps[h].flags & VK_MEMORY_HEAP_DEVICE_LOCAL_BIT)
+                        total += budget.heapUsage[h];
+                }
+            }
+
+            return total;
+        }
+
+        VkInstance inst_{VK_NULL_HANDLE};
+        std::vector<VkPhysicalDevice> devices_;
+        std::thread thread_;
+        std::atomic<bool> running_{false};
+        uint64_t base_{0};
+        uint64_t peak_{0};
+    };
+
+    // nice: all threads share one instance and call it concurrently (MT_NICE_FILTER).
+    // multi: every thread has its own instance (MT_MULTI_INSTANCE).
+    // serialized: one instance, one get_frame at a time (MT_SERIALIZED).
+    run_result run(AVS_ScriptEnvironment* env, AVS_Clip* source, const options& o, const std::string& filter, const std::string& mode,
+        int num_threads, memory_sampler& sampler)
+    {
+        run_result r{};
+        r.mode = mode;
+        r.threads = num_threads;
+
+        sampler.start();
+
+        std::vector<AVS_Clip*> instances;
+        for (int i{0}; i < ((mode == "multi") ? num_threads : 1); ++i)
+        {
+            AVS_Clip* clip{tools::create_filter(env, source, o, filter, {}, r.error)};
+            if (!clip)
+                break;
+
+            instances.emplace_back(clip);
+        }
+
+        std::mutex serialize_mtx;
+        std::mutex error_mtx;
+        std::atomic<int> next_frame{0};
+        std::atomic<bool> failed{!r.error.empty()};
+
+        const auto fetch{[&](AVS_Clip* clip, int n) {
+            std::unique_lock<std::mutex> lck(serialize_mtx, std::defer_lock);
+            if (mode == "serialized")
+                lck.lock();
+
+            AVS_VideoFrame* frame{avs_mock::get_frame(clip, n)};
+            if (!frame)
+            {
+                const char* err{avs_mock::clip_error(clip)};
+
+                std::lock_guard<std::mutex> err_lck(error_mtx);
+                r.error = (err) ? err : "get_frame failed";
+                failed = true;
+                return;
+            }
+
+            avs_mock::release_frame(frame);
+        }};
+
+        // Instances are created lazily by the first get_frame in some filters, keep that out of the measurement.
+        for (AVS_Clip* clip : instances)
+        {
+            for (int n{0}; !failed && n < o.warmup; ++n)
+                fetch(clip, n);
+        }
+
+        const auto start{std::chrono::steady_clock::now()};
+
+        std::vector<std::thread> workers;
+        for (int t{0}; !failed && t < num_threads; ++t)
+        {
+            AVS_Clip* clip{instances[(mode == "multi") ? t : 0]};
+
+            workers.emplace_back([&, clip] {
+                for (int n{next_frame++}; !failed && n < o.frames; n = next_frame++)
+                    fetch(clip, o.warmup + n);
+            });
+        }
+
+        for (std::thread& w : workers)
+            w.join();
+
+        const auto end{std::chrono::steady_clock::now()};
+
+        for (AVS_Clip* clip : instances)
+            avs_mock::release_clip(clip);
+
+        r.peak_device_mib = sampler.stop();
+
+        if (failed)
+            return r;
+
+        r.seconds = std::chrono::duration<double>(end - start).count();
+        r.fps = o.frames / r.seconds;
+
+        return r;
+    }
+
+    std::string to_json(const options& o, const std::vector<filter_result>& results)
+    {
+        std::ostringstream js;
+        js.precision(6);
+        js << std::fixed;
+
+        js << "{\n  \"device\": " << o.device << ", \"width\": " << o.width << ", \"height\": " << o.height << ", \"bits\": " << o.bits
+           << ", \"format\": \"" << o.format << "\", \"frames\": " << o.frames << ",\n  \"results\": [";
+
+        for (size_t i{0}; i < results.size(); ++i)
+        {
+            const filter_result& f{results[i]};
+
+            js << ((i) ? ",\n" : "\n") << "    {\"filter\": \"" << f.filter << "\"";
+
+            if (!f.error.empty())
+            {
+                js << ", \"error\": \"" << tools::json_escape(f.error) << "\"}";
+                continue;
+            }
+
+            js << ", \"mt_mode\": " << f.mt_mode << ", \"runs\": [";
+
+            for (size_t j{0}; j < f.runs.size(); ++j)
+            {
+                const run_result& r{f.runs[j]};
+
+                js << ((j) ? ",\n" : "\n") << "      {\"mode\": \"" << r.mode << "\", \"threads\": " << r.threads;
+
+                if (!r.error.empty())
+                    js << ", \"error\": \"" << tools::json_escape(r.error) << "\"";
+                else
+                {
+                    js << ", \"seconds\": " << r.seconds << ", \"fps\": " << r.fps << ", \"speedup\": " << r.speedup
+                       << ", \"peak_device_mib\": ";
+
+                    if (r.peak_device_mib < 0.0)
+                        js << "null";
+                    else
+                        js << r.peak_device_mib;
+                }
+
+                js << "}";
+            }
+
+            js << "\n    ]}";
+        }
+
+        js << "\n  ]\n}\n";
+
+        return js.str();
+    }
+} // namespace
+
+int main(int argc, char** argv)
+{
+    options o;
+    if (!parse_options(argc, argv, o))
+    {
+        usage();
+        return 1;
+    }
+
+    AVS_ScriptEnvironment* env{avs_mock::create_env()};
+
+    std::string err;
+    if (!avs_mock::load_plugin(env, o.plugin, err))
+    {
+        std::cerr << "failed loading " << o.plugin << ": " << err << "\n";
+        avs_mock::destroy_env(env);
+        return 1;
+    }
+
+    AVS_Clip* source{tools::new_source(env, o, o.warmup + o.frames)};
+    memory_sampler sampler(o.device);
+    if (!sampler.available())
+        std::cerr << "VK_EXT_memory_budget isn't available, peak device memory isn't reported\n";
+
+    std::vector<filter_result> results;
+    bool failed{false};
+
+    for (const std::string& filter : o.filters)
+    {
+        filter_result f{};
+        f.filter = filter;
+
+        // The MT mode the plugin asks AviSynth+ for.
+        AVS_Clip* probe{tools::create_filter(env, source, o, filter, {}, f.error)};
+        if (!probe)
+        {
+            failed |= f.error.rfind("skipped", 0) != 0;
+            results.emplace_back(std::move(f));
+            continue;
+        }
+
+        f.mt_mode = avs_mock::set_cache_hints(probe, AVS_CACHE_GET_MTMODE, 0);
+        avs_mock::release_clip(probe);
+
+        for (const std::string& mode : o.modes)
+        {
+            // Relative to the first thread count of the mode.
+            double base_fps{0.0};
+
+            for (const int t : o.threads)
+            {
+                run_result r{run(env, source, o, filter, mode, t, sampler)};
+                if (!r.error.empty())
+                    failed = true;
+                else
+                {
+                    if (base_fps == 0.0)
+                        base_fps = r.fps;
+                    r.speedup = r.fps / base_fps;
+                }
+
+                std::cerr << filter << " " << mode << " x" << t << ": " << ((r.error.empty()) ? std::to_string(r.fps) + " fps" : r.error)
+                          << "\n";
+
+                f.runs.emplace_back(std::move(r));
+            }
+        }
+
+        results.emplace_back(std::move(f));
+    }
+
+    avs_mock::release_clip(source);
+    avs_mock::destroy_env(env);
+
+    const std::string report{to_json(o, results)};
+
+    if (o.output.empty())
+        std::cout << report;
+    else
+    {
+        std::ofstream f(o.output);
+        f << report;
+        if (!f)
+        {
+            std::cerr << "failed writing " << o.output << "\n";
+            return 1;
+        }
+    }
+
+    return (failed) ? 1 : 0;
+}
@@ -0,0 +1,155 @@
+#include <sstream>
+#include <stdexcept>
+
+#include "tool_common.h"
+
+namespace tools
+{
+    const char* const filter_usage{"  --plugin <path>          plugin to load (default: the one built alongside)\n"
+                                   "  --width <n>              source width (default: 1920)\n"
+                                   "  --height <n>             source height (default: 1080)\n"
+                                   "  --bits <8|16|32>         source bit depth (default: 16)\n"
+                                   "  --format <fmt>           420, 422, 444 or rgb (default: 420)\n"
+                                   "  --device <n>             Vulkan device index (default: libplacebo's choice)\n"
+                                   "  --resample-size <WxH>    Resample target size (default: twice the source size)\n"
+                                   "  --shader <path>          mpv user shader for libplacebo_Shader (Shader is skipped without it)\n"
+                                   "  --arg <filter.key=value> extra filter argument, can be repeated\n"};
+
+    std::vector<std::string> split(const std::string& s, char sep)
+    {
+        std::vector<std::string> out;
+        std::stringstream ss(s);
+        for (std::string item; std::getline(ss, item, sep);)
+            out.emplace_back(item);
+
+        return out;
+    }
+
+    bool parse_filter_option(const std::string& opt, const std::string& val, filter_options& o)
+    {
+        if (opt == "--plugin")
+            o.plugin = val;
+        else if (opt == "--width")
+            o.width = std::stoi(val);
+        else if (opt == "--height")
+            o.height = std::stoi(val);
+        else if (opt == "--bits")
+            o.bits = std::stoi(val);
+        else if (opt == "--format")
+            o.format = val;
+        else if (opt == "--device")
+            o.device = std::stoi(val);
+        else if (opt == "--resample-size")
+        {
+            const size_t x{val.find('x')};
+            if (x == std::string::npos)
+                throw std::invalid_argument("expected WxH");
+
+            o.resample_width = std::stoi(val.substr(0, x));
+            o.resample_height = std::stoi(val.substr(x + 1));
+        }
+        else if (opt == "--shader")
+            o.shader = val;
+        else if (opt == "--arg")
+        {
+            const size_t dot{val.find('.')};
+            const size_t eq{val.find('=')};
+            if (dot == std::string::npos || eq == std::string::npos || eq < dot)
+                throw std::invalid_argument("expected filter.key=value");
+
+            o.extra_args.emplace(val.substr(0, dot), avs_mock::named_arg{val.substr(dot + 1, eq - dot - 1), val.substr(eq + 1)});
+        }
+        else
+            return false;
+
+        return true;
+    }
+
+    bool valid_source(const filter_options& o)
+    {
+        return o.width > 0 && o.height > 0 && avs_mock::pixel_type(o.bits, o.format) && o.format != "y";
+    }
+
+    AVS_Clip* new_source(AVS_ScriptEnvironment* env, const filter_options& o, int num_frames)
+    {
+        AVS_VideoInfo vi{};
+        vi.width = o.width;
+        vi.height = o.height;
+        vi.fps_numerator = 24000;
+        vi.fps_denominator = 1001;
+        vi.num_frames = num_frames;
+        vi.pixel_type = avs_mock::pixel_type(o.bits, o.format);
+
+        return avs_mock::new_source_clip(env, vi, 8, 1);
+    }
+
+    AVS_Clip* create_filter(AVS_ScriptEnvironment* env, AVS_Clip* source, const filter_options& o, const std::string& filter,
+        const std::vector<avs_mock::named_arg>& args, std::string& err)
+    {
+        std::string function;
+        std::vector<avs_mock::named_arg> all_args;
+
+        if (filter == "deband")
+            function = "libplacebo_Deband";
+        else if (filter == "resample")
+        {
+            function = "libplacebo_Resample";
+            all_args.emplace_back("", std::to_string((o.resample_width) ? o.resample_width : o.width * 2));
+            all_args.emplace_back("", std::to_string((o.resample_height) ? o.resample_height : o.height * 2));
+        }
+        else if (filter == "shader")
+        {
+            if (o.shader.empty())
+            {
+                err = "skipped: no --shader given";
+                return nullptr;
+            }
+
+            function = "libplacebo_Shader";
+            all_args.emplace_back("", o.shader);
+        }
+        else if (filter == "tonemap")
+            function = "libplacebo_Tonemap";
+        else
+        {
+            err = "unknown filter";
+            return nullptr;
+        }
+
+        all_args.insert(all_args.end(), args.begin(), args.end());
+        if (o.device > -1)
+            all_args.emplace_back("device", std::to_string(o.device));
+
+        const auto [first, last]{o.extra_args.equal_range(filter)};
+        for (auto itr{first}; itr != last; ++itr)
+            all_args.emplace_back(itr->second);
+
+        AVS_Value v{avs_mock::invoke(env, function, source, all_args)};
+        if (avs_is_error(v))
+        {
+            err = v.d.string;
+            return nullptr;
+        }
+
+        AVS_Clip* clip{avs_mock::take_clip(env, v)};
+        avs_mock::release_value(v);
+
+        return clip;
+    }
+
+    std::string json_escape(const std::string& s)
+    {
+        std::string out;
+        for (const char c : s)
+        {
+            if (c == '"' || c == '\\')
+                out += '\\';
+            if (c == '\n')
+                out += "\\n";
+            else if (static_cast<unsigned char>(c) >= 0x20)
+                out += c;
+        }
+
+        return out;
+    }
+} // namespace tools
@@ -0,0 +1,43 @@
+#pragma once
+
+#include <map>
+#include <string>
+#include <vector>
+
+#include "avs_mock.h"
+
+// Options and helpers shared by the tools.
+namespace tools
+{
+    struct filter_options
+    {
+        std::string plugin{AVS_LIBPLACEBO_PATH};
+        int width{1920};
+        int height{1080};
+        int bits{16};
+        std::string format{"420"};
+        int device{-1};
+        int resample_width{0};
+        int resample_height{0};
+        std::string shader;
+        std::multimap<std::string, avs_mock::named_arg> extra_args;
+    };
+
+    extern const char* const filter_usage;
+
+    std::vector<std::string> split(const std::string& s, char sep);
+
+    // Handles the options in filter_usage. Returns false if `opt` isn't one of them, throws on an invalid value.
+    bool parse_filter_option(const std::string& opt, const std::string& val, filter_options& o);
+    bool valid_source(const filter_options& o);
+
+    // Clip with the configured size and format that cycles through a few generated frames.
+    AVS_Clip* new_source(AVS_ScriptEnvironment* env, const filter_options& o, int num_frames);
+
+    // Creates the filter (deband, resample, shader, tonemap) on top of `source` with the configured arguments.
+    // Returns nullptr and sets err on failure.
+    AVS_Clip* create_filter(AVS_ScriptEnvironment* env, AVS_Clip* source, const filter_options& o, const std::string& filter,
+        const std::vector<avs_mock::named_arg>& args, std::string& err);
+
+    std::string json_escape(const std::string& s);
+} // namespace tools